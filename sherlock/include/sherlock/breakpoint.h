@@ -13,12 +13,16 @@
 #include <sherlock/sherlock.h>
 
 int breakpoint_add(tracee_t *tracee, unsigned long long bpaddr, symbol_t *sym);
-int breakpoint_pending(tracee_t *tracee);
+int breakpoint_add_batch(tracee_t *tracee, symbol_t **syms, unsigned int count);
+int breakpoint_pending(tracee_t *tracee, bool cont);
 int breakpoint_update(
     tracee_t *tracee, breakpoint_t *bp, unsigned long new_addr);
 tracee_state_e breakpoint_handle(tracee_t *tracee);
 void breakpoint_printall(tracee_t *tracee);
 void breakpoint_delete(tracee_t *tracee, unsigned int idx);
+void breakpoint_unload(
+    tracee_t *tracee, unsigned long long start, unsigned long long end);
+int breakpoint_reload(tracee_t *tracee, const char *file);
 void breakpoint_cleanup(tracee_t *tracee);
 
 // Watch points
@@ -0,0 +1,38 @@
+/*
+ * Sherlock - A Minimal Debugger
+ * Part of the Sherlock project
+ *
+ * Copyright (c) 2025-26 Mohammad Shehar Yaar Tausif <sheharyaar48@gmail.com>
+ *
+ * This file is licensed under the MIT License.
+ */
+
+#ifndef _SHERLOCK_MEM_H
+#define _SHERLOCK_MEM_H
+
+#include <sherlock/sherlock.h>
+
+typedef struct MEM_PATCH {
+	unsigned long long addr;
+	// the byte to write, mem_unpatch fills it from the shadow
+	unsigned char byte;
+	// the original word at 'addr' (patched bytes read through the shadow),
+	// valid if 'ok'
+	long orig;
+	bool ok;
+	// errno of the failure otherwise
+	int err;
+} mem_patch_t;
+
+int mem_open(pid_t pid);
+void mem_close(void);
+int mem_read(pid_t pid, unsigned long long addr, void *buf, size_t len);
+int mem_read_raw(pid_t pid, unsigned long long addr, void *buf, size_t len);
+int mem_write(pid_t pid, unsigned long long addr, const void *buf, size_t len);
+int mem_patch(pid_t pid, mem_patch_t *patches, unsigned int count);
+int mem_unpatch(pid_t pid, mem_patch_t *patches, unsigned int count);
+int mem_lift(pid_t pid, unsigned long long addr);
+void mem_forget(unsigned long long start, unsigned long long end);
+unw_accessors_t *mem_unw_accessors(void);
+
+#endif
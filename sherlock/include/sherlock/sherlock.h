@@ -64,7 +64,10 @@ typedef struct SECTION_MAP {
 typedef struct MEM_MAP {
 	unsigned long long start;
 	unsigned long long end;
-	char path[SHERLOCK_MAX_STRLEN];
+	unsigned long long offset;
+	unsigned long inode;
+	// interned, shared by all the mappings of a file
+	const char *path;
 } mem_map_t;
 
 typedef struct BREAKPOINT breakpoint_t;
@@ -90,23 +93,31 @@ typedef struct SYMBOL {
 	// just be there, eg. puts gets resolved, then we have two symbols, puts
 	// and puts@plt.
 	bool needs_resolve;
-	// TODO [SYM_DUP]: duplicate symbols can cause incorrect PEEKTEXT,
-	// POKETEXT
 } symbol_t;
 
 typedef struct BREAKPOINT {
 	unsigned long long addr;
 	long value;
 	symbol_t *sym;
-	struct BREAKPOINT *next;
 	unsigned int idx;
 	unsigned int counter;
 	bool is_plt_bp;
 } breakpoint_t;
 
+typedef struct BREAKPOINT_TABLE {
+	// by address, open addressing with linear probing, power of two size
+	breakpoint_t **slots;
+	unsigned int size;
+	unsigned int count;
+	// by number, NULL once deleted
+	breakpoint_t **by_idx;
+	unsigned int idx_cap;
+	unsigned int last_idx;
+} breakpoint_table_t;
+
 typedef struct TRACEE {
 	pid_t pid;
-	breakpoint_t *bp_list;
+	breakpoint_table_t bps;
 	breakpoint_t *pending_bp;
 	unsigned long long va_base;
 	unw_addr_space_t unw_addr;
@@ -28,19 +28,43 @@
 		}                                                              \
 	} while (0)
 
+// A source location, 'addr' is where the code for the line starts.
+typedef struct SYM_LINE {
+	unsigned long long addr;
+	unsigned int line;
+	char file[SHERLOCK_MAX_STRLEN];
+} sym_line_t;
+
+// Called for every definition matching a name, return 1 to stop, -1 on error.
+typedef int (*sym_name_cb)(tracee_t *tracee, symbol_t *sym, void *arg);
+// Called for every location of a source line, same return values.
+typedef int (*sym_line_cb)(tracee_t *tracee, sym_line_t *loc, void *arg);
+
 int sym_setup(tracee_t *tracee);
 symbol_t *sym_lookup_name(tracee_t *tracee, char *name);
+int sym_foreach_name(
+    tracee_t *tracee, char *name, sym_name_cb cb, void *arg);
+int sym_foreach_match(
+    tracee_t *tracee, char *pattern, sym_name_cb cb, void *arg);
 symbol_t *sym_lookup_addr(tracee_t *tracee, unsigned long long addr);
+// The demangled form of a C++ name, 'name' itself otherwise. The string is
+// only valid until the next call.
+const char *sym_demangle(const char *name);
 section_t *sym_addr_section(unsigned long long addr, unsigned long long size);
 mem_map_t *sym_proc_addr_map(unsigned long long addr, unsigned long long size);
 int sym_proc_map_setup(tracee_t *tracee);
 int sym_proc_pid_info(tracee_t *tracee);
-void sym_sort_trigger();
+int sym_line_lookup_addr(
+    tracee_t *tracee, unsigned long long addr, sym_line_t *loc);
+int sym_foreach_line(tracee_t *tracee, char *spec, sym_line_cb cb, void *arg);
+int sym_print_var(tracee_t *tracee, char *name);
+void sym_addr_moved(symbol_t *sym, unsigned long long old_addr);
 void sym_printall(tracee_t *tracee);
 void sym_cleanup(tracee_t *tracee);
 
 // r_debug related functions
 int sym_setup_dldebug(tracee_t *tracee);
 int sym_handle_dldbg_syms(tracee_t *tracee);
+int sym_resolve_pending(tracee_t *tracee);
 
 #endif
\ No newline at end of file
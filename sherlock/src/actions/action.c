@@ -142,7 +142,18 @@ tracee_state_e action_parse_input(tracee_t *tracee, char *input)
 	}
 
 	char *entity = strtok(NULL, " ");
-	char *args = strtok(NULL, " ");
+
+	// the argument is the rest of the line, C++ signatures have spaces in
+	// them: break func ns::foo(unsigned int)
+	char *args = strtok(NULL, "");
+	if (args != NULL) {
+		args += strspn(args, " ");
+		size_t len = strlen(args);
+		while (len > 0 && args[len - 1] == ' ')
+			args[--len] = '\0';
+		if (len == 0)
+			args = NULL;
+	}
 
 	if (MATCH_STR(action, q) || MATCH_STR(action, quit)) {
 		exit(0);
@@ -13,12 +13,6 @@
 #include <sys/ptrace.h>
 #include <stdlib.h>
 
-/*
-TODO [LATER]:
-- File:line
-- line
-*/
-
 static tracee_state_e breakpoint_addr(tracee_t *tracee, char *addr)
 {
 	errno = 0;
@@ -37,18 +31,26 @@ static tracee_state_e breakpoint_addr(tracee_t *tracee, char *addr)
 	return TRACEE_STOPPED;
 }
 
-static tracee_state_e breakpoint_func(tracee_t *tracee, char *func)
+static int breakpoint_func_cb(tracee_t *tracee, symbol_t *sym,
+    __attribute__((unused)) void *arg)
 {
-	// do a symbol lookup;
-	unsigned long long func_addr = 0;
+	return breakpoint_add(tracee, sym->addr, sym);
+}
 
+static tracee_state_e breakpoint_func(tracee_t *tracee, char *func)
+{
 	if (func == NULL || func[0] == '\0') {
 		pr_err("invalid name to breakpoint");
 		return TRACEE_STOPPED;
 	}
 
-	symbol_t *sym = sym_lookup_name(tracee, func);
-	if (sym == NULL) {
+	// every definition of the name gets a breakpoint, qualify the name
+	// (file:func, func@lib) to pick one
+	int found = sym_foreach_name(tracee, func, breakpoint_func_cb, NULL);
+	if (found == -1)
+		return TRACEE_ERR;
+
+	if (found == 0) {
 		pr_info_raw("function '%s' is not yet defined.\n"
 			    "Make breakpoint pending on future shared "
 			    "library load? (y or [n]) ",
@@ -67,13 +69,96 @@ static tracee_state_e breakpoint_func(tracee_t *tracee, char *func)
 		return TRACEE_STOPPED;
 	}
 
-	func_addr = sym->addr;
-	if (breakpoint_add(tracee, func_addr, sym) == -1)
-		return TRACEE_ERR;
+	return TRACEE_STOPPED;
+}
+
+static int breakpoint_line_cb(
+    tracee_t *tracee, sym_line_t *loc, __attribute__((unused)) void *arg)
+{
+	return breakpoint_add(tracee, loc->addr, NULL);
+}
+
+static tracee_state_e breakpoint_lines(tracee_t *tracee, char *spec)
+{
+	int found = sym_foreach_line(tracee, spec, breakpoint_line_cb, NULL);
+	if (found == 0)
+		pr_info_raw("No code at or after line '%s'\n", spec);
 
 	return TRACEE_STOPPED;
 }
 
+static tracee_state_e breakpoint_line(tracee_t *tracee, char *line)
+{
+	if (line == NULL || line[0] == '\0' || strchr(line, ':') != NULL) {
+		pr_err("invalid line to breakpoint, use 'fline' for a file");
+		return TRACEE_STOPPED;
+	}
+
+	return breakpoint_lines(tracee, line);
+}
+
+static tracee_state_e breakpoint_fline(tracee_t *tracee, char *fline)
+{
+	if (fline == NULL || strchr(fline, ':') == NULL) {
+		pr_err("invalid location to breakpoint, use <file>:<line>");
+		return TRACEE_STOPPED;
+	}
+
+	return breakpoint_lines(tracee, fline);
+}
+
+typedef struct BREAK_MATCHES {
+	symbol_t **syms;
+	unsigned int count;
+	unsigned int cap;
+} break_matches_t;
+
+static int breakpoint_funcs_cb(
+    __attribute__((unused)) tracee_t *tracee, symbol_t *sym, void *arg)
+{
+	break_matches_t *m = arg;
+	if (m->count == m->cap) {
+		unsigned int cap = m->cap ? m->cap * 2 : 64;
+		symbol_t **t = realloc(m->syms, cap * sizeof(symbol_t *));
+		if (t == NULL) {
+			pr_err("error in allocating matches: %s",
+			    strerror(errno));
+			return -1;
+		}
+
+		m->syms = t;
+		m->cap = cap;
+	}
+
+	m->syms[m->count++] = sym;
+	return 0;
+}
+
+static tracee_state_e breakpoint_funcs(tracee_t *tracee, char *pattern)
+{
+	if (pattern == NULL || pattern[0] == '\0') {
+		pr_err("invalid pattern to breakpoint");
+		return TRACEE_STOPPED;
+	}
+
+	// collect every match first so that they are inserted in one batch
+	break_matches_t m = { 0 };
+	int found = sym_foreach_match(tracee, pattern, breakpoint_funcs_cb, &m);
+	if (found == -1) {
+		free(m.syms);
+		return TRACEE_STOPPED;
+	}
+
+	if (found == 0) {
+		pr_info_raw("No function matches '%s'\n", pattern);
+		return TRACEE_STOPPED;
+	}
+
+	int ret = breakpoint_add_batch(tracee, m.syms, m.count);
+	free(m.syms);
+	return (ret == -1) ? TRACEE_ERR : TRACEE_STOPPED;
+}
+
 static bool match_break(char *act)
 {
 	return (MATCH_STR(act, break) || MATCH_STR(act, br));
@@ -82,13 +167,21 @@ static bool match_break(char *act)
 static void help_break()
 {
 	pr_info_raw("break,br func <function_name>\n");
+	pr_info_raw("break,br func <file>:<function_name>\n");
+	pr_info_raw("break,br func <function_name>@<library>\n");
+	pr_info_raw("break,br funcs <regex|glob>[@<library>]\n");
 	pr_info_raw("break,br addr <0xaddress>\n");
+	pr_info_raw("break,br line <line>\n");
+	pr_info_raw("break,br fline <file>:<line>\n");
 }
 
 static action_t action_break = {
 	.type = ACTION_BREAK,
 	.ent_handler = { [ENTITY_ADDRESS] = breakpoint_addr,
-	    [ENTITY_FUNCTION] = breakpoint_func },
+	    [ENTITY_FUNCTION] = breakpoint_func,
+	    [ENTITY_FUNCTIONS] = breakpoint_funcs,
+	    [ENTITY_LINE] = breakpoint_line,
+	    [ENTITY_FILE_LINE] = breakpoint_fline },
 	.match_action = match_break,
 	.help = help_break,
 	.name = "break",
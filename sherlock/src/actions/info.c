@@ -27,9 +27,10 @@ static tracee_state_e info_addr(tracee_t *tracee, char *arg)
 	}
 
 	if (addr == sym->addr)
-		pr_info_raw("%s in ", sym->name);
+		pr_info_raw("%s in ", sym_demangle(sym->name));
 	else
-		pr_info_raw("%s + %lld in ", sym->name, (addr - sym->addr));
+		pr_info_raw("%s + %lld in ", sym_demangle(sym->name),
+		    (addr - sym->addr));
 
 	if (sym->section)
 		pr_info_raw(
@@ -37,16 +38,71 @@ static tracee_state_e info_addr(tracee_t *tracee, char *arg)
 	else
 		pr_info_raw("%s\n", sym->file_name);
 
+	sym_line_t loc;
+	if (sym_line_lookup_addr(tracee, addr, &loc) == 0)
+		pr_info_raw("Line %u of \"%s\"\n", loc.line, loc.file);
+
 	return TRACEE_STOPPED;
 }
 
-static tracee_state_e info_funcs(
-    tracee_t *tracee, __attribute__((unused)) char *args)
+static int info_line_cb(
+    tracee_t *tracee, sym_line_t *loc, __attribute__((unused)) void *arg)
 {
-	sym_printall(tracee);
+	pr_info_raw("Line %u of \"%s\" starts at address %#llx", loc->line,
+	    loc->file, loc->addr);
+
+	symbol_t *sym = sym_lookup_addr(tracee, loc->addr);
+	if (sym != NULL && loc->addr == sym->addr)
+		pr_info_raw(" <%s>", sym_demangle(sym->name));
+	else if (sym != NULL)
+		pr_info_raw(" <%s+%lld>", sym_demangle(sym->name),
+		    loc->addr - sym->addr);
+
+	pr_info_raw("\n");
+	return 0;
+}
+
+static tracee_state_e info_line(tracee_t *tracee, char *spec)
+{
+	if (spec == NULL || spec[0] == '\0') {
+		pr_err("invalid line passed");
+		return TRACEE_STOPPED;
+	}
+
+	if (sym_foreach_line(tracee, spec, info_line_cb, NULL) == 0)
+		pr_info_raw("No code at or after line '%s'\n", spec);
+
 	return TRACEE_STOPPED;
 }
 
+static int info_funcs_cb(__attribute__((unused)) tracee_t *tracee,
+    symbol_t *sym, __attribute__((unused)) void *arg)
+{
+	pr_info_raw("%#llx  %s\n", sym->addr, sym_demangle(sym->name));
+	return 0;
+}
+
+static tracee_state_e info_funcs(tracee_t *tracee, char *pattern)
+{
+	if (pattern == NULL) {
+		sym_printall(tracee);
+		return TRACEE_STOPPED;
+	}
+
+	if (sym_foreach_match(tracee, pattern, info_funcs_cb, NULL) == 0)
+		pr_info_raw("No function matches '%s'\n", pattern);
+
+	return TRACEE_STOPPED;
+}
+
+static int info_func_cb(__attribute__((unused)) tracee_t *tracee,
+    symbol_t *sym, __attribute__((unused)) void *arg)
+{
+	pr_info_raw("Symbol '%s' is at '%#llx' in %s\n",
+	    sym_demangle(sym->name), sym->addr, sym->file_name);
+	return 0;
+}
+
 static tracee_state_e info_func(tracee_t *tracee, char *func)
 {
 	// TODO [SYM_RES]: print function (symbol)
@@ -55,15 +111,15 @@ static tracee_state_e info_func(tracee_t *tracee, char *func)
 		return info_funcs(tracee, NULL);
 	}
 
-	symbol_t *sym = sym_lookup_name(tracee, func);
-	if (sym == NULL) {
+	int found = sym_foreach_name(tracee, func, info_func_cb, NULL);
+	if (found == -1)
+		return TRACEE_ERR;
+
+	if (found == 0) {
 		pr_info_raw(
 		    "The symbol '%s' is not present or loaded yet\n", func);
-		return TRACEE_STOPPED;
 	}
 
-	pr_info_raw("Symbol '%s' is at '%#llx' in %s\n", func, sym->addr,
-	    sym->file_name);
 	return TRACEE_STOPPED;
 }
 
@@ -97,9 +153,11 @@ static void help_info()
 {
 	pr_info_raw("info,inf func <function_name>\n");
 	pr_info_raw("info,inf addr <0xaddress>\n");
+	pr_info_raw("info,inf line <line>\n");
+	pr_info_raw("info,inf fline <file>:<line>\n");
 	pr_info_raw("info,inf break\n");
 	pr_info_raw("info,inf reg\n");
-	pr_info_raw("info,inf funcs\n");
+	pr_info_raw("info,inf funcs [<regex|glob>]\n");
 	pr_info_raw("info,inf watch\n");
 }
 
@@ -110,6 +168,8 @@ static action_t action_info = { .type = ACTION_INFO,
 		[ENTITY_FUNCTION] = info_func,
 		[ENTITY_FUNCTIONS] = info_funcs,
 		[ENTITY_ADDRESS] = info_addr,
+		[ENTITY_LINE] = info_line,
+		[ENTITY_FILE_LINE] = info_line,
 		[ENTITY_WATCHPOINT] = info_watchpoints,
 	},
 	.match_action = match_info,
@@ -8,6 +8,8 @@
  */
 
 #include "action_internal.h"
+#include <sherlock/mem.h>
+#include <sherlock/sym.h>
 #include <errno.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -15,8 +17,6 @@
 #include <sys/ptrace.h>
 #include <sys/user.h>
 
-// TODO [LATER]: print ENTITY_VARIABLE
-
 #define PRINT_REG(regs, target) pr_info_raw("%lld\n", regs.target);
 
 #define PRINT_REG_ADDR(regs, target) pr_info_raw("%#llx\n", regs.target);
@@ -50,7 +50,6 @@ static tracee_state_e print_addr(tracee_t *tracee, char *addr)
 		return TRACEE_STOPPED;
 	}
 
-	// need to check this later, since PEEK* can return -1 as the value
 	unsigned long long raddr;
 	ARG_TO_ULL(addr, raddr);
 	if (raddr == 0) {
@@ -58,8 +57,10 @@ static tracee_state_e print_addr(tracee_t *tracee, char *addr)
 		return TRACEE_STOPPED;
 	}
 
-	long data = ptrace(PTRACE_PEEKDATA, tracee->pid, raddr, NULL);
-	if (data == -1 && errno != 0) {
+	// read through the breakpoint shadow, an INT3 shows as the
+	// instruction byte it replaced
+	long data = 0;
+	if (mem_read(tracee->pid, raddr, &data, sizeof(data)) == -1) {
 		// some error occured
 		if (errno == EIO || errno == EFAULT) {
 			pr_info_raw("the requested memory address(%#llx) is "
@@ -154,6 +155,17 @@ static tracee_state_e print_reg(tracee_t *tracee, char *reg)
 	return TRACEE_STOPPED;
 }
 
+static tracee_state_e print_var(tracee_t *tracee, char *name)
+{
+	if (name == NULL) {
+		pr_err("invalid variable name passed");
+		return TRACEE_STOPPED;
+	}
+
+	sym_print_var(tracee, name);
+	return TRACEE_STOPPED;
+}
+
 static bool match_print(char *act)
 {
 	return (MATCH_STR(act, print) || MATCH_STR(act, p));
@@ -163,6 +175,7 @@ static void help_print()
 {
 	pr_info_raw("print,p reg <reg>\n");
 	pr_info_raw("print,p addr <0xaddress>\n");
+	pr_info_raw("print,p var <name>\n");
 }
 
 static action_t action_print = {
@@ -170,6 +183,7 @@ static action_t action_print = {
 	.ent_handler = {
 		[ENTITY_REGISTER] = print_reg,
 		[ENTITY_ADDRESS] = print_addr,
+		[ENTITY_VARIABLE] = print_var,
 	},
 	.match_action = match_print,
 	.help = help_print,
@@ -7,7 +7,9 @@
  * This file is licensed under the MIT License.
  */
 
-#include <sherlock/breakpoint.h>
+#define _GNU_SOURCE
+#include "breakpoint_internal.h"
+#include <sherlock/mem.h>
 #include <sherlock/sym.h>
 #include <errno.h>
 #include <link.h>
@@ -17,38 +19,345 @@
 #include <sys/user.h>
 #include <sys/wait.h>
 
-#define DO_SINGLESTEP(tracee, err)                                             \
-	do {                                                                   \
-		if (ptrace(PTRACE_SINGLESTEP, tracee->pid, NULL, 0) == -1) {   \
-			pr_err("error in singlestep");                         \
-			return err;                                            \
-		}                                                              \
-                                                                               \
-		int wstatus = 0;                                               \
-		if (waitpid(tracee->pid, &wstatus, 0) < 0) {                   \
-			pr_err("waitpid err: %s", strerror(errno));            \
-			return err;                                            \
-		}                                                              \
-                                                                               \
-		if (!WIFSTOPPED(wstatus)) {                                    \
-			pr_err("not stopped by SIGSTOP");                      \
-			return err;                                            \
-		}                                                              \
-	} while (0)
+#define BREAKPOINT_INT3 0xCC
+
+/*
+ * Breakpoints are found by address on every SIGTRAP, so they are kept in an
+ * open addressing table keyed by address (linear probing, at most half full)
+ * and by number in a flat array. Deletion shifts the following entries of the
+ * probe run back instead of leaving tombstones, lookups never have to skip
+ * over dead slots. Breakpoints waiting for their symbol to resolve (address
+ * 0) are only in the number array until breakpoint_update gives them one.
+ *
+ * A breakpoint on a function of a library that is unloaded waits the same
+ * way, its symbol stays with the cached library. When the library is loaded
+ * again, breakpoint_reload patches it at the symbol's new address.
+ *
+ * Text is patched through mem.c, one byte at a time: the INT3 goes in, the
+ * original byte comes back from the shadow mem.c keeps of the patched text,
+ * and a breakpoint a few bytes further is left alone. Breakpoints added
+ * together are patched with one mem_patch, which reads and writes nearby
+ * ones as a single span.
+ *
+ * A hit only rewinds RIP, the INT3 stays. Resuming emulates the instruction
+ * on the registers of the stop (emulate.c, function prologues) or runs a copy
+ * of it (displaced.c), the INT3 is only lifted for the instructions that
+ * cannot be copied and for PLT breakpoints, which step through the resolver
+ * before moving to the function.
+ */
+
+#define BREAKPOINT_TABLE_MIN 64
+
+// registers of the last breakpoint stop, nothing changes them before the
+// tracee is resumed from it
+static struct user_regs_struct breakpoint_regs;
+static bool breakpoint_regs_ok = false;
+
+static unsigned int breakpoint_slot(
+    breakpoint_table_t *t, unsigned long long addr)
+{
+	unsigned long long h = addr * 0x9E3779B97F4A7C15ULL;
+	return (h >> 32) & (t->size - 1);
+}
+
+static breakpoint_t *breakpoint_find(
+    tracee_t *tracee, unsigned long long addr)
+{
+	breakpoint_table_t *t = &tracee->bps;
+	if (t->count == 0 || addr == 0)
+		return NULL;
+
+	unsigned int mask = t->size - 1;
+	for (unsigned int i = breakpoint_slot(t, addr);; i = (i + 1) & mask) {
+		breakpoint_t *bp = t->slots[i];
+		if (bp == NULL || bp->addr == addr)
+			return bp;
+	}
+}
+
+static void breakpoint_hash_put(breakpoint_table_t *t, breakpoint_t *bp)
+{
+	unsigned int mask = t->size - 1;
+	unsigned int i = breakpoint_slot(t, bp->addr);
+	while (t->slots[i] != NULL)
+		i = (i + 1) & mask;
+
+	t->slots[i] = bp;
+	t->count++;
+}
+
+static int breakpoint_hash_insert(breakpoint_table_t *t, breakpoint_t *bp)
+{
+	if ((t->count + 1) * 2 > t->size) {
+		unsigned int size =
+		    t->size ? t->size * 2 : BREAKPOINT_TABLE_MIN;
+		breakpoint_t **slots = calloc(size, sizeof(breakpoint_t *));
+		if (slots == NULL) {
+			pr_err("cannot allocate breakpoint table: %s",
+			    strerror(errno));
+			return -1;
+		}
+
+		breakpoint_t **old = t->slots;
+		unsigned int old_size = t->size;
+		t->slots = slots;
+		t->size = size;
+		t->count = 0;
+		for (unsigned int i = 0; i < old_size; i++) {
+			if (old[i] != NULL)
+				breakpoint_hash_put(t, old[i]);
+		}
+		free(old);
+	}
+
+	breakpoint_hash_put(t, bp);
+	return 0;
+}
+
+static void breakpoint_hash_remove(breakpoint_table_t *t, breakpoint_t *bp)
+{
+	if (t->count == 0 || bp->addr == 0)
+		return;
+
+	unsigned int mask = t->size - 1;
+	unsigned int i = breakpoint_slot(t, bp->addr);
+	while (t->slots[i] != NULL && t->slots[i] != bp)
+		i = (i + 1) & mask;
+
+	if (t->slots[i] == NULL)
+		return;
+
+	// pull back the entries whose home slot is not between the hole and
+	// their current slot, so no probe run is broken
+	for (unsigned int j = (i + 1) & mask; t->slots[j] != NULL;
+	    j = (j + 1) & mask) {
+		unsigned int home = breakpoint_slot(t, t->slots[j]->addr);
+		bool stays = (i <= j) ? (i < home && home <= j)
+				      : (i < home || home <= j);
+		if (!stays) {
+			t->slots[i] = t->slots[j];
+			i = j;
+		}
+	}
+
+	t->slots[i] = NULL;
+	t->count--;
+}
+
+// Changes the address of a breakpoint, keeping the table in sync.
+static int breakpoint_move(
+    tracee_t *tracee, breakpoint_t *bp, unsigned long long addr)
+{
+	breakpoint_hash_remove(&tracee->bps, bp);
+	displaced_forget(bp->addr);
+	bp->addr = addr;
+	if (addr == 0)
+		return 0;
+
+	return breakpoint_hash_insert(&tracee->bps, bp);
+}
 
 void breakpoint_delete(tracee_t *tracee, unsigned int idx)
 {
-	breakpoint_t **headp = &(tracee->bp_list);
-	breakpoint_t *t = NULL;
-	while (*headp != NULL) {
-		if ((*headp)->idx == idx) {
-			t = *headp;
-			*headp = t->next;
-			free(t);
-			return;
+	breakpoint_table_t *t = &tracee->bps;
+	if (idx == 0 || idx > t->last_idx || t->by_idx[idx] == NULL) {
+		pr_info_raw("No breakpoint number %u.\n", idx);
+		return;
+	}
+
+	breakpoint_t *bp = t->by_idx[idx];
+	mem_patch_t patch = { .addr = bp->addr };
+	if (bp->addr != 0 && mem_unpatch(tracee->pid, &patch, 1) == -1) {
+		pr_warn("could not restore the instruction at %#llx: %s",
+		    bp->addr, strerror(patch.err));
+	}
+
+	breakpoint_hash_remove(t, bp);
+	displaced_forget(bp->addr);
+	t->by_idx[idx] = NULL;
+	if (bp->sym != NULL)
+		bp->sym->bp = NULL;
+	if (tracee->pending_bp == bp)
+		tracee->pending_bp = NULL;
+	free(bp);
+}
+
+// Takes the breakpoints in [start, end) out of the text of an unloaded
+// library. Those on a function wait for breakpoint_reload, the others are
+// deleted.
+void breakpoint_unload(
+    tracee_t *tracee, unsigned long long start, unsigned long long end)
+{
+	breakpoint_table_t *t = &tracee->bps;
+	for (unsigned int i = 1; i <= t->last_idx; i++) {
+		breakpoint_t *bp = t->by_idx[i];
+		if (bp == NULL || bp->addr < start || bp->addr >= end)
+			continue;
+
+		if (tracee->pending_bp == bp)
+			tracee->pending_bp = NULL;
+
+		if (bp->sym == NULL) {
+			pr_info_raw("Breakpoint %u at %#llx deleted, its "
+				    "library was unloaded\n",
+			    bp->idx, bp->addr);
+			breakpoint_hash_remove(t, bp);
+			displaced_forget(bp->addr);
+			t->by_idx[i] = NULL;
+			free(bp);
+			continue;
+		}
+
+		pr_debug("breakpoint %u (%s) unloaded", bp->idx, bp->sym->name);
+		breakpoint_move(tracee, bp, 0);
+	}
+
+	mem_forget(start, end);
+}
+
+static int breakpoint_sym_addr_cmp(const void *a, const void *b)
+{
+	const symbol_t *x = (*(breakpoint_t **)a)->sym;
+	const symbol_t *y = (*(breakpoint_t **)b)->sym;
+
+	if (x->addr != y->addr)
+		return (x->addr < y->addr) ? -1 : 1;
+
+	return 0;
+}
+
+// Puts back the breakpoints waiting for the library at 'file' (the path its
+// symbols carry) to be loaded again, patched in one batch.
+int breakpoint_reload(tracee_t *tracee, const char *file)
+{
+	breakpoint_table_t *t = &tracee->bps;
+	unsigned int count = 0;
+	breakpoint_t **bps = NULL;
+	for (unsigned int i = 1; i <= t->last_idx; i++) {
+		breakpoint_t *bp = t->by_idx[i];
+		if (bp == NULL || bp->addr != 0 || bp->sym == NULL ||
+		    bp->sym->file_name != file || bp->sym->addr == 0) {
+			continue;
 		}
-		headp = &((*headp)->next);
+
+		if (bps == NULL) {
+			bps = calloc(t->last_idx, sizeof(breakpoint_t *));
+			if (bps == NULL) {
+				pr_err("error in allocating breakpoints to "
+				       "reload: %s",
+				    strerror(errno));
+				return -1;
+			}
+		}
+		bps[count++] = bp;
 	}
+
+	if (count == 0)
+		return 0;
+
+	mem_patch_t *patches = calloc(count, sizeof(mem_patch_t));
+	if (patches == NULL) {
+		pr_err("error in allocating breakpoints to reload: %s",
+		    strerror(errno));
+		free(bps);
+		return -1;
+	}
+
+	// bps stays in address order, so do the patches after mem_patch
+	// sorted them
+	qsort(bps, count, sizeof(breakpoint_t *), breakpoint_sym_addr_cmp);
+	unsigned int n = 0;
+	for (unsigned int i = 0; i < count; i++) {
+		unsigned long long addr = bps[i]->sym->addr;
+		if ((n > 0 && addr == patches[n - 1].addr) ||
+		    breakpoint_find(tracee, addr) != NULL) {
+			continue;
+		}
+
+		bps[n] = bps[i];
+		patches[n].addr = addr;
+		patches[n].byte = BREAKPOINT_INT3;
+		n++;
+	}
+
+	mem_patch(tracee->pid, patches, n);
+
+	int ret = 0;
+	for (unsigned int i = 0; i < n; i++) {
+		breakpoint_t *bp = bps[i];
+		if (!patches[i].ok) {
+			pr_warn("could not reload breakpoint %u at %#llx: %s",
+			    bp->idx, patches[i].addr,
+			    strerror(patches[i].err));
+			continue;
+		}
+
+		bp->value = patches[i].orig;
+		if (breakpoint_move(tracee, bp, patches[i].addr) == -1) {
+			ret = -1;
+			break;
+		}
+
+		pr_debug("breakpoint %u (%s) reloaded at %#llx", bp->idx,
+		    bp->sym->name, bp->addr);
+	}
+
+	free(patches);
+	free(bps);
+	return ret;
+}
+
+// Creates the breakpoint for an address already patched with INT3 ('data' is
+// the original word) and gives it the next number.
+static breakpoint_t *breakpoint_new(tracee_t *tracee, unsigned long long bpaddr,
+    long data, symbol_t *sym)
+{
+	breakpoint_table_t *t = &tracee->bps;
+	if (t->last_idx + 1 >= t->idx_cap) {
+		unsigned int cap = t->idx_cap ? t->idx_cap * 2 : 64;
+		breakpoint_t **by_idx =
+		    realloc(t->by_idx, cap * sizeof(breakpoint_t *));
+		if (by_idx == NULL) {
+			pr_err("breakpoint_add: cannot allocate breakpoint "
+			       "numbers");
+			return NULL;
+		}
+
+		memset(by_idx + t->idx_cap, 0,
+		    (cap - t->idx_cap) * sizeof(breakpoint_t *));
+		t->by_idx = by_idx;
+		t->idx_cap = cap;
+	}
+
+	breakpoint_t *bp = (breakpoint_t *)calloc(1, sizeof(breakpoint_t));
+	if (bp == NULL) {
+		pr_err("breakpoint_add: cannot allocate breakpoint");
+		return NULL;
+	}
+
+	bp->addr = bpaddr;
+	bp->value = data;
+	bp->counter = 0;
+	bp->sym = sym;
+	bp->is_plt_bp = false;
+	if (bpaddr != 0 && breakpoint_hash_insert(t, bp) == -1) {
+		free(bp);
+		return NULL;
+	}
+
+	bp->idx = ++t->last_idx;
+	t->by_idx[bp->idx] = bp;
+
+	if (sym != NULL) {
+		sym->bp = bp;
+
+		if (sym->section != NULL &&
+		    strncmp(sym->section->name, ".plt", 4) == 0) {
+			bp->is_plt_bp = 1;
+		}
+	}
+
+	return bp;
 }
 
 int breakpoint_add(tracee_t *tracee, unsigned long long bpaddr, symbol_t *sym)
@@ -63,36 +372,38 @@ int breakpoint_add(tracee_t *tracee, unsigned long long bpaddr, symbol_t *sym)
 		goto create_bp;
 	}
 
+	// the word saved for a second one would be the INT3 of the first
+	breakpoint_t *dup = breakpoint_find(tracee, bpaddr);
+	if (dup != NULL) {
+		pr_info_raw("Breakpoint %d already at address=%#llx\n",
+		    dup->idx, bpaddr);
+		return 0;
+	}
+
 	if (sym != NULL && sym->bp != NULL) {
 		pr_info_raw("There is already a breakpoint for '%s' present",
-		    sym->name);
+		    sym_demangle(sym->name));
 	}
 
-	data = ptrace(PTRACE_PEEKTEXT, tracee->pid, bpaddr, NULL);
-	if (data == -1 && errno != 0) {
+	mem_patch_t patch = { .addr = bpaddr, .byte = BREAKPOINT_INT3 };
+	if (mem_patch(tracee->pid, &patch, 1) == -1) {
 		// some error occured
-		if (errno == EIO || errno == EFAULT) {
+		if (patch.err == EIO || patch.err == EFAULT) {
 			pr_info_raw("the requested memory address(%#llx) is "
 				    "not accessible\n",
 			    bpaddr);
 		} else {
-			pr_err("reading the address(%#llx) failed: %s", bpaddr,
-			    strerror(errno));
+			pr_err("patching the address(%#llx) failed: %s",
+			    bpaddr, strerror(patch.err));
 		}
 
 		// this is not a critical error
 		return 0;
 	}
 
+	data = patch.orig;
 	pr_debug("instruction at address(%#llx): %#lx", bpaddr, (data & 0xFF));
 
-	unsigned long val = (data & 0xFFFFFFFFFFFFFF00UL) | 0xCCUL;
-	if (ptrace(PTRACE_POKETEXT, tracee->pid, bpaddr, val) == -1) {
-		pr_err("breakpoint_add: error in PTRACE_POKETEXT- %s",
-		    strerror(errno));
-		return -1;
-	}
-
 	if (bpaddr == tracee->debug.r_brk_addr) {
 		// this is a special breakpoint wont be added to the list
 		tracee->debug.r_brk_val = data;
@@ -101,49 +412,122 @@ int breakpoint_add(tracee_t *tracee, unsigned long long bpaddr, symbol_t *sym)
 	}
 
 create_bp:
-	breakpoint_t *bp = (breakpoint_t *)calloc(1, sizeof(breakpoint_t));
-	if (bp == NULL) {
-		pr_err("breakpoint_add: cannot allocate breakpoint");
+	breakpoint_t *bp = breakpoint_new(tracee, bpaddr, data, sym);
+	if (bp == NULL)
+		return -1;
+
+	if (bpaddr)
+		pr_info_raw(
+		    "Breakpoint %d added at address=%#llx\n", bp->idx, bpaddr);
+	else
+		pr_info_raw("Breakpoint %d for '%s' added\n", bp->idx,
+		    sym_demangle(sym->name));
+	return 0;
+}
+
+static int breakpoint_sym_cmp(const void *a, const void *b)
+{
+	const symbol_t *x = *(symbol_t **)a;
+	const symbol_t *y = *(symbol_t **)b;
+
+	if (x->addr != y->addr)
+		return (x->addr < y->addr) ? -1 : 1;
+
+	return 0;
+}
+
+int breakpoint_add_batch(tracee_t *tracee, symbol_t **syms, unsigned int count)
+{
+	if (count == 0)
+		return 0;
+
+	mem_patch_t *patches = calloc(count, sizeof(mem_patch_t));
+	if (patches == NULL) {
+		pr_err("breakpoint_add_batch: cannot allocate: %s",
+		    strerror(errno));
 		return -1;
 	}
 
-	bp->addr = bpaddr;
-	bp->value = data;
-	bp->idx = 1;
-	bp->counter = 0;
-	bp->sym = sym;
-	bp->is_plt_bp = false;
-	if (tracee->bp_list) {
-		bp->idx = tracee->bp_list->idx + 1;
+	// sorted, aliases of a symbol are next to each other
+	qsort(syms, count, sizeof(symbol_t *), breakpoint_sym_cmp);
+
+	unsigned int n = 0;
+	unsigned int skipped = 0;
+	for (unsigned int i = 0; i < count; i++) {
+		symbol_t *sym = syms[i];
+
+		// unresolved symbols, aliases of the previous one and symbols
+		// with a breakpoint already
+		if (sym->addr == 0 || sym->bp != NULL ||
+		    (i > 0 && sym->addr == syms[i - 1]->addr) ||
+		    breakpoint_find(tracee, sym->addr) != NULL) {
+			skipped++;
+			continue;
+		}
+
+		// syms stays in address order, so do the patches after
+		// mem_patch sorted them
+		syms[n] = sym;
+		patches[n].addr = sym->addr;
+		patches[n].byte = BREAKPOINT_INT3;
+		n++;
 	}
-	bp->next = tracee->bp_list;
-	tracee->bp_list = bp;
 
-	if (sym != NULL) {
-		sym->bp = bp;
+	mem_patch(tracee->pid, patches, n);
+
+	int ret = 0;
+	int first = -1;
+	int last = -1;
+	for (unsigned int i = 0; i < n; i++) {
+		if (!patches[i].ok) {
+			if (patches[i].err == EIO || patches[i].err == EFAULT) {
+				pr_info_raw("the requested memory "
+					    "address(%#llx) is not "
+					    "accessible\n",
+				    patches[i].addr);
+			} else {
+				pr_err("patching the address(%#llx) failed: "
+				       "%s",
+				    patches[i].addr, strerror(patches[i].err));
+			}
+			continue;
+		}
 
-		if (sym->section != NULL &&
-		    strncmp(sym->section->name, ".plt", 4) == 0) {
-			bp->is_plt_bp = 1;
+		breakpoint_t *bp =
+		    breakpoint_new(tracee, patches[i].addr, patches[i].orig,
+			syms[i]);
+		if (bp == NULL) {
+			ret = -1;
+			break;
 		}
+
+		if (first == -1)
+			first = bp->idx;
+		last = bp->idx;
 	}
 
-	if (bpaddr)
-		pr_info_raw(
-		    "Breakpoint %d added at address=%#llx\n", bp->idx, bpaddr);
-	else
-		pr_info_raw(
-		    "Breakpoint %d for '%s' added\n", bp->idx, sym->name);
-	return 0;
+	if (first != -1)
+		pr_info_raw("Breakpoints %d-%d added\n", first, last);
+	if (skipped > 0)
+		pr_info_raw("%u functions skipped (unresolved, aliased or "
+			    "already breakpointed)\n",
+		    skipped);
+
+	free(patches);
+	return ret;
 }
 
-static void breakpoint_print(breakpoint_t *bp)
+static void breakpoint_print(tracee_t *tracee, breakpoint_t *bp)
 {
+	sym_line_t loc;
 	if (bp->sym != NULL) {
 		symbol_t *sym = bp->sym;
 		pr_info_raw("Breakpoint %d, '%s' () at %#llx in %s\n", bp->idx,
-		    sym->name, sym->addr,
+		    sym_demangle(sym->name), sym->addr,
 		    sym->file_name == NULL ? "??" : sym->file_name);
+	} else if (sym_line_lookup_addr(tracee, bp->addr, &loc) == 0) {
+		pr_info_raw("Breakpoint %d, %#llx at %s:%u\n", bp->idx,
+		    bp->addr, loc.file, loc.line);
 	} else {
 		pr_info_raw("Breakpoint %d, %#llx\n", bp->idx, bp->addr);
 	}
@@ -151,24 +535,28 @@ static void breakpoint_print(breakpoint_t *bp)
 
 void breakpoint_printall(tracee_t *tracee)
 {
-	breakpoint_t *bp = tracee->bp_list;
-	while (bp) {
+	// newest first
+	for (unsigned int i = tracee->bps.last_idx; i > 0; i--) {
+		breakpoint_t *bp = tracee->bps.by_idx[i];
+		if (bp == NULL)
+			continue;
+
 		pr_info_raw("[%d]: name=%s, address=%#llx, hit_count=%d\n",
-		    bp->idx, bp->sym == NULL ? "??" : bp->sym->name, bp->addr,
-		    bp->counter);
+		    bp->idx,
+		    bp->sym == NULL ? "??" : sym_demangle(bp->sym->name),
+		    bp->addr, bp->counter);
 		pr_debug("value: %#lx", bp->value);
-		bp = bp->next;
 	}
 }
 
 // restores the original value and RIP for the bp being handled, this is the
 // first phase of the breakpoint cycle
-static int _breakpoint_restore_original(tracee_t *tracee,
-    struct user_regs_struct *reg, unsigned long bpaddr, unsigned long bpval)
+static int _breakpoint_restore_original(
+    tracee_t *tracee, struct user_regs_struct *reg, unsigned long bpaddr)
 {
-	if (ptrace(PTRACE_POKETEXT, tracee->pid, bpaddr, bpval) == -1) {
-		pr_err("breakpoint_handle: ptrace POKETEXT err - %s",
-		    strerror(errno));
+	if (mem_lift(tracee->pid, bpaddr) == -1) {
+		pr_err("breakpoint_handle: error in restoring %#lx - %s",
+		    bpaddr, strerror(errno));
 		return -1;
 	}
 
@@ -186,24 +574,50 @@ static int _breakpoint_restore_original(tracee_t *tracee,
 
 // restores the breakpoint at the address, this is the second phase of the
 // breakpoint cycle
-static int _breakpoint_restore_bp(
-    tracee_t *tracee, unsigned long bpaddr, unsigned long bpval)
+static int _breakpoint_restore_bp(tracee_t *tracee, unsigned long bpaddr)
 {
 	// single step and reset
 	DO_SINGLESTEP(tracee, -1);
 
 	// restore the breakpoint
-	unsigned long long val = (bpval & 0xFFFFFFFFFFFFFF00UL) | 0xCCUL;
-	if (ptrace(PTRACE_POKETEXT, tracee->pid, bpaddr, val) == -1) {
-		pr_err("breakpoint_handle: error in PTRACE_POKETEXT- %s",
-		    strerror(errno));
+	unsigned char int3 = BREAKPOINT_INT3;
+	if (mem_write(tracee->pid, bpaddr, &int3, 1) == -1) {
+		pr_err("breakpoint_handle: error in inserting INT3 at %#lx - "
+		       "%s",
+		    bpaddr, strerror(errno));
 		return -1;
 	}
 
 	return 0;
 }
 
-int breakpoint_pending(tracee_t *tracee)
+// Runs the instruction under the INT3 at 'bpaddr', the tracee is stopped
+// there. With 'cont' the caller continues the tracee right after.
+static int breakpoint_step_over(
+    tracee_t *tracee, unsigned long bpaddr, bool cont)
+{
+	struct user_regs_struct *regs = &breakpoint_regs;
+	if ((!breakpoint_regs_ok || regs->rip != bpaddr) &&
+	    ptrace(PTRACE_GETREGS, tracee->pid, NULL, regs) == -1) {
+		pr_err("error in getting registers: %s", strerror(errno));
+		return -1;
+	}
+
+	breakpoint_regs_ok = false;
+	int ret = 1;
+	if (regs->rip == bpaddr)
+		ret = displaced_step(tracee, regs, cont);
+	if (ret != 1)
+		return ret;
+
+	// in place: lift the INT3, step, put it back
+	if (_breakpoint_restore_original(tracee, NULL, bpaddr) == -1)
+		return -1;
+
+	return _breakpoint_restore_bp(tracee, bpaddr);
+}
+
+int breakpoint_pending(tracee_t *tracee, bool cont)
 {
 	// nothing to do
 	pr_debug("bp pending");
@@ -212,7 +626,7 @@ int breakpoint_pending(tracee_t *tracee)
 	}
 
 	breakpoint_t *bp = tracee->pending_bp;
-	if (_breakpoint_restore_bp(tracee, bp->addr, bp->value) == -1) {
+	if (breakpoint_step_over(tracee, bp->addr, cont) == -1) {
 		pr_err("error in resuming breakpoint");
 		return -1;
 	}
@@ -227,30 +641,23 @@ int breakpoint_update(
 	// type other than GLOB_DAT
 	if (bp->addr != 0) {
 		// restore the old breakpoint
-		if (_breakpoint_restore_original(
-			tracee, NULL, bp->addr, bp->value) == -1) {
-			pr_err("_breakpoint_restore_original failed");
+		mem_patch_t old = { .addr = bp->addr };
+		if (mem_unpatch(tracee->pid, &old, 1) == -1) {
+			pr_err("restoring the old breakpoint failed - %s",
+			    strerror(old.err));
 			return -1;
 		}
 	}
 
 	// add breakpoint to new place
-	long data = ptrace(PTRACE_PEEKTEXT, tracee->pid, new_addr, 0);
-	if (data == -1) {
-		pr_err("unable to get data at new_addr");
+	mem_patch_t patch = { .addr = new_addr, .byte = BREAKPOINT_INT3 };
+	if (mem_patch(tracee->pid, &patch, 1) == -1) {
+		pr_err("updating breakpoint failed - %s", strerror(patch.err));
 		return -1;
 	}
 
-	// update the breakpoint
-	unsigned long val = (data & 0xFFFFFFFFFFFFFF00UL) | 0xCCUL;
-	if (ptrace(PTRACE_POKETEXT, tracee->pid, new_addr, val) == -1) {
-		pr_err("updating breakpoint failed - %s", strerror(errno));
-		return -1;
-	}
-
-	bp->value = data;
-	bp->addr = new_addr;
-	return 0;
+	bp->value = patch.orig;
+	return breakpoint_move(tracee, bp, new_addr);
 }
 
 tracee_state_e breakpoint_handle(tracee_t *tracee)
@@ -267,15 +674,18 @@ tracee_state_e breakpoint_handle(tracee_t *tracee)
 
 	// since 0xCC occupies 1 byte and rip points to next address
 	regs.rip -= 1;
+	breakpoint_regs_ok = false;
 
 	if (regs.rip == tracee->debug.r_brk_addr) {
-		if (_breakpoint_restore_original(tracee, &regs,
-			tracee->debug.r_brk_addr,
-			tracee->debug.r_brk_val) == -1) {
-			pr_err("error in restoring original state to bp");
+		if (ptrace(PTRACE_SETREGS, tracee->pid, NULL, &regs) == -1) {
+			pr_err("breakpoint_handle: ptrace SETREGS error - %s",
+			    strerror(errno));
 			return TRACEE_STOPPED;
 		}
 
+		breakpoint_regs = regs;
+		breakpoint_regs_ok = true;
+
 		// we have received the breakpoint from r_brk
 		// update the map of symbols here
 		if (sym_handle_dldbg_syms(tracee) == -1) {
@@ -283,8 +693,8 @@ tracee_state_e breakpoint_handle(tracee_t *tracee)
 			return TRACEE_ERR;
 		}
 
-		if (_breakpoint_restore_bp(tracee, tracee->debug.r_brk_addr,
-			tracee->debug.r_brk_val) == -1) {
+		if (breakpoint_step_over(
+			tracee, tracee->debug.r_brk_addr, true) == -1) {
 			pr_err("error in resuming after linker bp");
 			return TRACEE_ERR;
 		}
@@ -298,30 +708,32 @@ tracee_state_e breakpoint_handle(tracee_t *tracee)
 	}
 
 	// check for SW breakpoint
-	bool found = false;
-	breakpoint_t *bp = tracee->bp_list;
-	while (bp) {
-		if (bp->addr == regs.rip) {
-			found = true;
-			break;
-		}
-
-		bp = bp->next;
-	}
-
-	if (!found) {
+	breakpoint_t *bp = breakpoint_find(tracee, regs.rip);
+	if (bp == NULL) {
 		pr_debug("no breakpoint found for addr: %llx", regs.rip);
 		pr_info_raw("tracee received signal: SIGTRAP\n");
 		return TRACEE_STOPPED;
 	}
 
-	// rewind back to the previous instruction and resume
-	if (_breakpoint_restore_original(tracee, &regs, bp->addr, bp->value) ==
-	    -1) {
+	// rewind back to the breakpoint, a PLT bp is stepped through the
+	// resolver with the original instruction in place
+	if (bp->is_plt_bp &&
+	    _breakpoint_restore_original(tracee, &regs, bp->addr) == -1) {
 		pr_err("error in restoring original state to bp");
 		return TRACEE_STOPPED;
 	}
 
+	if (!bp->is_plt_bp) {
+		if (ptrace(PTRACE_SETREGS, tracee->pid, NULL, &regs) == -1) {
+			pr_err("breakpoint_handle: ptrace SETREGS error - %s",
+			    strerror(errno));
+			return TRACEE_STOPPED;
+		}
+
+		breakpoint_regs = regs;
+		breakpoint_regs_ok = true;
+	}
+
 	// handle PLT bp
 	if (bp->is_plt_bp) {
 		// single step until GOT is changed;
@@ -341,21 +753,22 @@ tracee_state_e breakpoint_handle(tracee_t *tracee)
 			}
 		} while (got_val == new_val);
 
+		unsigned long long old_addr = bp->sym->addr;
 		SYM_UPDATE_ADDR(bp->sym, new_val);
 		pr_debug("GOT value changed for bp(%s), new_addr=%#llx",
 		    bp->sym->name, bp->sym->addr);
 
-		long new_data =
-		    ptrace(PTRACE_PEEKDATA, tracee->pid, new_val, 0);
-		if (new_data == -1) {
-			pr_err("error in getting data at new addr in bp");
+		// the PLT entry is no longer patched
+		mem_patch_t patch = { .addr = bp->addr };
+		if (mem_unpatch(tracee->pid, &patch, 1) == -1) {
+			pr_err("error in restoring the PLT entry: %s",
+			    strerror(patch.err));
 			return TRACEE_ERR;
 		}
 
-		pr_debug("new bp addr=%#lx, val=%#lx", new_val, new_data);
-		bp->addr = new_val;
-		bp->value = new_data;
-		sym_sort_trigger();
+		if (breakpoint_move(tracee, bp, new_val) == -1)
+			return TRACEE_ERR;
+		sym_addr_moved(bp->sym, old_addr);
 
 		// single step till that address ?
 		struct user_regs_struct r;
@@ -377,24 +790,65 @@ tracee_state_e breakpoint_handle(tracee_t *tracee)
 			}
 		}
 
+		// the target is reached, the INT3 goes in and is stepped over
+		// like any other when resuming
+		patch.addr = new_val;
+		patch.byte = BREAKPOINT_INT3;
+		if (mem_patch(tracee->pid, &patch, 1) == -1) {
+			pr_err("error in moving the bp to its new addr: %s",
+			    strerror(patch.err));
+			return TRACEE_ERR;
+		}
+
+		pr_debug("new bp addr=%#lx, val=%#lx", new_val, patch.orig);
+		bp->value = patch.orig;
 		bp->is_plt_bp = false;
 	}
 
+	// slots written since the last stop without a dl event (IRELATIVE in
+	// static executables) give their symbols an address
+	if (sym_resolve_pending(tracee) == -1) {
+		pr_warn("error in resolving pending symbols");
+	}
+
 	++bp->counter;
 	tracee->pending_bp = bp;
-	breakpoint_print(bp);
+	breakpoint_print(tracee, bp);
 	return TRACEE_STOPPED;
 }
 
 void breakpoint_cleanup(tracee_t *tracee)
 {
 	pr_debug("breakpoint cleanup");
-	breakpoint_t *bp = tracee->bp_list;
-	breakpoint_t *t = NULL;
-	while (bp != NULL) {
-		t = bp;
-		bp = bp->next;
-		free(t);
-	}
-	tracee->bp_list = NULL;
+	breakpoint_table_t *t = &tracee->bps;
+	displaced_reset();
+	breakpoint_regs_ok = false;
+
+	// put the original bytes back in one go, this matters when detaching
+	// from a process that keeps running; a tracee that is gone fails here
+	mem_patch_t *patches = calloc(t->count + 1, sizeof(mem_patch_t));
+	unsigned int n = 0;
+	for (unsigned int i = 1; patches != NULL && i <= t->last_idx; i++) {
+		breakpoint_t *bp = t->by_idx[i];
+		if (bp == NULL || bp->addr == 0)
+			continue;
+
+		patches[n++].addr = bp->addr;
+	}
+
+	if (patches != NULL && tracee->debug.r_brk_addr != 0 &&
+	    tracee->debug.r_brk_val != 0) {
+		patches[n++].addr = tracee->debug.r_brk_addr;
+	}
+
+	if (n > 0 && mem_unpatch(tracee->pid, patches, n) == -1)
+		pr_debug("could not restore every breakpoint");
+	free(patches);
+
+	for (unsigned int i = 1; i <= t->last_idx; i++)
+		free(t->by_idx[i]);
+
+	free(t->by_idx);
+	free(t->slots);
+	memset(t, 0, sizeof(*t));
 }
\ No newline at end of file
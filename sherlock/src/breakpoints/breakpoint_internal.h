@@ -0,0 +1,80 @@
+/*
+ * Sherlock - A Minimal Debugger
+ * Part of the Sherlock project
+ *
+ * Copyright (c) 2025-26 Mohammad Shehar Yaar Tausif <sheharyaar48@gmail.com>
+ *
+ * This file is licensed under the MIT License.
+ */
+
+#ifndef _SHERLOCK_BREAKPOINT_INTERNAL_H
+#define _SHERLOCK_BREAKPOINT_INTERNAL_H
+
+#include <sherlock/breakpoint.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/ptrace.h>
+#include <sys/user.h>
+#include <sys/wait.h>
+
+#define DO_SINGLESTEP(tracee, err)                                             \
+	do {                                                                   \
+		if (ptrace(PTRACE_SINGLESTEP, tracee->pid, NULL, 0) == -1) {   \
+			pr_err("error in singlestep");                         \
+			return err;                                            \
+		}                                                              \
+                                                                               \
+		int wstatus = 0;                                               \
+		if (waitpid(tracee->pid, &wstatus, 0) < 0) {                   \
+			pr_err("waitpid err: %s", strerror(errno));            \
+			return err;                                            \
+		}                                                              \
+                                                                               \
+		if (!WIFSTOPPED(wstatus)) {                                    \
+			pr_err("not stopped by SIGSTOP");                      \
+			return err;                                            \
+		}                                                              \
+	} while (0)
+
+#define INSN_MAX_LEN 15
+#define INSN_NONE 0xFF
+
+typedef enum INSN_KIND {
+	INSN_PLAIN,
+	// jcc, jmp, loop, jrcxz with a displacement
+	INSN_JUMP_REL,
+	INSN_CALL_REL,
+	// call and jmp through a register or memory
+	INSN_CALL_ABS,
+	INSN_JUMP_ABS,
+	INSN_RET,
+} insn_kind_e;
+
+typedef struct INSN {
+	unsigned char len;
+	insn_kind_e kind;
+	// offsets of the REX prefix, the 3-byte VEX prefix and the ModRM byte,
+	// INSN_NONE when there is none
+	unsigned char rex;
+	unsigned char vex3;
+	unsigned char modrm;
+	// the memory operand is [rip + disp32]
+	bool riprel;
+	// rax..rdi (bit per register number) named in the ModRM reg field or
+	// VEX.vvvv
+	unsigned char regs;
+} insn_t;
+
+int insn_decode(const unsigned char *code, size_t avail, insn_t *insn);
+
+int emulate_insn(tracee_t *tracee, const unsigned char *code,
+    const insn_t *insn, struct user_regs_struct *regs);
+
+int displaced_step(
+    tracee_t *tracee, struct user_regs_struct *regs, bool cont);
+void displaced_forget(unsigned long long addr);
+void displaced_reset(void);
+
+#endif
@@ -0,0 +1,331 @@
+/*
+ * Sherlock - A Minimal Debugger
+ * Part of the Sherlock project
+ *
+ * Copyright (c) 2025-26 Mohammad Shehar Yaar Tausif <sheharyaar48@gmail.com>
+ *
+ * This file is licensed under the MIT License.
+ */
+
+#include "breakpoint_internal.h"
+#include <sherlock/mem.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+/*
+ * Displaced stepping: resuming from a breakpoint runs a copy of the original
+ * instruction from a page of the tracee instead of lifting the INT3, stepping
+ * and writing it back, so the INT3 stays in the text for good (another thread
+ * going through it can never miss it) and the text is not written per hit.
+ *
+ * The page is mapped in the tracee on the first resume by running an mmap
+ * syscall instruction written over the breakpoint, it is never unmapped. It
+ * holds DISPLACED_SLOTS copies, a slot is picked by hashing the breakpoint
+ * address and keeps its copy until another breakpoint takes it:
+ *
+ *   plain instructions are followed by a jmp back to the next instruction,
+ *   when the tracee is continued only RIP is moved to the copy
+ *
+ *   a [rip + disp32] operand cannot reach its target from the page, the copy
+ *   uses [reg + disp32] instead, reg (rsi or rdi, one the instruction does
+ *   not name) holding the address the original RIP would have
+ *
+ *   those and branches (their target is relative to the copy, calls push the
+ *   address after the copy) are single-stepped, then RIP, the register and
+ *   the return address are fixed
+ *
+ * The instructions emulate.c knows (prologues) skip all of this, only the
+ * registers are set. Instructions insn_decode refuses are stepped in place by
+ * the caller. The decoded instruction is kept in the slot of its breakpoint,
+ * a hit reads nothing from the tracee once the slot is filled.
+ */
+
+#define DISPLACED_PAGE 4096UL
+#define DISPLACED_SLOT_SIZE 64UL
+#define DISPLACED_SLOTS (DISPLACED_PAGE / DISPLACED_SLOT_SIZE)
+#define DISPLACED_SLOT_BITS 6
+
+// jmp *0(%rip) followed by the 8-byte target
+#define DISPLACED_JMP_LEN 14
+
+typedef struct DISPLACED_SLOT {
+	// breakpoint address the slot is for, 0 when free
+	unsigned long long addr;
+	// the original instruction, decoded if 'ok'
+	unsigned char code[INSN_MAX_LEN];
+	insn_t insn;
+	bool ok;
+	// the copy is in the page
+	bool copied;
+	// register standing for RIP, -1 when the instruction has no
+	// [rip + disp32] operand
+	int reg;
+} displaced_slot_t;
+
+static unsigned long long displaced_page = 0;
+// the page could not be mapped, everything is stepped in place
+static bool displaced_off = false;
+static displaced_slot_t displaced_slots[DISPLACED_SLOTS];
+
+static unsigned int displaced_hash(unsigned long long addr)
+{
+	return (addr * 0x9E3779B97F4A7C15ULL) >> (64 - DISPLACED_SLOT_BITS);
+}
+
+static unsigned long long *displaced_reg(
+    struct user_regs_struct *regs, int reg)
+{
+	return (reg == 6) ? &regs->rsi : &regs->rdi;
+}
+
+// Maps the page by running a syscall instruction at the breakpoint the
+// tracee is stopped at ('regs'), its code and registers are put back.
+// Returns 1 if the step stopped for something else (a pending signal) and
+// the syscall did not run, it is tried again on a later hit.
+static int displaced_map(tracee_t *tracee, struct user_regs_struct *regs)
+{
+	static const unsigned char sys[2] = { 0x0F, 0x05 };
+	unsigned long long at = regs->rip;
+	unsigned char saved[sizeof(sys)];
+	if (mem_read_raw(tracee->pid, at, saved, sizeof(saved)) == -1 ||
+	    mem_write(tracee->pid, at, sys, sizeof(sys)) == -1) {
+		return -1;
+	}
+
+	struct user_regs_struct r = *regs;
+	r.rax = SYS_mmap;
+	r.rdi = 0;
+	r.rsi = DISPLACED_PAGE;
+	r.rdx = PROT_READ | PROT_EXEC;
+	r.r10 = MAP_PRIVATE | MAP_ANONYMOUS;
+	r.r8 = -1;
+	r.r9 = 0;
+
+	int ret = -1;
+	int wstatus = 0;
+	if (ptrace(PTRACE_SETREGS, tracee->pid, NULL, &r) == -1 ||
+	    ptrace(PTRACE_SINGLESTEP, tracee->pid, NULL, 0) == -1 ||
+	    waitpid(tracee->pid, &wstatus, 0) == -1) {
+		pr_debug("displaced page: cannot step the mmap: %s",
+		    strerror(errno));
+		goto out;
+	}
+
+	if (!WIFSTOPPED(wstatus)) {
+		pr_err("tracee did not stop after the mmap");
+		goto out;
+	}
+
+	// a signal-delivery-stop comes before the syscall, the signal is not
+	// passed on when the tracee is resumed, as for any other step
+	if (WSTOPSIG(wstatus) != SIGTRAP) {
+		pr_debug("displaced page: stopped by signal %d, not mapped",
+		    WSTOPSIG(wstatus));
+		ret = 1;
+		goto out;
+	}
+
+	// rax is only the result once the syscall has run
+	if (ptrace(PTRACE_GETREGS, tracee->pid, NULL, &r) == 0 &&
+	    r.rip == at + sizeof(sys) && r.rax < -4095ULL) {
+		displaced_page = r.rax;
+		ret = 0;
+	}
+
+out:
+	if (mem_write(tracee->pid, at, saved, sizeof(saved)) == -1 ||
+	    ptrace(PTRACE_SETREGS, tracee->pid, NULL, regs) == -1) {
+		pr_err("cannot restore the tracee after mapping the displaced "
+		       "stepping page: %s",
+		    strerror(errno));
+		return -1;
+	}
+
+	if (ret == 0)
+		pr_debug("displaced stepping page at %#llx", displaced_page);
+	return ret;
+}
+
+// Reads and decodes the instruction at 'addr' into the slot.
+static void displaced_decode(
+    tracee_t *tracee, displaced_slot_t *slot, unsigned long long addr)
+{
+	slot->addr = addr;
+	slot->ok = false;
+	slot->copied = false;
+	slot->reg = -1;
+
+	// through the shadow, the first byte is the INT3 in the text
+	size_t avail = INSN_MAX_LEN;
+	while (avail > 0 &&
+	    mem_read(tracee->pid, addr, slot->code, avail) == -1) {
+		avail--;
+	}
+
+	insn_t *insn = &slot->insn;
+	if (avail == 0 || insn_decode(slot->code, avail, insn) == -1)
+		return;
+
+	if (insn->riprel) {
+		if (!(insn->regs & (1 << 6)))
+			slot->reg = 6;
+		else if (!(insn->regs & (1 << 7)))
+			slot->reg = 7;
+		else
+			return;
+	}
+
+	slot->ok = true;
+}
+
+// Writes the copy of the slot's instruction at 'at'.
+static int displaced_copy(
+    tracee_t *tracee, displaced_slot_t *slot, unsigned long long at)
+{
+	insn_t *insn = &slot->insn;
+	unsigned char code[INSN_MAX_LEN + DISPLACED_JMP_LEN];
+	size_t len = insn->len;
+	memcpy(code, slot->code, len);
+	if (insn->riprel) {
+		// mod 00 rm 101 becomes mod 10 rm reg, REX.B / VEX.B cleared
+		unsigned char *m = &code[insn->modrm];
+		*m = (2 << 6) | (*m & 0x38) | slot->reg;
+		if (insn->rex != INSN_NONE)
+			code[insn->rex] &= ~0x01;
+		if (insn->vex3 != INSN_NONE)
+			code[insn->vex3 + 1] |= 0x20;
+	} else if (insn->kind == INSN_PLAIN) {
+		unsigned long long next = slot->addr + len;
+		static const unsigned char jmp[6] = { 0xFF, 0x25, 0, 0, 0, 0 };
+		memcpy(&code[len], jmp, sizeof(jmp));
+		memcpy(&code[len + sizeof(jmp)], &next, sizeof(next));
+		len += DISPLACED_JMP_LEN;
+	}
+
+	if (mem_write(tracee->pid, at, code, len) == -1) {
+		pr_debug("cannot write the displaced copy of %#llx: %s",
+		    slot->addr, strerror(errno));
+		return -1;
+	}
+
+	slot->copied = true;
+	return 0;
+}
+
+// Steps over the breakpoint the tracee is stopped at, 'regs' are its
+// registers (RIP is the breakpoint). With 'cont' the caller continues the
+// tracee next, plain instructions are then only pointed at. Otherwise the
+// tracee is left at the next instruction.
+// Returns 1 if the instruction has to be stepped in place (nothing changed),
+// -1 on error.
+int displaced_step(tracee_t *tracee, struct user_regs_struct *regs, bool cont)
+{
+	unsigned long long addr = regs->rip;
+	unsigned int idx = displaced_hash(addr);
+	displaced_slot_t *slot = &displaced_slots[idx];
+	if (slot->addr != addr)
+		displaced_decode(tracee, slot, addr);
+	if (!slot->ok)
+		return 1;
+
+	insn_t *insn = &slot->insn;
+	struct user_regs_struct r = *regs;
+	int ret = emulate_insn(tracee, slot->code, insn, &r);
+	if (ret == 0) {
+		if (ptrace(PTRACE_SETREGS, tracee->pid, NULL, &r) == -1) {
+			pr_err("emulate: error in setting registers: %s",
+			    strerror(errno));
+			return -1;
+		}
+
+		pr_debug("emulated the instruction at %#llx", addr);
+		return 0;
+	}
+
+	// a push that cannot write the stack faults when stepped too
+	if (ret == -1 || displaced_off)
+		return 1;
+
+	if (displaced_page == 0) {
+		ret = displaced_map(tracee, regs);
+		if (ret == -1) {
+			pr_warn("no displaced stepping page, stepping "
+				"breakpoints in place");
+			displaced_off = true;
+		}
+
+		if (ret != 0)
+			return 1;
+	}
+
+	unsigned long long at = displaced_page + idx * DISPLACED_SLOT_SIZE;
+	if (!slot->copied && displaced_copy(tracee, slot, at) == -1)
+		return 1;
+
+	unsigned long long next = addr + insn->len;
+	r = *regs;
+	r.rip = at;
+	if (slot->reg != -1)
+		*displaced_reg(&r, slot->reg) = next;
+
+	if (ptrace(PTRACE_SETREGS, tracee->pid, NULL, &r) == -1) {
+		pr_err("displaced step: error in setting registers: %s",
+		    strerror(errno));
+		return -1;
+	}
+
+	if (cont && slot->reg == -1 && insn->kind == INSN_PLAIN)
+		return 0;
+
+	DO_SINGLESTEP(tracee, -1);
+	if (ptrace(PTRACE_GETREGS, tracee->pid, NULL, &r) == -1) {
+		pr_err("displaced step: error in getting registers: %s",
+		    strerror(errno));
+		return -1;
+	}
+
+	if (slot->reg != -1) {
+		unsigned long long saved = *displaced_reg(regs, slot->reg);
+		*displaced_reg(&r, slot->reg) = saved;
+	}
+
+	// relative targets and the fall through (or the copy itself if it
+	// faulted) are off by the distance to the copy, absolute ones are right
+	bool in_copy = r.rip >= at && r.rip < at + DISPLACED_SLOT_SIZE;
+	if (in_copy || insn->kind == INSN_JUMP_REL ||
+	    insn->kind == INSN_CALL_REL) {
+		r.rip = r.rip - at + addr;
+	}
+
+	if ((insn->kind == INSN_CALL_REL || insn->kind == INSN_CALL_ABS) &&
+	    r.rsp == regs->rsp - sizeof(next) &&
+	    mem_write(tracee->pid, r.rsp, &next, sizeof(next)) == -1) {
+		pr_err("displaced step: error in fixing the return address: "
+		       "%s",
+		    strerror(errno));
+		return -1;
+	}
+
+	if (ptrace(PTRACE_SETREGS, tracee->pid, NULL, &r) == -1) {
+		pr_err("displaced step: error in setting registers: %s",
+		    strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+void displaced_forget(unsigned long long addr)
+{
+	displaced_slot_t *slot = &displaced_slots[displaced_hash(addr)];
+	if (slot->addr == addr)
+		slot->addr = 0;
+}
+
+void displaced_reset(void)
+{
+	displaced_page = 0;
+	displaced_off = false;
+	memset(displaced_slots, 0, sizeof(displaced_slots));
+}
@@ -0,0 +1,157 @@
+/*
+ * Sherlock - A Minimal Debugger
+ * Part of the Sherlock project
+ *
+ * Copyright (c) 2025-26 Mohammad Shehar Yaar Tausif <sheharyaar48@gmail.com>
+ *
+ * This file is licensed under the MIT License.
+ */
+
+#include "breakpoint_internal.h"
+#include <sherlock/mem.h>
+
+/*
+ * Emulation of the instructions function breakpoints land on. A prologue
+ * starts with some of
+ *
+ *   endbr64                f3 0f 1e fa
+ *   push %reg              50+r, 41 50+r
+ *   mov %rsp,%rbp          48 89 e5, 48 8b ec
+ *   sub $imm,%rsp          48 83 ec ib, 48 81 ec id
+ *
+ * and their effect is simple enough to apply to the registers of the stop
+ * (and the stack for a push) here, the tracee is then continued from the
+ * next instruction without running the original one at all. Anything else
+ * is left to displaced stepping.
+ */
+
+#define EFLAGS_CF (1ULL << 0)
+#define EFLAGS_PF (1ULL << 2)
+#define EFLAGS_AF (1ULL << 4)
+#define EFLAGS_ZF (1ULL << 6)
+#define EFLAGS_SF (1ULL << 7)
+#define EFLAGS_OF (1ULL << 11)
+
+static unsigned long long *emulate_reg(struct user_regs_struct *regs, int reg)
+{
+	switch (reg) {
+	case 0:
+		return &regs->rax;
+	case 1:
+		return &regs->rcx;
+	case 2:
+		return &regs->rdx;
+	case 3:
+		return &regs->rbx;
+	case 4:
+		return &regs->rsp;
+	case 5:
+		return &regs->rbp;
+	case 6:
+		return &regs->rsi;
+	case 7:
+		return &regs->rdi;
+	case 8:
+		return &regs->r8;
+	case 9:
+		return &regs->r9;
+	case 10:
+		return &regs->r10;
+	case 11:
+		return &regs->r11;
+	case 12:
+		return &regs->r12;
+	case 13:
+		return &regs->r13;
+	case 14:
+		return &regs->r14;
+	default:
+		return &regs->r15;
+	}
+}
+
+// The arithmetic flags of the 64-bit 'a - b'.
+static void emulate_sub_flags(
+    struct user_regs_struct *regs, uint64_t a, uint64_t b)
+{
+	uint64_t res = a - b;
+	unsigned long long fl = regs->eflags &
+	    ~(EFLAGS_CF | EFLAGS_PF | EFLAGS_AF | EFLAGS_ZF | EFLAGS_SF |
+		EFLAGS_OF);
+
+	if (a < b)
+		fl |= EFLAGS_CF;
+	if (!__builtin_parity(res & 0xFF))
+		fl |= EFLAGS_PF;
+	if ((a ^ b ^ res) & 0x10)
+		fl |= EFLAGS_AF;
+	if (res == 0)
+		fl |= EFLAGS_ZF;
+	if (res >> 63)
+		fl |= EFLAGS_SF;
+	if (((a ^ b) & (a ^ res)) >> 63)
+		fl |= EFLAGS_OF;
+
+	regs->eflags = fl;
+}
+
+// Applies the instruction 'code' (decoded as 'insn') to 'regs', RIP included.
+// Returns 1 if it is not one of the emulated ones (nothing changed), -1 if
+// the stack cannot be written.
+int emulate_insn(tracee_t *tracee, const unsigned char *code,
+    const insn_t *insn, struct user_regs_struct *regs)
+{
+	static const unsigned char endbr64[] = { 0xF3, 0x0F, 0x1E, 0xFA };
+	unsigned int len = insn->len;
+
+	if (len == sizeof(endbr64) && memcmp(code, endbr64, len) == 0) {
+		regs->rip += len;
+		return 0;
+	}
+
+	// push %reg, push %r8..%r15
+	if ((len == 1 && (code[0] & 0xF8) == 0x50) ||
+	    (len == 2 && code[0] == 0x41 && (code[1] & 0xF8) == 0x50)) {
+		int reg = (code[len - 1] & 7) + (len == 2 ? 8 : 0);
+		unsigned long long val = *emulate_reg(regs, reg);
+		unsigned long long sp = regs->rsp - sizeof(val);
+		if (mem_write(tracee->pid, sp, &val, sizeof(val)) == -1) {
+			pr_err("emulate: cannot push at %#llx: %s", sp,
+			    strerror(errno));
+			return -1;
+		}
+
+		regs->rsp = sp;
+		regs->rip += len;
+		return 0;
+	}
+
+	// mov %rsp,%rbp in both encodings
+	if (len == 3 && code[0] == 0x48 &&
+	    ((code[1] == 0x89 && code[2] == 0xE5) ||
+		(code[1] == 0x8B && code[2] == 0xEC))) {
+		regs->rbp = regs->rsp;
+		regs->rip += len;
+		return 0;
+	}
+
+	// sub $imm8,%rsp / sub $imm32,%rsp, both sign-extended
+	if (((len == 4 && code[1] == 0x83) || (len == 7 && code[1] == 0x81)) &&
+	    code[0] == 0x48 && code[2] == 0xEC) {
+		int64_t imm = 0;
+		if (len == 4) {
+			imm = (int8_t)code[3];
+		} else {
+			int32_t imm32;
+			memcpy(&imm32, &code[3], sizeof(imm32));
+			imm = imm32;
+		}
+
+		emulate_sub_flags(regs, regs->rsp, (uint64_t)imm);
+		regs->rsp -= (uint64_t)imm;
+		regs->rip += len;
+		return 0;
+	}
+
+	return 1;
+}
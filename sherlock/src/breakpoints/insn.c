@@ -0,0 +1,468 @@
+/*
+ * Sherlock - A Minimal Debugger
+ * Part of the Sherlock project
+ *
+ * Copyright (c) 2025-26 Mohammad Shehar Yaar Tausif <sheharyaar48@gmail.com>
+ *
+ * This file is licensed under the MIT License.
+ */
+
+#include "breakpoint_internal.h"
+
+/*
+ * Length decoder for x86-64 instructions, just enough to copy one somewhere
+ * else and run it there (displaced.c): its length, whether it reads RIP
+ * (a [rip + disp32] operand, a relative branch, a call pushing its return
+ * address) and which low registers it names. The opcode maps are the ones of
+ * the Intel SDM vol. 2, appendix A. Instructions that cannot run from a copy
+ * (far branches, xbegin, int, iret, 3DNow!, XOP) or that are invalid in
+ * 64-bit mode are refused, the caller steps those in place.
+ */
+
+typedef enum INSN_IMM {
+	IMM_NONE,
+	IMM_8,
+	IMM_16,
+	// 16 or 32 bits (operand size)
+	IMM_Z,
+	// 16, 32 or 64 bits (mov r, imm)
+	IMM_V,
+	// moffs of mov al/ax, 32 or 64 bits (address size)
+	IMM_ADDR,
+	// enter: imm16 and imm8
+	IMM_ENTER,
+} insn_imm_e;
+
+// One-byte opcodes (prefixes, REX, VEX/EVEX and 0F are handled before).
+// Returns false for the ones that are refused.
+static bool insn_map_legacy(
+    unsigned char op, bool *modrm, insn_imm_e *imm, insn_kind_e *kind)
+{
+	*modrm = false;
+	*imm = IMM_NONE;
+	*kind = INSN_PLAIN;
+
+	// the arithmetic block: op r/m,r / op r,r/m / op al,ib / op eax,iz
+	if (op < 0x40) {
+		switch (op & 7) {
+		case 0:
+		case 1:
+		case 2:
+		case 3:
+			*modrm = true;
+			return true;
+		case 4:
+			*imm = IMM_8;
+			return true;
+		case 5:
+			*imm = IMM_Z;
+			return true;
+		default:
+			// segment push/pop and BCD, invalid in 64-bit mode
+			return false;
+		}
+	}
+
+	if (op >= 0x50 && op <= 0x5F)
+		return true;
+
+	if (op >= 0x70 && op <= 0x7F) {
+		*imm = IMM_8;
+		*kind = INSN_JUMP_REL;
+		return true;
+	}
+
+	if (op >= 0x84 && op <= 0x8F) {
+		*modrm = true;
+		return true;
+	}
+
+	if ((op >= 0x90 && op <= 0x99) || (op >= 0x9B && op <= 0x9F))
+		return true;
+
+	if (op >= 0xB0 && op <= 0xB7) {
+		*imm = IMM_8;
+		return true;
+	}
+
+	if (op >= 0xB8 && op <= 0xBF) {
+		*imm = IMM_V;
+		return true;
+	}
+
+	if (op >= 0xD8 && op <= 0xDF) {
+		*modrm = true;
+		return true;
+	}
+
+	switch (op) {
+	case 0x63:
+	case 0xD0:
+	case 0xD1:
+	case 0xD2:
+	case 0xD3:
+	case 0xF6:
+	case 0xF7:
+	case 0xFE:
+	case 0xFF:
+		*modrm = true;
+		return true;
+	case 0x69:
+	case 0x81:
+	case 0xC7:
+		*modrm = true;
+		*imm = IMM_Z;
+		return true;
+	case 0x6B:
+	case 0x80:
+	case 0x83:
+	case 0xC0:
+	case 0xC1:
+	case 0xC6:
+		*modrm = true;
+		*imm = IMM_8;
+		return true;
+	case 0x68:
+	case 0xA9:
+		*imm = IMM_Z;
+		return true;
+	case 0x6A:
+	case 0xA8:
+	case 0xE4:
+	case 0xE5:
+	case 0xE6:
+	case 0xE7:
+		*imm = IMM_8;
+		return true;
+	case 0xA0:
+	case 0xA1:
+	case 0xA2:
+	case 0xA3:
+		*imm = IMM_ADDR;
+		return true;
+	case 0x6C:
+	case 0x6D:
+	case 0x6E:
+	case 0x6F:
+	case 0xA4:
+	case 0xA5:
+	case 0xA6:
+	case 0xA7:
+	case 0xAA:
+	case 0xAB:
+	case 0xAC:
+	case 0xAD:
+	case 0xAE:
+	case 0xAF:
+	case 0xC9:
+	case 0xD7:
+	case 0xEC:
+	case 0xED:
+	case 0xEE:
+	case 0xEF:
+	case 0xF4:
+	case 0xF5:
+	case 0xF8:
+	case 0xF9:
+	case 0xFA:
+	case 0xFB:
+	case 0xFC:
+	case 0xFD:
+		return true;
+	case 0xC2:
+		*imm = IMM_16;
+		*kind = INSN_RET;
+		return true;
+	case 0xC3:
+		*kind = INSN_RET;
+		return true;
+	case 0xC8:
+		*imm = IMM_ENTER;
+		return true;
+	case 0xE0:
+	case 0xE1:
+	case 0xE2:
+	case 0xE3:
+	case 0xEB:
+		*imm = IMM_8;
+		*kind = INSN_JUMP_REL;
+		return true;
+	case 0xE8:
+		*imm = IMM_Z;
+		*kind = INSN_CALL_REL;
+		return true;
+	case 0xE9:
+		*imm = IMM_Z;
+		*kind = INSN_JUMP_REL;
+		return true;
+	default:
+		// far branches, int, iret, retf, invalid opcodes
+		return false;
+	}
+}
+
+// The ones of the 0F map taking an imm8, also in VEX/EVEX map 1.
+static bool insn_0f_imm8(unsigned char op)
+{
+	return (op >= 0x70 && op <= 0x73) || op == 0xC2 || op == 0xC4 ||
+	    op == 0xC5 || op == 0xC6;
+}
+
+// Two-byte opcodes (0F xx, without 0F 38 and 0F 3A).
+static bool insn_map_0f(
+    unsigned char op, bool *modrm, insn_imm_e *imm, insn_kind_e *kind)
+{
+	*modrm = true;
+	*imm = insn_0f_imm8(op) || op == 0xA4 || op == 0xAC || op == 0xBA
+	    ? IMM_8
+	    : IMM_NONE;
+	*kind = INSN_PLAIN;
+
+	if (op >= 0x80 && op <= 0x8F) {
+		*modrm = false;
+		*imm = IMM_Z;
+		*kind = INSN_JUMP_REL;
+		return true;
+	}
+
+	if (op >= 0xC8 && op <= 0xCF) {
+		// bswap
+		*modrm = false;
+		return true;
+	}
+
+	switch (op) {
+	case 0x05:
+	case 0x06:
+	case 0x08:
+	case 0x09:
+	case 0x0B:
+	case 0x30:
+	case 0x31:
+	case 0x32:
+	case 0x33:
+	case 0x37:
+	case 0x77:
+	case 0xA0:
+	case 0xA1:
+	case 0xA2:
+	case 0xA8:
+	case 0xA9:
+		*modrm = false;
+		return true;
+	case 0x04:
+	case 0x07:
+	case 0x0A:
+	case 0x0C:
+	case 0x0F:
+	case 0x24:
+	case 0x25:
+	case 0x26:
+	case 0x27:
+	case 0x34:
+	case 0x35:
+	case 0x36:
+	case 0x39:
+	case 0x3B:
+	case 0x3C:
+	case 0x3D:
+	case 0x3E:
+	case 0x3F:
+	case 0xAA:
+		// sysret, sysenter/sysexit, rsm, 3DNow! and holes
+		return false;
+	default:
+		return true;
+	}
+}
+
+#define INSN_NEED(n)                                                           \
+	do {                                                                   \
+		if (i + (n) > avail || i + (n) > INSN_MAX_LEN)                 \
+			return -1;                                             \
+	} while (0)
+
+// Decodes the instruction at the start of 'code' ('avail' bytes readable).
+// Returns -1 if it is truncated or refused.
+int insn_decode(const unsigned char *code, size_t avail, insn_t *insn)
+{
+	memset(insn, 0, sizeof(*insn));
+	insn->rex = INSN_NONE;
+	insn->vex3 = INSN_NONE;
+	insn->modrm = INSN_NONE;
+
+	size_t i = 0;
+	bool opsize = false;
+	bool addr32 = false;
+	for (;; i++) {
+		INSN_NEED(1);
+		unsigned char b = code[i];
+		if (b == 0x66)
+			opsize = true;
+		else if (b == 0x67)
+			addr32 = true;
+		else if (b != 0xF0 && b != 0xF2 && b != 0xF3 && b != 0x2E &&
+		    b != 0x36 && b != 0x3E && b != 0x26 && b != 0x64 &&
+		    b != 0x65)
+			break;
+	}
+
+	bool rex_w = false;
+	bool rex_r = false;
+	if ((code[i] & 0xF0) == 0x40) {
+		insn->rex = i;
+		rex_w = code[i] & 0x08;
+		rex_r = code[i] & 0x04;
+		i++;
+	}
+
+	INSN_NEED(1);
+	unsigned char op = code[i++];
+	bool modrm = false;
+	bool legacy = false;
+	bool evex = false;
+	int vvvv = -1;
+	insn_imm_e imm = IMM_NONE;
+	insn_kind_e kind = INSN_PLAIN;
+	if (op == 0xC4 || op == 0xC5 || op == 0x62) {
+		if (insn->rex != INSN_NONE)
+			return -1;
+
+		unsigned int map = 1;
+		if (op == 0xC5) {
+			INSN_NEED(2);
+			rex_r = !(code[i] & 0x80);
+			vvvv = (~code[i] >> 3) & 0x0F;
+			i += 1;
+		} else if (op == 0xC4) {
+			INSN_NEED(3);
+			insn->vex3 = i - 1;
+			rex_r = !(code[i] & 0x80);
+			map = code[i] & 0x1F;
+			vvvv = (~code[i + 1] >> 3) & 0x0F;
+			i += 2;
+		} else {
+			INSN_NEED(4);
+			evex = true;
+			rex_r = !(code[i] & 0x80);
+			map = code[i] & 0x07;
+			vvvv = (~code[i + 1] >> 3) & 0x0F;
+			i += 3;
+		}
+
+		if (map < 1 || map > 3)
+			return -1;
+
+		op = code[i++];
+		modrm = !(map == 1 && op == 0x77);
+		if (map == 3 || (map == 1 && insn_0f_imm8(op)))
+			imm = IMM_8;
+	} else if (op == 0x0F) {
+		INSN_NEED(1);
+		op = code[i++];
+		if (op == 0x38 || op == 0x3A) {
+			INSN_NEED(1);
+			i++;
+			modrm = true;
+			imm = (op == 0x3A) ? IMM_8 : IMM_NONE;
+		} else if (!insn_map_0f(op, &modrm, &imm, &kind)) {
+			return -1;
+		}
+	} else {
+		// 8F with a reg field other than 0 is an XOP prefix
+		if (op == 0x8F && (i >= avail || (code[i] & 0x38) != 0))
+			return -1;
+		if (!insn_map_legacy(op, &modrm, &imm, &kind))
+			return -1;
+		legacy = true;
+	}
+
+	unsigned int reg = 0;
+	if (modrm) {
+		INSN_NEED(1);
+		insn->modrm = i;
+		unsigned char m = code[i++];
+		unsigned int mod = m >> 6;
+		unsigned int rm = m & 7;
+		reg = (m >> 3) & 7;
+
+		size_t disp = 0;
+		if (mod != 3 && rm == 4) {
+			INSN_NEED(1);
+			if (mod == 0 && (code[i] & 7) == 5)
+				disp = 4;
+			i++;
+		}
+
+		if (mod == 1)
+			disp = 1;
+		else if (mod == 2)
+			disp = 4;
+		else if (mod == 0 && rm == 5) {
+			disp = 4;
+			insn->riprel = true;
+		}
+
+		INSN_NEED(disp);
+		i += disp;
+
+		if (!rex_r)
+			insn->regs |= 1 << reg;
+	}
+
+	if (vvvv >= 0 && vvvv < 8)
+		insn->regs |= 1 << vvvv;
+
+	// eip-relative, or EVEX bits that would need rewriting too
+	if (insn->riprel && (addr32 || evex))
+		return -1;
+
+	// the opcodes whose ModRM reg field selects the operation
+	if (legacy && modrm) {
+		if ((op == 0xF6 || op == 0xF7) && reg < 2)
+			imm = (op == 0xF6) ? IMM_8 : IMM_Z;
+		if (op == 0xFF) {
+			if (reg == 2)
+				kind = INSN_CALL_ABS;
+			else if (reg == 4)
+				kind = INSN_JUMP_ABS;
+			else if (reg == 3 || reg == 5)
+				return -1;
+		}
+		// xbegin
+		if (op == 0xC7 && code[insn->modrm] == 0xF8)
+			return -1;
+	}
+
+	size_t len = 0;
+	switch (imm) {
+	case IMM_NONE:
+		break;
+	case IMM_8:
+		len = 1;
+		break;
+	case IMM_16:
+		len = 2;
+		break;
+	case IMM_Z:
+		// near branches keep a rel32 in 64-bit mode
+		len = (opsize && kind == INSN_PLAIN) ? 2 : 4;
+		break;
+	case IMM_V:
+		len = rex_w ? 8 : (opsize ? 2 : 4);
+		break;
+	case IMM_ADDR:
+		len = addr32 ? 4 : 8;
+		break;
+	case IMM_ENTER:
+		len = 3;
+		break;
+	}
+
+	INSN_NEED(len);
+	i += len;
+
+	insn->len = i;
+	insn->kind = kind;
+	return 0;
+}
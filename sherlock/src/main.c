@@ -13,6 +13,7 @@
 #include <errno.h>
 #include <sherlock/actions.h>
 #include <sherlock/breakpoint.h>
+#include <sherlock/mem.h>
 #include <sherlock/sym.h>
 #include <signal.h>
 #include <stdbool.h>
@@ -30,7 +31,7 @@
 	} while (0)
 
 static tracee_t global_tracee = {
-	.bp_list = NULL,
+	.bps = { 0 },
 	.pending_bp = NULL,
 	.debug = { .r_debug_addr = 0,
 	    .r_brk_addr = 0,
@@ -109,7 +110,8 @@ static int setup(int argc, char *argv[], tracee_t *tracee)
 
 static int setup_libunwind(tracee_t *tracee)
 {
-	tracee->unw_addr = unw_create_addr_space(&_UPT_accessors, 0);
+	// _UPT_accessors with memory reads going through the text shadow
+	tracee->unw_addr = unw_create_addr_space(mem_unw_accessors(), 0);
 	return 0;
 }
 
@@ -0,0 +1,550 @@
+/*
+ * Sherlock - A Minimal Debugger
+ * Part of the Sherlock project
+ *
+ * Copyright (c) 2025-26 Mohammad Shehar Yaar Tausif <sheharyaar48@gmail.com>
+ *
+ * This file is licensed under the MIT License.
+ */
+
+#define _GNU_SOURCE
+#include <sherlock/mem.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ptrace.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/*
+ * Access to the memory of the stopped tracee. /proc/<pid>/mem is opened once
+ * the tracee runs the program being debugged (after the exec, the file
+ * follows the address space it was opened on): pread and pwrite on it move
+ * any number of bytes per call, across pages, and writes go through
+ * read-only mappings like .text, which process_vm_writev refuses. Without it
+ * reads use process_vm_readv and writes PTRACE_POKEDATA, a word at a time.
+ *
+ * Breakpoints are patched in batches (mem_patch): sorted by address, the
+ * ones close to each other are covered by one read of the span, which also
+ * gives every patch its original word, and one write of the patched span.
+ * Spans end at MEM_PATCH_SPAN bytes so a batch over a large library does not
+ * rewrite all the code in between. The tracee is stopped, nothing changes the
+ * bytes between the read and the write.
+ *
+ * Every byte patched is shadowed: the page it is in gets a copy of the
+ * original text, with a bitmap of the offsets that hold a patch. Reads
+ * (mem_read, and libunwind through mem_unw_accessors) put the original bytes
+ * back in what they return, so nobody sees an INT3, not even mem_patch when
+ * a new breakpoint shares a word with an older one. Stepping over a
+ * breakpoint (mem_lift) writes the byte from the shadow without reading the
+ * tracee. Only the patched offsets of a copy are kept up to date, the text
+ * around them is read from the tracee every time. The shadow of an unloaded
+ * library is dropped (mem_forget), its text is gone with the patches.
+ */
+
+#define MEM_PATCH_SPAN 4096UL
+#define MEM_PAGE_SIZE 4096UL
+#define MEM_PAGE_MASK (~(MEM_PAGE_SIZE - 1))
+#define MEM_PROC_PATH "/proc/%d/mem"
+
+typedef struct MEM_SHADOW {
+	unsigned long long page;
+	// number of patched offsets
+	unsigned int count;
+	uint64_t patched[MEM_PAGE_SIZE / 64];
+	unsigned char orig[MEM_PAGE_SIZE];
+	UT_hash_handle hh;
+} mem_shadow_t;
+
+static int mem_fd = -1;
+static pid_t mem_pid = 0;
+static mem_shadow_t *mem_shadows = NULL;
+
+static void mem_shadow_clear(void)
+{
+	mem_shadow_t *sh, *tmp;
+	HASH_ITER(hh, mem_shadows, sh, tmp)
+	{
+		HASH_DEL(mem_shadows, sh);
+		free(sh);
+	}
+}
+
+static mem_shadow_t *mem_shadow_find(unsigned long long page)
+{
+	mem_shadow_t *sh = NULL;
+	HASH_FIND(hh, mem_shadows, &page, sizeof(page), sh);
+	return sh;
+}
+
+static bool mem_shadow_has(const mem_shadow_t *sh, size_t off)
+{
+	return (sh->patched[off / 64] >> (off % 64)) & 1;
+}
+
+// Gives the original byte at 'addr' if it is patched.
+static bool mem_shadow_get(unsigned long long addr, unsigned char *byte)
+{
+	mem_shadow_t *sh = mem_shadow_find(addr & MEM_PAGE_MASK);
+	size_t off = addr & ~MEM_PAGE_MASK;
+	if (sh == NULL || !mem_shadow_has(sh, off))
+		return false;
+
+	*byte = sh->orig[off];
+	return true;
+}
+
+// Records the original byte at 'addr', unless it is patched already.
+// Returns 1 if recorded, 0 if it was there and -1 on error.
+static int mem_shadow_add(unsigned long long addr, unsigned char byte)
+{
+	unsigned long long page = addr & MEM_PAGE_MASK;
+	size_t off = addr & ~MEM_PAGE_MASK;
+	mem_shadow_t *sh = mem_shadow_find(page);
+	if (sh == NULL) {
+		sh = calloc(1, sizeof(*sh));
+		if (sh == NULL) {
+			pr_err("error in allocating text shadow: %s",
+			    strerror(errno));
+			return -1;
+		}
+
+		sh->page = page;
+		HASH_ADD(hh, mem_shadows, page, sizeof(sh->page), sh);
+	}
+
+	if (mem_shadow_has(sh, off))
+		return 0;
+
+	sh->orig[off] = byte;
+	sh->patched[off / 64] |= 1ULL << (off % 64);
+	sh->count++;
+	return 1;
+}
+
+static void mem_shadow_del(unsigned long long addr)
+{
+	mem_shadow_t *sh = mem_shadow_find(addr & MEM_PAGE_MASK);
+	size_t off = addr & ~MEM_PAGE_MASK;
+	if (sh == NULL || !mem_shadow_has(sh, off))
+		return;
+
+	sh->patched[off / 64] &= ~(1ULL << (off % 64));
+	if (--sh->count == 0) {
+		HASH_DEL(mem_shadows, sh);
+		free(sh);
+	}
+}
+
+// Puts the original bytes of the patched offsets in [addr, addr + len) into
+// 'buf', which holds what was read from the tracee.
+static void mem_shadow_overlay(unsigned long long addr, void *buf, size_t len)
+{
+	if (mem_shadows == NULL || len == 0)
+		return;
+
+	unsigned long long end = addr + len;
+	for (unsigned long long page = addr & MEM_PAGE_MASK; page < end;
+	    page += MEM_PAGE_SIZE) {
+		mem_shadow_t *sh = mem_shadow_find(page);
+		if (sh == NULL)
+			continue;
+
+		size_t lo = (page < addr) ? addr - page : 0;
+		size_t hi = (end - page < MEM_PAGE_SIZE) ? end - page
+							   : MEM_PAGE_SIZE;
+		for (size_t off = lo; off < hi; off++) {
+			// most words of the bitmap are empty
+			if (sh->patched[off / 64] == 0) {
+				off |= 63;
+				continue;
+			}
+
+			if (mem_shadow_has(sh, off)) {
+				((unsigned char *)buf)[page + off - addr] =
+				    sh->orig[off];
+			}
+		}
+	}
+}
+
+int mem_open(pid_t pid)
+{
+	mem_close();
+
+	char path[64];
+	snprintf(path, sizeof(path), MEM_PROC_PATH, pid);
+	int fd = open(path, O_RDWR | O_CLOEXEC);
+	if (fd == -1) {
+		pr_warn("cannot open %s, using ptrace for memory access: %s",
+		    path, strerror(errno));
+		return -1;
+	}
+
+	mem_fd = fd;
+	mem_pid = pid;
+	return 0;
+}
+
+void mem_close(void)
+{
+	if (mem_fd != -1)
+		close(mem_fd);
+
+	mem_fd = -1;
+	mem_pid = 0;
+	mem_shadow_clear();
+}
+
+// Reads words with ptrace from 'done' (rounded down to a word) to 'len'.
+static int mem_peek(
+    pid_t pid, unsigned long long addr, void *buf, size_t len, size_t done)
+{
+	done &= ~(sizeof(long) - 1);
+	while (done < len) {
+		errno = 0;
+		long word = ptrace(PTRACE_PEEKDATA, pid, addr + done, 0);
+		if (word == -1 && errno != 0)
+			return -1;
+
+		size_t copy = len - done;
+		if (copy > sizeof(long))
+			copy = sizeof(long);
+		memcpy((char *)buf + done, &word, copy);
+		done += copy;
+	}
+
+	return 0;
+}
+
+// Reads the bytes as they are in the tracee, INT3s included.
+int mem_read_raw(pid_t pid, unsigned long long addr, void *buf, size_t len)
+{
+	size_t done = 0;
+	if (mem_fd != -1 && mem_pid == pid) {
+		while (done < len) {
+			ssize_t n = pread(mem_fd, (char *)buf + done,
+			    len - done, (off_t)(addr + done));
+			if (n == -1 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				break;
+			done += n;
+		}
+	} else {
+		struct iovec local = { .iov_base = buf, .iov_len = len };
+		struct iovec remote = { .iov_base = (void *)addr,
+			.iov_len = len };
+		ssize_t n = process_vm_readv(pid, &local, 1, &remote, 1, 0);
+		done = (n > 0) ? (size_t)n : 0;
+	}
+
+	if (done == len)
+		return 0;
+
+	// the transfer stops at a page it cannot read that way, ptrace can
+	// still read some of them (and sets errno for the others)
+	return mem_peek(pid, addr, buf, len, done);
+}
+
+int mem_read(pid_t pid, unsigned long long addr, void *buf, size_t len)
+{
+	if (mem_read_raw(pid, addr, buf, len) == -1)
+		return -1;
+
+	mem_shadow_overlay(addr, buf, len);
+	return 0;
+}
+// Writes with ptrace, the words at both ends are read first to keep the
+// bytes around the range.
+static int mem_poke(
+    pid_t pid, unsigned long long addr, const void *buf, size_t len)
+{
+	size_t done = 0;
+	while (done < len) {
+		unsigned long long at = addr + done;
+		unsigned long long word_addr = at & ~(sizeof(long) - 1);
+		size_t off = at - word_addr;
+		size_t copy = sizeof(long) - off;
+		if (copy > len - done)
+			copy = len - done;
+
+		long word = 0;
+		if (copy != sizeof(long)) {
+			errno = 0;
+			word = ptrace(PTRACE_PEEKDATA, pid, word_addr, 0);
+			if (word == -1 && errno != 0)
+				return -1;
+		}
+
+		memcpy((char *)&word + off, (const char *)buf + done, copy);
+		if (ptrace(PTRACE_POKEDATA, pid, word_addr, word) == -1)
+			return -1;
+		done += copy;
+	}
+
+	return 0;
+}
+
+int mem_write(pid_t pid, unsigned long long addr, const void *buf, size_t len)
+{
+	if (mem_fd == -1 || mem_pid != pid)
+		return mem_poke(pid, addr, buf, len);
+
+	size_t done = 0;
+	while (done < len) {
+		ssize_t n = pwrite(mem_fd, (const char *)buf + done, len - done,
+		    (off_t)(addr + done));
+		if (n == -1 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+		done += n;
+	}
+
+	return 0;
+}
+
+// Gives a patch its original word, as the shadow has it, and records the
+// byte it replaces. Returns 1 if the byte was recorded here, 0 if it was
+// already and -1 on error.
+static int mem_patch_prepare(mem_patch_t *p, const unsigned char *raw)
+{
+	memcpy(&p->orig, raw, sizeof(p->orig));
+	mem_shadow_overlay(p->addr, &p->orig, sizeof(p->orig));
+
+	int ret = mem_shadow_add(p->addr, p->orig & 0xFF);
+	if (ret == -1) {
+		p->ok = false;
+		p->err = ENOMEM;
+	}
+
+	return ret;
+}
+
+static void mem_patch_one(pid_t pid, mem_patch_t *p)
+{
+	p->ok = false;
+	unsigned char raw[sizeof(long)];
+	if (mem_read_raw(pid, p->addr, raw, sizeof(raw)) == -1) {
+		p->err = errno;
+		return;
+	}
+
+	int added = mem_patch_prepare(p, raw);
+	if (added == -1)
+		return;
+
+	if (mem_write(pid, p->addr, &p->byte, 1) == -1) {
+		p->err = errno;
+		if (added)
+			mem_shadow_del(p->addr);
+		return;
+	}
+
+	p->ok = true;
+}
+
+static int mem_patch_cmp(const void *a, const void *b)
+{
+	const mem_patch_t *x = a;
+	const mem_patch_t *y = b;
+
+	if (x->addr != y->addr)
+		return (x->addr < y->addr) ? -1 : 1;
+
+	return 0;
+}
+
+int mem_patch(pid_t pid, mem_patch_t *patches, unsigned int count)
+{
+	qsort(patches, count, sizeof(mem_patch_t), mem_patch_cmp);
+
+	unsigned char buf[MEM_PATCH_SPAN];
+	// the offsets in the span recorded by this run, dropped if the write
+	// fails
+	uint64_t added[MEM_PATCH_SPAN / 64];
+	int ret = 0;
+	unsigned int i = 0;
+	while (i < count) {
+		// the run of patches whose words fit in one span
+		unsigned long long lo = patches[i].addr;
+		unsigned int j = i + 1;
+		while (j < count &&
+		    patches[j].addr + sizeof(long) - lo <= MEM_PATCH_SPAN) {
+			j++;
+		}
+
+		unsigned long long hi = patches[j - 1].addr + sizeof(long);
+		if (j - i == 1 || mem_read_raw(pid, lo, buf, hi - lo) == -1) {
+			// one at a time, some of them may still be readable
+			for (; i < j; i++) {
+				mem_patch_one(pid, &patches[i]);
+				if (!patches[i].ok)
+					ret = -1;
+			}
+			continue;
+		}
+
+		// the original words first, a patch can be inside the word
+		// of the one before it
+		memset(added, 0, sizeof(added));
+		bool ok = true;
+		for (unsigned int k = i; k < j; k++) {
+			size_t off = patches[k].addr - lo;
+			int r = mem_patch_prepare(&patches[k], buf + off);
+			if (r == -1)
+				ok = false;
+			else if (r == 1)
+				added[off / 64] |= 1ULL << (off % 64);
+		}
+
+		for (unsigned int k = i; ok && k < j; k++)
+			buf[patches[k].addr - lo] = patches[k].byte;
+
+		size_t len = patches[j - 1].addr + 1 - lo;
+		int err = ENOMEM;
+		if (ok && mem_write(pid, lo, buf, len) == -1) {
+			err = errno;
+			ok = false;
+		}
+
+		for (unsigned int k = i; k < j; k++) {
+			size_t off = patches[k].addr - lo;
+			patches[k].ok = ok;
+			patches[k].err = ok ? 0 : err;
+			if (!ok && ((added[off / 64] >> (off % 64)) & 1))
+				mem_shadow_del(patches[k].addr);
+		}
+
+		if (!ok)
+			ret = -1;
+		i = j;
+	}
+
+	return ret;
+}
+
+int mem_unpatch(pid_t pid, mem_patch_t *patches, unsigned int count)
+{
+	qsort(patches, count, sizeof(mem_patch_t), mem_patch_cmp);
+
+	// a patch without a shadow has no original byte to put back, only
+	// that patch fails and the rest of its span is still written
+	int ret = 0;
+	for (unsigned int k = 0; k < count; k++) {
+		mem_patch_t *p = &patches[k];
+		p->ok = mem_shadow_get(p->addr, &p->byte);
+		p->err = p->ok ? 0 : ENOENT;
+		if (!p->ok)
+			ret = -1;
+	}
+
+	unsigned char buf[MEM_PATCH_SPAN];
+	unsigned int i = 0;
+	while (i < count) {
+		if (!patches[i].ok) {
+			i++;
+			continue;
+		}
+
+		unsigned long long lo = patches[i].addr;
+		unsigned int j = i + 1;
+		unsigned int last = i;
+		while (j < count &&
+		    patches[j].addr + 1 - lo <= MEM_PATCH_SPAN) {
+			if (patches[j].ok)
+				last = j;
+			j++;
+		}
+
+		// the original bytes come from the shadow, the bytes between
+		// them from the tracee
+		size_t len = patches[last].addr + 1 - lo;
+		bool ok = true;
+		if (last > i)
+			ok = mem_read_raw(pid, lo, buf, len) != -1;
+
+		if (ok) {
+			for (unsigned int k = i; k <= last; k++) {
+				mem_patch_t *p = &patches[k];
+				if (p->ok)
+					buf[p->addr - lo] = p->byte;
+			}
+			ok = mem_write(pid, lo, buf, len) != -1;
+		}
+
+		int err = errno;
+		for (unsigned int k = i; k < j; k++) {
+			if (!patches[k].ok)
+				continue;
+
+			patches[k].ok = ok;
+			patches[k].err = ok ? 0 : err;
+			if (ok)
+				mem_shadow_del(patches[k].addr);
+		}
+
+		if (!ok)
+			ret = -1;
+		i = j;
+	}
+
+	return ret;
+}
+
+// Drops the shadow of [start, end) without writing anything, the range is no
+// longer mapped.
+void mem_forget(unsigned long long start, unsigned long long end)
+{
+	mem_shadow_t *sh, *tmp;
+	HASH_ITER(hh, mem_shadows, sh, tmp)
+	{
+		if (sh->page + MEM_PAGE_SIZE > start && sh->page < end) {
+			HASH_DEL(mem_shadows, sh);
+			free(sh);
+		}
+	}
+}
+
+int mem_lift(pid_t pid, unsigned long long addr)
+{
+	unsigned char byte;
+	if (!mem_shadow_get(addr, &byte)) {
+		errno = ENOENT;
+		return -1;
+	}
+
+	return mem_write(pid, addr, &byte, 1);
+}
+
+// libunwind reads the text too (the instructions of a frame without unwind
+// info), through the shadow like everyone else.
+static int (*mem_upt_access_mem)(
+    unw_addr_space_t, unw_word_t, unw_word_t *, int, void *);
+
+static int mem_unw_access_mem(unw_addr_space_t as, unw_word_t addr,
+    unw_word_t *val, int write, void *arg)
+{
+	int ret = mem_upt_access_mem(as, addr, val, write, arg);
+	if (ret == 0 && !write)
+		mem_shadow_overlay(addr, val, sizeof(*val));
+
+	return ret;
+}
+
+unw_accessors_t *mem_unw_accessors(void)
+{
+	static unw_accessors_t accessors;
+
+	if (mem_upt_access_mem == NULL) {
+		accessors = _UPT_accessors;
+		mem_upt_access_mem = accessors.access_mem;
+		accessors.access_mem = mem_unw_access_mem;
+	}
+
+	return &accessors;
+}
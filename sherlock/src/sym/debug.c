@@ -49,6 +49,15 @@ int sym_handle_dldbg_syms(tracee_t *tracee)
 		return 0;
 	}
 
+	// objects may have been mapped or unmapped, pick up the new mappings
+	// and the objects that changed in the link map
+	if (sym_proc_map_refresh(tracee) == -1) {
+		pr_warn("error in refreshing the memory maps");
+	}
+	if (sym_lib_update(tracee) == -1) {
+		pr_debug("no link map, libraries are rescanned on next lookup");
+	}
+
 	// update the symbol map by reading the GOTs
 	if (sym_resolve_dyn(tracee) == -1) {
 		pr_err("error in updating symbols after dl load");
@@ -15,23 +15,49 @@
 #include <sherlock/breakpoint.h>
 
 static symbol_t *sherlock_symtab = NULL;
+static sym_addr_index_t sym_addr_index = { 0 };
+// dynamic symbols whose address changed after setup
+static sym_addr_index_t sym_moved_index = { 0 };
+static sym_name_index_t sym_name_index = { 0 };
+static sym_arena_t sym_arena = { 0 };
+static sym_cache_t sym_cache = { 0 };
+static sym_got_t sym_got = { 0 };
 static section_t *section_list = NULL;
 static unsigned int section_count = 0;
 static bool plt_sec = false;
 static unsigned long long plt_ent_start = 0UL;
 static unsigned long long plt_entsize = 0UL;
+// dynamic symbols still waiting for their slot to be written
+static unsigned int sym_unresolved = 0;
+// function pointers in data (R_X86_64_64) that ld.so has not relocated yet
+static symbol_t **sym_data_slots = NULL;
+static unsigned int sym_data_count = 0;
+static unsigned int sym_data_cap = 0;
 struct Elf *elf = NULL;
+// separate debug file the symbols come from
+static Elf *sym_dbg_elf = NULL;
+
+typedef struct SYM_IFUNC {
+	unsigned long long resolver;
+	const char *name;
+} sym_ifunc_t;
 
 section_t *sym_addr_section(unsigned long long addr, unsigned long long size)
 {
-	for (unsigned int i = 0; i < section_count; i++) {
-		if (addr >= section_list[i].start &&
-		    addr + size <= section_list[i].end) {
-			return &section_list[i];
-		}
-	}
+	section_t *sec = NULL;
+	SYM_RANGE_FIND(section_list, section_count, addr, size, sec);
+	return sec;
+}
 
-	return NULL;
+static int sym_section_cmp(const void *a, const void *b)
+{
+	const section_t *x = a;
+	const section_t *y = b;
+
+	if (x->start != y->start)
+		return (x->start < y->start) ? -1 : 1;
+
+	return 0;
 }
 
 static int sym_sort_cmp(void *a, void *b)
@@ -40,18 +66,30 @@ static int sym_sort_cmp(void *a, void *b)
 	return ((symbol_t *)b)->addr - ((symbol_t *)a)->addr;
 }
 
-void sym_sort_trigger() { HASH_SORT(sherlock_symtab, sym_sort_cmp); }
+void sym_addr_moved(symbol_t *sym, unsigned long long old_addr)
+{
+	if (sym_index_move(&sym_moved_index, sym, old_addr) == -1) {
+		pr_warn("error in updating the symbol address index");
+	}
+}
 
 static void sym_freeall(void)
 {
-	symbol_t *sym, *tmp;
-	HASH_ITER(hh, sherlock_symtab, sym, tmp)
-	{
-		HASH_DEL(sherlock_symtab, sym);
-		free(sym);
-	}
+	// the symbols belong to the arena, only the hash table itself needs to
+	// be released
+	HASH_CLEAR(hh, sherlock_symtab);
+	sym_arena_free(&sym_arena);
 
 	sherlock_symtab = NULL;
+	sym_index_free(&sym_addr_index);
+	sym_index_free(&sym_moved_index);
+	sym_name_index_free(&sym_name_index);
+	sym_got_free(&sym_got);
+	sym_unresolved = 0;
+	free(sym_data_slots);
+	sym_data_slots = NULL;
+	sym_data_count = 0;
+	sym_data_cap = 0;
 }
 
 void sym_printall(__attribute__((unused)) tracee_t *tracee)
@@ -77,55 +115,310 @@ void sym_printall(__attribute__((unused)) tracee_t *tracee)
 	}
 }
 
-int sym_resolve_dyn(tracee_t *tracee)
+// Gives a waiting symbol the address its slot now holds. Returns 1 if the
+// symbol moved.
+static int sym_resolve_addr(
+    tracee_t *tracee, symbol_t *sym, unsigned long long res_addr)
 {
-	symbol_t *sym, *t;
-	HASH_ITER(hh, sherlock_symtab, sym, t)
-	{
-		if (!sym->dyn_sym || !sym->needs_resolve) {
+	// not relocated yet, IRELATIVE slots stay 0 until the startup code
+	// (or ld.so) runs the resolver
+	if (sym->got.val == res_addr) {
+		return 0;
+	}
+
+	if (res_addr == 0) {
+		pr_err("invalid GOT value for sym(%s)", sym->name);
+		return -1;
+	}
+
+	pr_debug("[DL CHECK] sym=%s, got_addr=%#llx, got_val=%#llx,  "
+		 "new_val=%#llx",
+	    sym->name, sym->got.addr, sym->got.val, res_addr);
+
+	sym->got.val = res_addr;
+	// for PLT, we cant update the address, it will point to PLT[i]
+	// + 6
+	if (sym->addr != 0) {
+		return 0;
+	}
+
+	SYM_UPDATE_ADDR(sym, res_addr);
+	sym_addr_moved(sym, 0);
+
+	pr_debug("[DL LOAD] symbol=%s, new_addr=%#llx", sym->name, sym->addr);
+
+	if (sym->bp != NULL) {
+		if (breakpoint_update(tracee, sym->bp, sym->addr) == -1) {
+			pr_err("error in updating breakpoint");
+			return -1;
+		}
+	}
+
+	// TODO: create a new @plt sym and add to hashlist
+	return 1;
+}
+
+// Called for every GOT slot that changed since the last r_brk stop. Returns 1
+// if the symbol moved.
+static int sym_resolve_slot(symbol_t *sym, unsigned long long res_addr, void *arg)
+{
+	if (!sym->needs_resolve) {
+		return 0;
+	}
+
+	int moved = sym_resolve_addr(arg, sym, res_addr);
+	if (moved == 1 && sym_unresolved > 0)
+		sym_unresolved--;
+
+	return moved;
+}
+
+// Reads the R_X86_64_64 slots that ld.so has not relocated yet. A slot is
+// only taken once, after that the program may store its own pointers in it.
+static int sym_resolve_data(tracee_t *tracee)
+{
+	unsigned int i = 0;
+	while (i < sym_data_count) {
+		symbol_t *sym = sym_data_slots[i];
+		uint64_t val;
+		if (sym_mem_read(tracee->pid, sym->got.addr, &val,
+			sizeof(val)) == -1) {
+			return -1;
+		}
+
+		if (val == 0) {
+			i++;
 			continue;
 		}
 
-		long res_addr =
-		    ptrace(PTRACE_PEEKDATA, tracee->pid, sym->got.addr, 0);
-		if (res_addr == -1 || res_addr == 0) {
-			pr_err("error in reading GOT address : %s",
-			    strerror(errno));
+		if (sym_resolve_addr(tracee, sym, val) == -1)
 			return -1;
+
+		sym_data_slots[i] = sym_data_slots[--sym_data_count];
+	}
+
+	return 0;
+}
+
+int sym_resolve_dyn(tracee_t *tracee)
+{
+	// one read of the whole GOT, only the slots that changed since the
+	// last stop are looked at
+	int moved = sym_got_refresh(&sym_got, tracee->pid, sym_resolve_slot,
+	    tracee);
+	if (moved == -1) {
+		pr_err("error in reading GOT");
+		return -1;
+	}
+
+	if (sym_resolve_data(tracee) == -1) {
+		pr_err("error in reading data relocations");
+		return -1;
+	}
+
+	pr_debug("%d symbols moved", moved);
+	return 0;
+}
+
+int sym_resolve_pending(tracee_t *tracee)
+{
+	// static executables have no dl events, their IRELATIVE slots are
+	// only written by the startup code
+	if (sym_unresolved == 0)
+		return 0;
+
+	return sym_resolve_dyn(tracee);
+}
+
+// Finds the span of GOT slots (relative to the load base) that the function
+// relocations of a rela section point at, so they can be read in one go.
+static int sym_rela_got_range(Elf_Data *rela_data, Elf_Data *symtab_data,
+    size_t count, unsigned long long *lo, size_t *len)
+{
+	unsigned long long start = ~0ULL;
+	unsigned long long end = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		GElf_Rela rela;
+		if (gelf_getrela(rela_data, i, &rela) == NULL) {
+			pr_err("error in getting rela entry at index %ld", i);
+			return -1;
+		}
+
+		// IRELATIVE slots get the implementation the resolver picked
+		unsigned long type = GELF_R_TYPE(rela.r_info);
+		// R_X86_64_64 slots live in .data, they are read on their own
+		if (type != R_X86_64_JUMP_SLOT && type != R_X86_64_GLOB_DAT &&
+		    type != R_X86_64_IRELATIVE) {
+			continue;
 		}
 
-		pr_debug("[DL CHECK] sym=%s, got_addr=%#llx, got_val=%#llx,  "
-			 "new_val=%#lx",
-		    sym->name, sym->got.addr, sym->got.val, res_addr);
+		GElf_Sym sym;
+		if (type != R_X86_64_IRELATIVE) {
+			if (gelf_getsym(symtab_data, GELF_R_SYM(rela.r_info),
+				&sym) == NULL) {
+				pr_err("error in getting symbol from dynamic "
+				       "symtab");
+				return -1;
+			}
+
+			if (GELF_ST_TYPE(sym.st_info) != STT_FUNC)
+				continue;
+		}
+
+		if (rela.r_offset < start)
+			start = rela.r_offset;
+		if (rela.r_offset + sizeof(long) > end)
+			end = rela.r_offset + sizeof(long);
+	}
+
+	*lo = start;
+	*len = (end > start) ? end - start : 0;
+	return 0;
+}
+
+static int sym_ifunc_cmp(const void *a, const void *b)
+{
+	const sym_ifunc_t *x = a;
+	const sym_ifunc_t *y = b;
+
+	if (x->resolver != y->resolver)
+		return (x->resolver < y->resolver) ? -1 : 1;
+
+	return 0;
+}
+
+// Collects the ifunc symbols of the symtab sorted by resolver address, an
+// IRELATIVE relocation only has the resolver as addend.
+static sym_ifunc_t *sym_ifunc_collect(Elf *elf, Elf_Scn *symtab_scn,
+    Elf64_Shdr *symtab_hdr, size_t *n)
+{
+	*n = 0;
+	Elf_Data *data = elf_getdata(symtab_scn, NULL);
+	if (data == NULL || symtab_hdr->sh_entsize == 0)
+		return NULL;
 
-		if (sym->got.val == (unsigned long)res_addr) {
+	size_t count = symtab_hdr->sh_size / symtab_hdr->sh_entsize;
+	sym_ifunc_t *ifuncs = NULL;
+	size_t cap = 0;
+	for (size_t i = 0; i < count; i++) {
+		GElf_Sym sym;
+		if (gelf_getsym(data, i, &sym) == NULL ||
+		    GELF_ST_TYPE(sym.st_info) != STT_GNU_IFUNC ||
+		    sym.st_shndx == SHN_UNDEF) {
 			continue;
 		}
 
-		sym->got.val = res_addr;
-		// for PLT, we cant update the address, it will point to PLT[i]
-		// + 6
-		if (sym->addr != 0) {
+		const char *name =
+		    elf_strptr(elf, symtab_hdr->sh_link, sym.st_name);
+		if (name == NULL || name[0] == '\0')
 			continue;
+
+		if (*n == cap) {
+			cap = cap ? cap * 2 : 32;
+			sym_ifunc_t *t = realloc(ifuncs, cap * sizeof(*t));
+			if (t == NULL) {
+				pr_err("error in allocating ifuncs: %s",
+				    strerror(errno));
+				free(ifuncs);
+				*n = 0;
+				return NULL;
+			}
+			ifuncs = t;
 		}
 
-		SYM_UPDATE_ADDR(sym, res_addr);
+		ifuncs[*n].resolver = sym.st_value;
+		ifuncs[(*n)++].name = name;
+	}
 
-		pr_debug("[DL LOAD] symbol=%s, new_addr=%#llx", sym->name,
-		    sym->addr);
+	qsort(ifuncs, *n, sizeof(sym_ifunc_t), sym_ifunc_cmp);
+	return ifuncs;
+}
 
-		if (sym->bp != NULL) {
-			if (breakpoint_update(tracee, sym->bp, sym->addr) ==
-			    -1) {
-				pr_err("error in updating breakpoint");
-				return -1;
-			}
+// Creates a symbol for every ifunc resolved by the IRELATIVE relocation. The
+// slot holds the implementation the resolver picked once it has run, until
+// then the symbols wait for it like the GLOB_DAT ones.
+static int sym_add_irelative(tracee_t *tracee, GElf_Rela *rela,
+    sym_ifunc_t *ifuncs, size_t n, long got_val)
+{
+	unsigned long long addend = rela->r_addend;
+	unsigned long long resolver = tracee->va_base + addend;
+
+	// the unrelocated slot is 0, the addend or a PLT entry
+	section_t *sec = sym_addr_section(got_val, 0);
+	bool res = got_val == 0 || sec == NULL ||
+	    strncmp(sec->name, ".plt", 4) == 0 ||
+	    (unsigned long long)got_val == resolver;
+	unsigned long long addr = res ? 0 : (unsigned long long)got_val;
+
+	size_t lo = 0;
+	size_t hi = n;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (ifuncs[mid].resolver < addend)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo == n || ifuncs[lo].resolver != addend) {
+		pr_debug("no ifunc for resolver %#llx", addend);
+		return 0;
+	}
+
+	// aliases share the resolver and the slot
+	for (; lo < n && ifuncs[lo].resolver == addend; lo++) {
+		symbol_t *new_sym = sym_arena_alloc(&sym_arena);
+		if (!new_sym) {
+			pr_err("allocating sym failed");
+			return -1;
 		}
 
-		// TODO: create a new @plt sym and add to hashlist
+		SHERLOCK_SYMBOL_DYN(new_sym, 0UL, addr,
+		    tracee->va_base + rela->r_offset, got_val, ifuncs[lo].name,
+		    res);
+		if (res)
+			sym_unresolved++;
+
+		pr_debug("[ifunc symbol] name=%s, addr=%#llx, got_addr=%#llx, "
+			 "got_val=%#llx",
+		    new_sym->name, new_sym->addr, new_sym->got.addr,
+		    new_sym->got.val);
 	}
 
-	HASH_SORT(sherlock_symtab, sym_sort_cmp);
+	return 0;
+}
+
+// Creates the symbol of an R_X86_64_64 function pointer. The slot is outside
+// the GOT snapshot, ld.so writes it once while relocating and
+// sym_resolve_data picks it up from there.
+static int sym_add_data_slot(
+    tracee_t *tracee, GElf_Rela *rela, const char *name)
+{
+	if (sym_data_count == sym_data_cap) {
+		unsigned int cap = sym_data_cap ? sym_data_cap * 2 : 16;
+		symbol_t **t = realloc(sym_data_slots, cap * sizeof(*t));
+		if (t == NULL) {
+			pr_err("error in allocating data slots: %s",
+			    strerror(errno));
+			return -1;
+		}
+		sym_data_slots = t;
+		sym_data_cap = cap;
+	}
+
+	symbol_t *new_sym = sym_arena_alloc(&sym_arena);
+	if (!new_sym) {
+		pr_err("allocating sym failed");
+		return -1;
+	}
+
+	SHERLOCK_SYMBOL_DYN(new_sym, 0UL, 0UL,
+	    tracee->va_base + rela->r_offset, 0UL, name, false);
+	sym_data_slots[sym_data_count++] = new_sym;
+
+	pr_debug("[data symbol] name=%s, got_addr=%#llx", new_sym->name,
+	    new_sym->got.addr);
 	return 0;
 }
 
@@ -172,21 +465,80 @@ static int handle_dynamic_syms(__attribute__((unused)) tracee_t *tracee,
 	}
 
 	size_t count = hdr->sh_size / hdr->sh_entsize;
+	if (sym_arena_reserve(&sym_arena, count) == -1) {
+		pr_err("error in reserving dynamic symbols");
+		return -1;
+	}
 
+	// read all the GOT slots the relocations point at in one go instead
+	// of a PEEKTEXT per relocation
+	unsigned long long got_lo = 0;
+	unsigned char *got_buf = NULL;
+	size_t got_len = 0;
+	if (sym_rela_got_range(rela_data, symtab_data, count, &got_lo,
+		&got_len) == -1) {
+		return -1;
+	}
+
+	if (got_len > 0) {
+		got_buf = malloc(got_len);
+		if (got_buf == NULL) {
+			pr_err("error in allocating GOT buffer: %s",
+			    strerror(errno));
+			return -1;
+		}
+
+		if (sym_mem_read(tracee->pid, tracee->va_base + got_lo, got_buf,
+			got_len) == -1) {
+			pr_err("error in reading GOT values");
+			free(got_buf);
+			return -1;
+		}
+	}
+
+	int ret = -1;
+	sym_ifunc_t *ifuncs = NULL;
+	size_t ifunc_count = 0;
+	bool ifuncs_read = false;
 	for (size_t i = 0; i < count; i++) {
 		GElf_Rela rela;
 		if (gelf_getrela(rela_data, i, &rela) == NULL) {
 			pr_err("error in getting rela entry at "
 			       "index %ld",
 			    i);
-			return -1;
+			goto out;
+		}
+
+		unsigned long type = GELF_R_TYPE(rela.r_info);
+
+		// the slots point into the executable itself, its functions
+		// come from the symtab already
+		if (type == R_X86_64_RELATIVE) {
+			continue;
+		}
+
+		if (type == R_X86_64_IRELATIVE) {
+			if (!ifuncs_read) {
+				ifuncs = sym_ifunc_collect(elf, symtab_scn,
+				    symtab_hdr, &ifunc_count);
+				ifuncs_read = true;
+			}
+
+			long slot_val;
+			memcpy(&slot_val, got_buf + (rela.r_offset - got_lo),
+			    sizeof(slot_val));
+			if (sym_add_irelative(tracee, &rela, ifuncs,
+				ifunc_count, slot_val) == -1) {
+				goto out;
+			}
+			continue;
 		}
 
 		unsigned long sym_idx = GELF_R_SYM(rela.r_info);
 		GElf_Sym sym;
 		if (gelf_getsym(symtab_data, sym_idx, &sym) == NULL) {
 			pr_err("error in getting symbol from dynamic symtab");
-			return -1;
+			goto out;
 		}
 
 		// skip non function symbols
@@ -194,33 +546,40 @@ static int handle_dynamic_syms(__attribute__((unused)) tracee_t *tracee,
 			continue;
 		}
 
+		// a function pointer in data, &func + off is not a function
+		if (type == R_X86_64_64 && rela.r_addend != 0) {
+			pr_debug("skipping R_X86_64_64 with addend at %#lx",
+			    rela.r_offset);
+			continue;
+		}
+
 		unsigned long long base = 0UL;
 		unsigned long long addr = 0UL;
-		if (GELF_R_TYPE(rela.r_info) == R_X86_64_JUMP_SLOT) {
+		if (type == R_X86_64_JUMP_SLOT) {
 			addr = plt_ent_start + plt_entsize * i;
-		} else if (GELF_R_TYPE(rela.r_info) == R_X86_64_GLOB_DAT) {
+		} else if (type == R_X86_64_GLOB_DAT || type == R_X86_64_64) {
 			addr = 0;
 		} else {
-			// TODO [SYM_RES]: implement  RELATIVE
-			pr_err("type: %ld not implemented",
-			    GELF_R_TYPE(rela.r_info));
+			pr_err("type: %ld not implemented", type);
 			continue;
 		}
 
 		const char *name = elf_strptr(elf, strtab_idx, sym.st_name);
 		if (name == NULL || name[0] == '\0') {
 			pr_err("dynamic symbol name not present");
-			return -1;
+			goto out;
 		}
 
-		long got_val = ptrace(PTRACE_PEEKTEXT, tracee->pid,
-		    tracee->va_base + rela.r_offset, 0);
-		if (got_val == -1) {
-			pr_err("error in getting GOT val for sym(%s): %s", name,
-			    strerror(errno));
-			return -1;
+		if (type == R_X86_64_64) {
+			if (sym_add_data_slot(tracee, &rela, name) == -1)
+				goto out;
+			continue;
 		}
 
+		long got_val;
+		memcpy(&got_val, got_buf + (rela.r_offset - got_lo),
+		    sizeof(got_val));
+
 		bool res = true;
 		section_t *sec = sym_addr_section(got_val, 0);
 		if ((unsigned long)got_val > tracee->va_base) {
@@ -234,16 +593,18 @@ static int handle_dynamic_syms(__attribute__((unused)) tracee_t *tracee,
 			}
 		}
 
-		symbol_t *new_sym = calloc(1, sizeof(*new_sym));
+		symbol_t *new_sym = sym_arena_alloc(&sym_arena);
 		if (!new_sym) {
-			pr_err("calloc for sym failed: %s", strerror(errno));
-			return -1;
+			pr_err("allocating sym failed");
+			goto out;
 		}
 
 		// dynamic symbols, file_name will be set after address
 		// gets resolved.
 		SHERLOCK_SYMBOL_DYN(new_sym, base, addr,
 		    tracee->va_base + rela.r_offset, got_val, name, res);
+		if (res && addr == 0)
+			sym_unresolved++;
 
 		pr_debug("[dynamic symbol] name=%s, addr=%#llx, "
 			 "base=%#llx, got_addr=%#llx, got_val=%#llx",
@@ -251,7 +612,11 @@ static int handle_dynamic_syms(__attribute__((unused)) tracee_t *tracee,
 		    new_sym->got.addr, new_sym->got.val);
 	}
 
-	return 0;
+	ret = 0;
+out:
+	free(ifuncs);
+	free(got_buf);
+	return ret;
 }
 
 static int handle_static_syms(
@@ -271,6 +636,10 @@ static int handle_static_syms(
 	}
 
 	size_t count = hdr->sh_size / hdr->sh_entsize;
+	if (sym_arena_reserve(&sym_arena, count) == -1) {
+		pr_err("error in reserving static symbols");
+		return -1;
+	}
 
 	for (size_t i = 0; i < count; i++) {
 		GElf_Sym sym;
@@ -308,9 +677,9 @@ static int handle_static_syms(
 			return -1;
 		}
 
-		symbol_t *new_sym = calloc(1, sizeof(*new_sym));
+		symbol_t *new_sym = sym_arena_alloc(&sym_arena);
 		if (!new_sym) {
-			pr_err("calloc for sym failed: %s", strerror(errno));
+			pr_err("allocating sym failed");
 			return -1;
 		}
 
@@ -332,6 +701,45 @@ static int handle_static_syms(
 	return 0;
 }
 
+// Creates the static symbols from the on-disk cache, the names and hash values
+// are used in place from the cache mapping.
+static int handle_cached_syms(tracee_t *tracee, sym_cache_t *cache)
+{
+	if (sym_arena_reserve(&sym_arena, cache->count) == -1) {
+		pr_err("error in reserving cached symbols");
+		return -1;
+	}
+
+	for (uint32_t i = 0; i < cache->count; i++) {
+		const sym_cache_ent_t *e = &cache->ents[i];
+		symbol_t *new_sym = sym_arena_alloc(&sym_arena);
+		if (!new_sym) {
+			pr_err("allocating sym failed");
+			return -1;
+		}
+
+		new_sym->base = tracee->va_base;
+		new_sym->addr = tracee->va_base + e->addr;
+		new_sym->size = e->size;
+		new_sym->name = cache->strs + e->name;
+
+		mem_map_t *map = sym_proc_addr_map(new_sym->addr, new_sym->size);
+		if (map) {
+			new_sym->map = map;
+			new_sym->file_name = map->path;
+		}
+
+		if (e->file != SYM_CACHE_NO_FILE)
+			new_sym->file_name = cache->strs + e->file;
+
+		new_sym->section = sym_addr_section(new_sym->addr, new_sym->size);
+		HASH_ADD_KEYPTR_BYHASHVALUE(hh, sherlock_symtab, new_sym->name,
+		    e->name_len, e->hashv, new_sym);
+	}
+
+	return 0;
+}
+
 static int handle_dyn_linker(tracee_t *tracee, Elf_Scn *scn, Elf64_Shdr *hdr)
 {
 	// Read DT_DEBUG value from dynamic section
@@ -413,12 +821,21 @@ int sym_setup(tracee_t *tracee)
 		goto out;
 	}
 
-	elf = elf_begin(fd, ELF_C_READ, NULL);
+	// Map the file instead of reading it into the heap. The symbol and
+	// string tables are then used in place from the mapping, and only the
+	// pages that are actually touched become resident.
+	elf = elf_begin(fd, ELF_C_READ_MMAP, NULL);
 	if (elf == NULL) {
 		pr_err("error in elf_begin: %s", elf_errmsg(elf_errno()));
 		goto out;
 	}
 
+	// the whole file is mapped, libelf does not need the descriptor anymore
+	if (elf_cntl(elf, ELF_C_FDDONE) == -1) {
+		pr_err("error in elf_cntl: %s", elf_errmsg(elf_errno()));
+		goto elf_out;
+	}
+
 	size_t shstr_indx;
 	if (elf_getshdrstrndx(elf, &shstr_indx) == -1) {
 		pr_err(
@@ -513,6 +930,12 @@ int sym_setup(tracee_t *tracee)
 			continue;
 		}
 
+		// .tbss takes no space in the image and overlaps the sections
+		// after it, keep it out so the list stays non-overlapping
+		if ((hdr->sh_flags & SHF_TLS) && hdr->sh_type == SHT_NOBITS) {
+			continue;
+		}
+
 		section_t *t =
 		    realloc(section_list, (idx + 1) * sizeof(section_t));
 		if (t == NULL) {
@@ -533,12 +956,42 @@ int sym_setup(tracee_t *tracee)
 	}
 	section_count = idx;
 
-	if (symtab_scn) {
-		if (handle_static_syms(tracee, elf, symtab_scn, symtab_hdr) ==
-		    -1) {
-			pr_err("handling symtab failed");
+	// the section headers are usually in address order but nothing
+	// guarantees it, sym_addr_section needs them sorted
+	qsort(section_list, section_count, sizeof(section_t), sym_section_cmp);
+
+	// the cache is keyed by the build-id of the executable, a hit saves
+	// looking for the debug file as well
+	if (sym_cache_open(elf, tracee->exe_path, &sym_cache) == 0) {
+		if (handle_cached_syms(tracee, &sym_cache) == -1) {
+			pr_err("handling cached symtab failed");
 			goto syms_out;
 		}
+	} else {
+		// stripped, the symbols may be in a separate debug file
+		Elf *sym_elf = elf;
+		if (symtab_scn == NULL) {
+			sym_dbg_elf = sym_debug_open(elf, tracee->exe_path);
+			if (sym_dbg_elf != NULL) {
+				symtab_scn =
+				    sym_elf_symtab(sym_dbg_elf, &symtab_hdr);
+				sym_elf = sym_dbg_elf;
+			}
+		}
+
+		if (symtab_scn) {
+			if (handle_static_syms(
+				tracee, sym_elf, symtab_scn, symtab_hdr) == -1) {
+				pr_err("handling symtab failed");
+				goto syms_out;
+			}
+
+			// not fatal, the next run just parses the ELF again
+			if (sym_cache_store(elf, tracee->exe_path,
+				sherlock_symtab, tracee->va_base) == -1) {
+				pr_debug("symbol cache not saved");
+			}
+		}
 	}
 
 	if (rela_dyn_scn) {
@@ -557,7 +1010,21 @@ int sym_setup(tracee_t *tracee)
 		}
 	}
 
+	if (sym_got_build(&sym_got, sherlock_symtab) == -1) {
+		pr_err("building GOT snapshot failed");
+		goto syms_out;
+	}
+
 	HASH_SORT(sherlock_symtab, sym_sort_cmp);
+	if (sym_index_build(&sym_addr_index, sherlock_symtab) == -1) {
+		pr_err("building symbol address index failed");
+		goto syms_out;
+	}
+
+	// a process that is attached to has its data slots relocated already
+	if (sym_resolve_data(tracee) == -1) {
+		pr_warn("error in reading data relocations");
+	}
 
 	// Get the linker debug struct address (r_debug)
 	if (dyn_scn) {
@@ -568,6 +1035,15 @@ int sym_setup(tracee_t *tracee)
 		}
 	}
 
+	// the DWARF is only read on the first source line or variable query
+	sym_dwarf_setup(elf, tracee->exe_path);
+
+	// parse the libraries that are already mapped in the background, the
+	// prompt only needs the executable
+	if (sym_lib_preload(tracee) == -1) {
+		pr_warn("library symbols will be loaded on demand");
+	}
+
 #ifdef DEBUG
 	symbol_t *s, *t;
 	HASH_ITER(hh, sherlock_symtab, s, t)
@@ -577,13 +1053,20 @@ int sym_setup(tracee_t *tracee)
 	}
 #endif
 
-	// cant use elf_end here as the string pointers are in use.
+	// cant use elf_end here as the string pointers (into the mapping) are
+	// in use.
+	close(fd);
 	return 0;
 
 syms_out:
-	if (sherlock_symtab != NULL) {
+	if (sym_arena.head != NULL) {
 		sym_freeall();
 	}
+	sym_cache_close(&sym_cache);
+	if (sym_dbg_elf != NULL) {
+		elf_end(sym_dbg_elf);
+		sym_dbg_elf = NULL;
+	}
 
 sec_out:
 	if (section_list != NULL) {
@@ -599,53 +1082,104 @@ err:
 	return -1;
 }
 
-symbol_t *sym_lookup_name(__attribute__((unused)) tracee_t *tracee, char *name)
+int sym_foreach_name(tracee_t *tracee, char *name, sym_name_cb cb, void *arg)
 {
 	if (name == NULL || name[0] == '\0') {
-		pr_debug("invalid name to sym_lookup_name");
-		return NULL;
+		pr_debug("invalid name to sym_foreach_name");
+		return -1;
+	}
+
+	sym_name_spec_t q;
+	if (sym_name_parse(name, &q, false) == -1)
+		return -1;
+
+	bool exe =
+	    q.lib == NULL || sym_name_match_file(tracee->exe_path, q.lib, true);
+	bool libs = q.lib == NULL || !exe;
+
+	// the name as is first, in the executable and then the libraries
+	// (parsed on demand), then as a demangled C++ name in the same order
+	int rounds = (strncmp(q.name, "_Z", 2) == 0) ? 1 : 2;
+	for (int dm = 0; dm < rounds; dm++) {
+		int found = 0;
+		if (exe && dm == 0) {
+			found = sym_name_index_foreach(&sym_name_index,
+			    sherlock_symtab, &q, tracee, cb, arg);
+		} else if (exe) {
+			found = sym_demangle_index_foreach(&sym_name_index,
+			    sherlock_symtab, &q, tracee, cb, arg);
+		}
+
+		if (found == 0 && libs)
+			found = sym_lib_foreach_name(tracee, &q, dm, cb, arg);
+		if (found != 0)
+			return found;
 	}
 
-	symbol_t *s = NULL;
-	// TODO [LATER]: handle collisions and duplicate names
-	HASH_FIND_STR(sherlock_symtab, name, s);
-	return s;
+	return 0;
+}
+
+int sym_foreach_match(
+    tracee_t *tracee, char *pattern, sym_name_cb cb, void *arg)
+{
+	if (pattern == NULL || pattern[0] == '\0') {
+		pr_debug("invalid pattern to sym_foreach_match");
+		return -1;
+	}
+
+	sym_name_spec_t q;
+	if (sym_name_parse(pattern, &q, true) == -1)
+		return -1;
+
+	// without a library only the executable is searched, matching every
+	// library would parse all of them
+	if (q.lib == NULL || sym_name_match_file(tracee->exe_path, q.lib, true)) {
+		return sym_name_index_match(
+		    &sym_name_index, sherlock_symtab, &q, tracee, cb, arg);
+	}
+
+	return sym_lib_foreach_match(tracee, &q, cb, arg);
+}
+
+static int sym_lookup_name_cb(
+    __attribute__((unused)) tracee_t *tracee, symbol_t *sym, void *arg)
+{
+	*(symbol_t **)arg = sym;
+	return 1;
+}
+
+symbol_t *sym_lookup_name(tracee_t *tracee, char *name)
+{
+	// the first definition is the preferred one (global before local)
+	symbol_t *sym = NULL;
+	if (sym_foreach_name(tracee, name, sym_lookup_name_cb, &sym) <= 0)
+		return NULL;
+
+	return sym;
 }
 
-symbol_t *sym_lookup_addr(
-    __attribute__((unused)) tracee_t *tracee, unsigned long long addr)
+symbol_t *sym_lookup_addr(tracee_t *tracee, unsigned long long addr)
 {
 	if (addr == 0) {
 		return NULL;
 	}
 
-	// Handle
-	symbol_t *sym, *tmp;
-	HASH_ITER(hh, sherlock_symtab, sym, tmp)
-	{
-		// for static symbols, size is valid, so for static we
-		// can check if address belongs to [addr, addr+size]
-		if (!sym->dyn_sym) {
-			if (addr >= sym->addr &&
-			    addr <= sym->addr + sym->size) {
-				return sym;
-			}
-		} else {
-			// for dyamic, size is 0, we need to check addr
-			// >= addr and in the same memory section
-			if (addr >= sym->addr && addr <= sym->section->end) {
-				return sym;
-			}
-		}
-	}
+	// the closest symbol wins, as if both were one index
+	symbol_t *sym = sym_index_lookup(&sym_addr_index, addr);
+	symbol_t *moved = sym_index_lookup(&sym_moved_index, addr);
+	if (moved != NULL && (sym == NULL || moved->addr > sym->addr))
+		sym = moved;
+
+	if (sym != NULL)
+		return sym;
 
-	return NULL;
+	return sym_lib_lookup_addr(tracee, addr);
 }
 
 void sym_cleanup(__attribute__((unused)) tracee_t *tracee)
 {
 	pr_debug("sym cleanup");
-	if (sherlock_symtab != NULL) {
+	if (sym_arena.head != NULL) {
 		sym_freeall();
 	}
 
@@ -654,10 +1188,22 @@ void sym_cleanup(__attribute__((unused)) tracee_t *tracee)
 		section_list = NULL;
 	}
 
+	sym_line_cleanup();
+	sym_var_cleanup();
+	sym_frame_cleanup();
+	sym_dwarf_cleanup();
 	if (elf != NULL) {
 		elf_end(elf);
 		elf = NULL;
 	}
+	if (sym_dbg_elf != NULL) {
+		elf_end(sym_dbg_elf);
+		sym_dbg_elf = NULL;
+	}
 
+	sym_cache_close(&sym_cache);
+	sym_lib_cleanup();
+	sym_debug_cleanup();
+	sym_demangle_cleanup();
 	proc_cleanup(tracee);
 }
@@ -7,8 +7,9 @@
  * This file is licensed under the MIT License.
  */
 #define _XOPEN_SOURCE 700
-#include <sherlock/sym.h>
+#include "sym_internal.h"
 #include <errno.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
@@ -18,94 +19,383 @@
 #define PROC_COMM "/proc/%d/comm"
 #define PROC_EXE "/proc/%d/exe"
 
-static mem_map_t *memmap_list = NULL;
-unsigned int memmap_idx = 0;
+/*
+ * The mappings of the tracee, sorted by start address. Symbols keep pointers
+ * to their mapping (and to its path as file_name), so the entries are never
+ * moved or freed while the tracee is alive: they are allocated in chunks and
+ * the list only holds pointers. When the maps are refreshed after a dlopen or
+ * dlclose, mappings that are still there keep their entry, only new ones get
+ * a new entry and the ones that went away are dropped from the list.
+ *
+ * The paths are interned, every mapping of a file shares the same string.
+ */
+
+#define PROC_MAP_CHUNK_SIZE 64
+#define PROC_MAPS_BUF_MIN (64 * 1024)
+
+typedef struct PROC_MAP_CHUNK {
+	struct PROC_MAP_CHUNK *next;
+	unsigned int used;
+	mem_map_t maps[PROC_MAP_CHUNK_SIZE];
+} proc_map_chunk_t;
+
+typedef struct PROC_PATH {
+	UT_hash_handle hh;
+	char str[];
+} proc_path_t;
+
+static mem_map_t **memmap_list = NULL;
+static unsigned int memmap_idx = 0;
+static unsigned int memmap_cap = 0;
+
+// the list being built by a refresh, swapped with memmap_list at the end
+static mem_map_t **memmap_next = NULL;
+static unsigned int memmap_next_cap = 0;
+
+static proc_map_chunk_t *memmap_chunks = NULL;
+static proc_path_t *memmap_paths = NULL;
+
+// contents of the maps file, reused across refreshes
+static char *proc_maps_buf = NULL;
+static size_t proc_maps_cap = 0;
+
+// Index of the first mapping starting after 'addr'.
+static unsigned int sym_proc_map_after(unsigned long long addr)
+{
+	unsigned int lo = 0;
+	unsigned int hi = memmap_idx;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (memmap_list[mid]->start <= addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
 
 mem_map_t *sym_proc_addr_map(unsigned long long addr, unsigned long long size)
+{
+	unsigned int lo = sym_proc_map_after(addr);
+	if (lo > 0 && addr + size <= memmap_list[lo - 1]->end)
+		return memmap_list[lo - 1];
+
+	return NULL;
+}
+
+// Finds the mappings of the object that has one at 'addr'. Returns the first
+// one (at file offset 0) and sets 'end' to the end of the last one, or NULL if
+// 'addr' is not mapped from a file.
+mem_map_t *sym_proc_object_maps(
+    unsigned long long addr, unsigned long long *end)
+{
+	unsigned int i = sym_proc_map_after(addr);
+	if (i == 0 || addr >= memmap_list[i - 1]->end)
+		return NULL;
+
+	mem_map_t *map = memmap_list[--i];
+	if (map->inode == 0)
+		return NULL;
+
+	// the list only has the named mappings, the object's are adjacent
+	unsigned int first = i;
+	while (first > 0 && memmap_list[first]->offset != 0 &&
+	    memmap_list[first - 1]->inode == map->inode &&
+	    memmap_list[first - 1]->path == map->path) {
+		first--;
+	}
+
+	unsigned int last = i;
+	while (last + 1 < memmap_idx &&
+	    memmap_list[last + 1]->inode == map->inode &&
+	    memmap_list[last + 1]->path == map->path &&
+	    memmap_list[last + 1]->offset != 0) {
+		last++;
+	}
+
+	if (memmap_list[first]->offset != 0)
+		return NULL;
+
+	*end = memmap_list[last]->end;
+	return memmap_list[first];
+}
+
+// Calls 'cb' for every named mapping of the tracee as of the last refresh.
+// Stops and returns -1 if the callback fails.
+int sym_proc_map_foreach(sym_proc_map_cb cb, void *arg)
 {
 	for (unsigned int i = 0; i < memmap_idx; i++) {
-		if (addr >= memmap_list[i].start &&
-		    addr + size <= memmap_list[i].end) {
-			return &memmap_list[i];
+		if (cb(memmap_list[i], arg) == -1)
+			return -1;
+	}
+
+	return 0;
+}
+
+static const char *proc_path_intern(const char *str, size_t len)
+{
+	proc_path_t *p = NULL;
+	HASH_FIND(hh, memmap_paths, str, len, p);
+	if (p != NULL)
+		return p->str;
+
+	p = malloc(sizeof(*p) + len + 1);
+	if (p == NULL) {
+		pr_err("error in allocating map path: %s", strerror(errno));
+		return NULL;
+	}
+
+	memcpy(p->str, str, len);
+	p->str[len] = '\0';
+	HASH_ADD_KEYPTR(hh, memmap_paths, p->str, len, p);
+	return p->str;
+}
+
+static mem_map_t *proc_map_alloc(void)
+{
+	if (memmap_chunks == NULL || memmap_chunks->used == PROC_MAP_CHUNK_SIZE) {
+		proc_map_chunk_t *chunk = calloc(1, sizeof(*chunk));
+		if (chunk == NULL) {
+			pr_err("error in allocating map chunk: %s",
+			    strerror(errno));
+			return NULL;
 		}
+
+		chunk->next = memmap_chunks;
+		memmap_chunks = chunk;
 	}
 
-	return NULL;
+	return &memmap_chunks->maps[memmap_chunks->used++];
 }
 
-// Sets the base virtual address of the tracee using proc/<pid>/maps file.
-// Returns -1 on failure.
-int sym_proc_map_setup(tracee_t *tracee)
+// Reads the whole maps file into proc_maps_buf. Returns the length read or
+// -1 on error.
+static ssize_t proc_maps_read(pid_t pid)
 {
-	// read the /proc/pid/maps file and get the PID
 	char proc_maps_filename[SHERLOCK_MAX_STRLEN];
-	FILE *proc_maps_f = NULL;
-
 	if (snprintf(proc_maps_filename, SHERLOCK_MAX_STRLEN - 1, PROC_MAPS,
-		tracee->pid) < 0) {
+		pid) < 0) {
 		pr_err("snprint failed: %s", strerror(errno));
 		return -1;
 	}
 
-	if ((proc_maps_f = fopen(proc_maps_filename, "r")) == NULL) {
+	int fd = open(proc_maps_filename, O_RDONLY);
+	if (fd == -1) {
 		pr_err("opening pid map file failed: %s", strerror(errno));
 		return -1;
 	}
 
-	char line[512];
-	unsigned int idx = 0;
-	while (fgets(line, sizeof(line), proc_maps_f)) {
-		unsigned long long start, end, offset;
-		char perms[5];
-		char dev[16];
-		unsigned long inode;
-		char path[256] = { 0 };
+	size_t len = 0;
+	for (;;) {
+		if (proc_maps_cap - len < 4096) {
+			size_t cap = proc_maps_cap ? proc_maps_cap * 2
+						   : PROC_MAPS_BUF_MIN;
+			char *t = realloc(proc_maps_buf, cap);
+			if (t == NULL) {
+				pr_err("error in realloc maps buffer: %s",
+				    strerror(errno));
+				close(fd);
+				return -1;
+			}
 
-		int n = sscanf(line, "%llx-%llx %4s %llx %15s %lu %255[^\n]",
-		    &start, &end, perms, &offset, dev, &inode, path);
+			proc_maps_buf = t;
+			proc_maps_cap = cap;
+		}
 
-		pr_debug("[map] %llx-%llx perms=%s offset=0x%llx dev=%s "
-			 "inode=%lu path='%s'",
-		    start, end, perms, offset, dev, inode,
-		    (n == 7) ? path : "<none>");
+		// /proc reads return at most a page worth of whole lines
+		ssize_t n = read(fd, proc_maps_buf + len, proc_maps_cap - len);
+		if (n == -1) {
+			if (errno == EINTR)
+				continue;
 
-		// won't keep memory maps without a name
-		if (n < 7)
-			continue;
+			pr_err("reading pid map file failed: %s",
+			    strerror(errno));
+			close(fd);
+			return -1;
+		}
+
+		if (n == 0)
+			break;
 
-		// store the mapping into the memory map array
-		mem_map_t *m =
-		    realloc(memmap_list, (idx + 1) * sizeof(mem_map_t));
-		if (m == NULL) {
+		len += n;
+	}
+
+	close(fd);
+	return len;
+}
+
+static unsigned long long proc_parse_hex(const char **p, const char *end)
+{
+	unsigned long long val = 0;
+	for (; *p < end; (*p)++) {
+		char c = **p;
+		if (c >= '0' && c <= '9')
+			val = (val << 4) | (c - '0');
+		else if (c >= 'a' && c <= 'f')
+			val = (val << 4) | (c - 'a' + 10);
+		else
+			break;
+	}
+
+	return val;
+}
+
+static const char *proc_skip_field(const char *p, const char *end)
+{
+	while (p < end && *p != ' ' && *p != '\n')
+		p++;
+	while (p < end && *p == ' ')
+		p++;
+	return p;
+}
+
+// Parses one line of the maps file:
+//   start-end perms offset dev inode   path
+// Fills 'map' (except the path) and points 'path' at the path, which is
+// empty for anonymous mappings. Returns the start of the next line.
+static const char *proc_parse_line(const char *p, const char *end,
+    mem_map_t *map, const char **path, size_t *path_len)
+{
+	map->start = proc_parse_hex(&p, end);
+	if (p < end && *p == '-')
+		p++;
+	map->end = proc_parse_hex(&p, end);
+	while (p < end && *p == ' ')
+		p++;
+
+	p = proc_skip_field(p, end); // perms
+	map->offset = proc_parse_hex(&p, end);
+	while (p < end && *p == ' ')
+		p++;
+
+	p = proc_skip_field(p, end); // dev
+	map->inode = 0;
+	for (; p < end && *p >= '0' && *p <= '9'; p++)
+		map->inode = map->inode * 10 + (*p - '0');
+	while (p < end && *p == ' ')
+		p++;
+
+	const char *nl = memchr(p, '\n', end - p);
+	if (nl == NULL)
+		nl = end;
+
+	*path = p;
+	*path_len = nl - p;
+	return (nl < end) ? nl + 1 : end;
+}
+
+static int proc_map_next_push(unsigned int count, mem_map_t *map)
+{
+	if (count == memmap_next_cap) {
+		unsigned int cap = memmap_next_cap ? memmap_next_cap * 2 : 64;
+		mem_map_t **t = realloc(memmap_next, cap * sizeof(mem_map_t *));
+		if (t == NULL) {
 			pr_err("error in realloc memmap_list: %s",
 			    strerror(errno));
+			return -1;
+		}
 
-			if (memmap_list != NULL) {
-				free(memmap_list);
-				memmap_list = NULL;
-			}
+		memmap_next = t;
+		memmap_next_cap = cap;
+	}
+
+	memmap_next[count] = map;
+	return 0;
+}
+
+// Re-reads /proc/<pid>/maps and merges it into the current list. An entry is
+// kept if a mapping of the same file at the same start and offset is still
+// there (only its end is updated), so pointers to it stay meaningful.
+// Returns -1 on failure, the current list is left as is.
+int sym_proc_map_refresh(tracee_t *tracee)
+{
+	ssize_t len = proc_maps_read(tracee->pid);
+	if (len == -1)
+		return -1;
+
+	const char *p = proc_maps_buf;
+	const char *end = proc_maps_buf + len;
+	unsigned int old = 0;
+	unsigned int count = 0;
+	unsigned int added = 0;
 
+	while (p < end) {
+		mem_map_t map = { 0 };
+		const char *path;
+		size_t path_len;
+		p = proc_parse_line(p, end, &map, &path, &path_len);
+
+		// won't keep memory maps without a name
+		if (path_len == 0)
+			continue;
+
+		// the kernel lists the maps in address order, the binary search
+		// in sym_proc_addr_map relies on it
+		if (count > 0 && map.start < memmap_next[count - 1]->end) {
+			pr_warn("unordered map entry at %#llx, skipping",
+			    map.start);
+			continue;
+		}
+
+		map.path = proc_path_intern(path, path_len);
+		if (map.path == NULL)
 			return -1;
+
+		// both lists are sorted, skip the old entries that are gone
+		while (old < memmap_idx && memmap_list[old]->start < map.start)
+			old++;
+
+		mem_map_t *m = NULL;
+		if (old < memmap_idx && memmap_list[old]->start == map.start &&
+		    memmap_list[old]->offset == map.offset &&
+		    memmap_list[old]->inode == map.inode &&
+		    memmap_list[old]->path == map.path) {
+			m = memmap_list[old++];
+			m->end = map.end;
 		} else {
-			memmap_list = m;
+			m = proc_map_alloc();
+			if (m == NULL)
+				return -1;
+
+			*m = map;
+			added++;
 		}
 
-		memmap_list[idx].start = start;
-		memmap_list[idx].end = end;
-		// ignoring stncpy returned values for now
-		strncpy(memmap_list[idx].path, path, 255);
-		memmap_list[idx].path[SHERLOCK_MAX_STRLEN - 1] = '\0';
-		++idx;
+		if (proc_map_next_push(count, m) == -1)
+			return -1;
+		count++;
+	}
 
-		if (offset != 0 || strcmp(path, tracee->exe_path) != 0)
-			continue;
+	pr_debug("maps refreshed: %u entries, %u new", count, added);
 
-		tracee->va_base = start;
+	mem_map_t **t = memmap_list;
+	unsigned int cap = memmap_cap;
+	memmap_list = memmap_next;
+	memmap_cap = memmap_next_cap;
+	memmap_idx = count;
+	memmap_next = t;
+	memmap_next_cap = cap;
+	return 0;
+}
+
+// Sets the base virtual address of the tracee using proc/<pid>/maps file.
+// Returns -1 on failure.
+int sym_proc_map_setup(tracee_t *tracee)
+{
+	if (sym_proc_map_refresh(tracee) == -1)
+		return -1;
+
+	// only done once, sym_setup resets it for non-PIE executables
+	for (unsigned int i = 0; i < memmap_idx; i++) {
+		mem_map_t *m = memmap_list[i];
+		if (m->offset == 0 && strcmp(m->path, tracee->exe_path) == 0) {
+			tracee->va_base = m->start;
+			break;
+		}
 	}
 
-	memmap_idx = idx;
 	pr_debug("start address=%#llx", tracee->va_base);
-	fclose(proc_maps_f);
 	return 0;
 }
 
@@ -189,8 +479,29 @@ int sym_proc_pid_info(tracee_t *tracee)
 
 void proc_cleanup(__attribute__((unused)) tracee_t *tracee)
 {
-	if (memmap_list != NULL) {
-		free(memmap_list);
-		memmap_list = NULL;
+	free(memmap_list);
+	memmap_list = NULL;
+	memmap_idx = 0;
+	memmap_cap = 0;
+
+	free(memmap_next);
+	memmap_next = NULL;
+	memmap_next_cap = 0;
+
+	while (memmap_chunks != NULL) {
+		proc_map_chunk_t *t = memmap_chunks;
+		memmap_chunks = t->next;
+		free(t);
 	}
+
+	proc_path_t *path, *tmp;
+	HASH_ITER(hh, memmap_paths, path, tmp)
+	{
+		HASH_DEL(memmap_paths, path);
+		free(path);
+	}
+
+	free(proc_maps_buf);
+	proc_maps_buf = NULL;
+	proc_maps_cap = 0;
 }
\ No newline at end of file
@@ -0,0 +1,108 @@
+/*
+ * Sherlock - A Minimal Debugger
+ * Part of the Sherlock project
+ *
+ * Copyright (c) 2025-26 Mohammad Shehar Yaar Tausif <sheharyaar48@gmail.com>
+ *
+ * This file is licensed under the MIT License.
+ */
+
+#include "sym_internal.h"
+
+/*
+ * Symbols are never freed one by one, they live as long as the tracee does. So
+ * instead of a calloc per symbol, they are carved out of large zeroed chunks.
+ * The callers know how many symbols a section can hold (sh_size / sh_entsize),
+ * so they reserve that up-front and a whole symbol table costs one allocation.
+ * A reservation that does not fit starts with what is left in the current
+ * chunk, the new chunk only covers the rest and is used once the current one
+ * is full. Teardown frees the chunks without touching the symbols.
+ */
+
+#define SYM_ARENA_CHUNK_MIN 1024
+
+static sym_arena_chunk_t *sym_arena_chunk_new(size_t cap)
+{
+	sym_arena_chunk_t *chunk =
+	    calloc(1, sizeof(*chunk) + cap * sizeof(symbol_t));
+	if (chunk == NULL) {
+		pr_err("error in allocating symbol arena chunk: %s",
+		    strerror(errno));
+		return NULL;
+	}
+
+	chunk->cap = cap;
+	chunk->used = 0;
+	return chunk;
+}
+
+int sym_arena_reserve(sym_arena_t *arena, size_t count)
+{
+	sym_arena_chunk_t *head = arena->head;
+	size_t left = (head != NULL) ? head->cap - head->used : 0;
+	if (left >= count)
+		return 0;
+
+	count -= left;
+	if (count < SYM_ARENA_CHUNK_MIN)
+		count = SYM_ARENA_CHUNK_MIN;
+
+	sym_arena_chunk_t *chunk = sym_arena_chunk_new(count);
+	if (chunk == NULL)
+		return -1;
+
+	// the space left in the head goes first, the new chunk is next in line
+	if (left > 0) {
+		chunk->next = head->next;
+		head->next = chunk;
+	} else {
+		chunk->next = head;
+		arena->head = chunk;
+	}
+	return 0;
+}
+
+symbol_t *sym_arena_alloc(sym_arena_t *arena)
+{
+	sym_arena_chunk_t *head = arena->head;
+	if (head != NULL && head->used == head->cap) {
+		// move on to a chunk reserved behind the full head
+		for (sym_arena_chunk_t *prev = head; prev->next != NULL;
+		    prev = prev->next) {
+			sym_arena_chunk_t *chunk = prev->next;
+			if (chunk->used == chunk->cap)
+				continue;
+
+			prev->next = chunk->next;
+			chunk->next = head;
+			arena->head = chunk;
+			head = chunk;
+			break;
+		}
+	}
+
+	if (head == NULL || head->used == head->cap) {
+		// grow geometrically when the caller did not reserve enough
+		size_t cap = (head == NULL) ? SYM_ARENA_CHUNK_MIN : head->cap * 2;
+		if (sym_arena_reserve(arena, cap) == -1)
+			return NULL;
+
+		head = arena->head;
+	}
+
+	arena->count++;
+	return &head->syms[head->used++];
+}
+
+void sym_arena_free(sym_arena_t *arena)
+{
+	sym_arena_chunk_t *chunk = arena->head;
+	while (chunk != NULL) {
+		sym_arena_chunk_t *t = chunk;
+		chunk = chunk->next;
+		free(t);
+	}
+
+	arena->head = NULL;
+	arena->count = 0;
+}
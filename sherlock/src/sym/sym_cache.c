@@ -0,0 +1,504 @@
+/*
+ * Sherlock - A Minimal Debugger
+ * Part of the Sherlock project
+ *
+ * Copyright (c) 2025-26 Mohammad Shehar Yaar Tausif <sheharyaar48@gmail.com>
+ *
+ * This file is licensed under the MIT License.
+ */
+
+#define _GNU_SOURCE
+#include "sym_internal.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * On-disk cache of the static symbols of an executable, keyed by its GNU
+ * build-id: $XDG_CACHE_HOME/sherlock/<build-id>.idx (~/.cache if unset).
+ *
+ * The file is meant to be mapped and used in place:
+ *
+ *   sym_cache_hdr_t
+ *   sym_cache_ent_t[count]   sorted by address, addresses relative to va_base
+ *   char strings[]           names, NUL terminated
+ *
+ * Each entry also carries the name length and its uthash hash value, so the
+ * name table can be rebuilt without hashing the strings again. The header
+ * records the hash of a fixed key, the values are only reused when uthash
+ * still hashes it the same way (same HASH_FUNCTION). The string
+ * offsets of every entry are checked when the file is opened, a truncated or
+ * corrupt file is removed like a stale one.
+ *
+ * An entry is stale when the executable size or mtime does not match the one
+ * recorded in the header (same build-id but e.g. stripped afterwards) or it
+ * was written with another hash function, it is then rewritten. The directory is kept under SYM_CACHE_MAX_SIZE by removing
+ * the least recently used entries; a hit refreshes the entry's mtime.
+ */
+
+#define SYM_CACHE_MAGIC "SHRLKIDX"
+#define SYM_CACHE_VERSION 2
+#define SYM_CACHE_DIR "sherlock"
+#define SYM_CACHE_MAX_SIZE (256UL * 1024 * 1024)
+
+typedef struct SYM_CACHE_HDR {
+	char magic[8];
+	uint32_t version;
+	// sym_cache_hash_id() of the writer
+	uint32_t hash_id;
+	uint32_t build_id_len;
+	unsigned char build_id[SYM_BUILD_ID_MAX];
+	uint64_t exe_size;
+	int64_t exe_mtime;
+	uint32_t count;
+	uint32_t str_size;
+} sym_cache_hdr_t;
+
+// Reads the NT_GNU_BUILD_ID note. Returns the length of the id, 0 if the
+// binary does not have one.
+size_t sym_elf_build_id(Elf *elf, unsigned char *buf, size_t len)
+{
+	Elf_Scn *scn = NULL;
+	while ((scn = elf_nextscn(elf, scn)) != NULL) {
+		Elf64_Shdr *hdr = elf64_getshdr(scn);
+		if (hdr == NULL || hdr->sh_type != SHT_NOTE)
+			continue;
+
+		Elf_Data *data = elf_getdata(scn, NULL);
+		if (data == NULL)
+			continue;
+
+		size_t off = 0;
+		size_t name_off, desc_off;
+		GElf_Nhdr nhdr;
+		while ((off = gelf_getnote(data, off, &nhdr, &name_off,
+			    &desc_off)) > 0) {
+			if (nhdr.n_type != NT_GNU_BUILD_ID ||
+			    nhdr.n_namesz != 4 ||
+			    memcmp((char *)data->d_buf + name_off, "GNU", 4) !=
+				0) {
+				continue;
+			}
+
+			if (nhdr.n_descsz == 0 || nhdr.n_descsz > len)
+				return 0;
+
+			memcpy(buf, (char *)data->d_buf + desc_off,
+			    nhdr.n_descsz);
+			return nhdr.n_descsz;
+		}
+	}
+
+	return 0;
+}
+
+// Hash of a fixed key, tells whether the stored hash values can be reused.
+static uint32_t sym_cache_hash_id(void)
+{
+	unsigned hashv;
+	HASH_VALUE(SYM_CACHE_MAGIC, sizeof(SYM_CACHE_MAGIC) - 1, hashv);
+	return hashv;
+}
+
+static int sym_cache_dir(char *buf, size_t len)
+{
+	const char *base = getenv("XDG_CACHE_HOME");
+	int n;
+	if (base != NULL && base[0] != '\0') {
+		n = snprintf(buf, len, "%s/" SYM_CACHE_DIR, base);
+	} else {
+		const char *home = getenv("HOME");
+		if (home == NULL || home[0] == '\0')
+			return -1;
+
+		n = snprintf(buf, len, "%s/.cache/" SYM_CACHE_DIR, home);
+	}
+
+	if (n < 0 || (size_t)n >= len)
+		return -1;
+
+	return 0;
+}
+
+static int sym_cache_path(Elf *elf, char *buf, size_t len,
+    unsigned char *build_id, size_t *build_id_len)
+{
+	*build_id_len = sym_elf_build_id(elf, build_id, SYM_BUILD_ID_MAX);
+	if (*build_id_len == 0) {
+		pr_debug("no build-id, symbol cache not used");
+		return -1;
+	}
+
+	char dir[SHERLOCK_MAX_STRLEN];
+	if (sym_cache_dir(dir, sizeof(dir)) == -1)
+		return -1;
+
+	char hex[SYM_BUILD_ID_MAX * 2 + 1];
+	for (size_t i = 0; i < *build_id_len; i++)
+		sprintf(&hex[i * 2], "%02x", build_id[i]);
+
+	int n = snprintf(buf, len, "%s/%s.idx", dir, hex);
+	if (n < 0 || (size_t)n >= len)
+		return -1;
+
+	return 0;
+}
+
+// Checks that every entry's strings lie in the string table and are NUL
+// terminated, the loader uses them in place.
+static bool sym_cache_ents_valid(const sym_cache_hdr_t *hdr)
+{
+	const sym_cache_ent_t *ents = (const sym_cache_ent_t *)(hdr + 1);
+	const char *strs = (const char *)(ents + hdr->count);
+	uint64_t str_size = hdr->str_size;
+
+	for (uint32_t i = 0; i < hdr->count; i++) {
+		const sym_cache_ent_t *e = &ents[i];
+		if ((uint64_t)e->name + e->name_len >= str_size ||
+		    strs[e->name + e->name_len] != '\0') {
+			return false;
+		}
+
+		if (e->file != SYM_CACHE_NO_FILE &&
+		    (e->file >= str_size ||
+			memchr(strs + e->file, '\0', str_size - e->file) ==
+			    NULL)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int sym_cache_open(Elf *elf, const char *exe_path, sym_cache_t *cache)
+{
+	char path[SHERLOCK_MAX_STRLEN * 2];
+	unsigned char build_id[SYM_BUILD_ID_MAX];
+	size_t build_id_len = 0;
+	if (sym_cache_path(elf, path, sizeof(path), build_id, &build_id_len) ==
+	    -1) {
+		return -1;
+	}
+
+	struct stat exe_st;
+	if (stat(exe_path, &exe_st) == -1)
+		return -1;
+
+	int fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		pr_debug("no symbol cache at %s", path);
+		return -1;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) == -1 ||
+	    (size_t)st.st_size < sizeof(sym_cache_hdr_t)) {
+		close(fd);
+		return -1;
+	}
+
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		pr_debug("error in mapping %s: %s", path, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	const sym_cache_hdr_t *hdr = map;
+	size_t need = sizeof(*hdr) +
+	    (size_t)hdr->count * sizeof(sym_cache_ent_t) + hdr->str_size;
+	if (memcmp(hdr->magic, SYM_CACHE_MAGIC, sizeof(hdr->magic)) != 0 ||
+	    hdr->version != SYM_CACHE_VERSION ||
+	    hdr->build_id_len != build_id_len ||
+	    memcmp(hdr->build_id, build_id, build_id_len) != 0 ||
+	    (size_t)st.st_size < need || !sym_cache_ents_valid(hdr)) {
+		pr_debug("invalid symbol cache %s", path);
+		goto stale;
+	}
+
+	if (hdr->exe_size != (uint64_t)exe_st.st_size ||
+	    hdr->exe_mtime != (int64_t)exe_st.st_mtime ||
+	    hdr->hash_id != sym_cache_hash_id()) {
+		pr_debug("stale symbol cache %s", path);
+		goto stale;
+	}
+
+	// mark as recently used for the eviction
+	futimens(fd, NULL);
+	close(fd);
+
+	cache->map = map;
+	cache->map_len = st.st_size;
+	cache->count = hdr->count;
+	cache->ents = (const sym_cache_ent_t *)(hdr + 1);
+	cache->strs = (const char *)(cache->ents + hdr->count);
+	pr_debug("using symbol cache %s (%u symbols)", path, cache->count);
+	return 0;
+
+stale:
+	munmap(map, st.st_size);
+	close(fd);
+	unlink(path);
+	return -1;
+}
+
+void sym_cache_close(sym_cache_t *cache)
+{
+	if (cache->map != NULL) {
+		munmap(cache->map, cache->map_len);
+		cache->map = NULL;
+	}
+
+	cache->map_len = 0;
+	cache->count = 0;
+	cache->ents = NULL;
+	cache->strs = NULL;
+}
+
+static int sym_cache_ent_cmp(const void *a, const void *b)
+{
+	const sym_cache_ent_t *x = a;
+	const sym_cache_ent_t *y = b;
+
+	if (x->addr != y->addr)
+		return (x->addr < y->addr) ? -1 : 1;
+
+	return 0;
+}
+
+typedef struct SYM_CACHE_FILE {
+	char *path;
+	off_t size;
+	time_t mtime;
+} sym_cache_file_t;
+
+static int sym_cache_file_cmp(const void *a, const void *b)
+{
+	const sym_cache_file_t *x = a;
+	const sym_cache_file_t *y = b;
+
+	if (x->mtime != y->mtime)
+		return (x->mtime < y->mtime) ? -1 : 1;
+
+	return 0;
+}
+
+// Removes the least recently used entries until the cache directory fits in
+// SYM_CACHE_MAX_SIZE.
+static void sym_cache_evict(const char *dir)
+{
+	DIR *d = opendir(dir);
+	if (d == NULL)
+		return;
+
+	sym_cache_file_t *files = NULL;
+	size_t count = 0;
+	size_t cap = 0;
+	unsigned long total = 0;
+
+	struct dirent *ent;
+	while ((ent = readdir(d)) != NULL) {
+		size_t len = strlen(ent->d_name);
+		if (len < 4 || strcmp(ent->d_name + len - 4, ".idx") != 0)
+			continue;
+
+		char *path = NULL;
+		if (asprintf(&path, "%s/%s", dir, ent->d_name) == -1)
+			break;
+
+		struct stat st;
+		if (stat(path, &st) == -1) {
+			free(path);
+			continue;
+		}
+
+		if (count == cap) {
+			cap = cap ? cap * 2 : 16;
+			sym_cache_file_t *t = realloc(files, cap * sizeof(*t));
+			if (t == NULL) {
+				free(path);
+				break;
+			}
+			files = t;
+		}
+
+		files[count].path = path;
+		files[count].size = st.st_size;
+		files[count].mtime = st.st_mtime;
+		total += st.st_size;
+		count++;
+	}
+	closedir(d);
+
+	if (total > SYM_CACHE_MAX_SIZE) {
+		qsort(files, count, sizeof(*files), sym_cache_file_cmp);
+		for (size_t i = 0; i < count && total > SYM_CACHE_MAX_SIZE;
+		    i++) {
+			pr_debug("evicting symbol cache %s", files[i].path);
+			if (unlink(files[i].path) == 0)
+				total -= files[i].size;
+		}
+	}
+
+	for (size_t i = 0; i < count; i++)
+		free(files[i].path);
+	free(files);
+}
+
+static int sym_cache_mkdir(const char *dir)
+{
+	char buf[SHERLOCK_MAX_STRLEN];
+	snprintf(buf, sizeof(buf), "%s", dir);
+
+	// create the parents too (~/.cache may not exist)
+	for (char *p = buf + 1; *p != '\0'; p++) {
+		if (*p != '/')
+			continue;
+
+		*p = '\0';
+		if (mkdir(buf, 0700) == -1 && errno != EEXIST)
+			return -1;
+		*p = '/';
+	}
+
+	if (mkdir(buf, 0700) == -1 && errno != EEXIST)
+		return -1;
+
+	return 0;
+}
+
+int sym_cache_store(Elf *elf, const char *exe_path, symbol_t *symtab,
+    unsigned long long va_base)
+{
+	char path[SHERLOCK_MAX_STRLEN * 2];
+	char dir[SHERLOCK_MAX_STRLEN];
+	sym_cache_hdr_t hdr = { 0 };
+	size_t build_id_len = 0;
+	if (sym_cache_path(elf, path, sizeof(path), hdr.build_id,
+		&build_id_len) == -1 ||
+	    sym_cache_dir(dir, sizeof(dir)) == -1) {
+		return -1;
+	}
+
+	struct stat exe_st;
+	if (stat(exe_path, &exe_st) == -1)
+		return -1;
+
+	unsigned int count = 0;
+	size_t str_size = 0;
+	symbol_t *sym, *tmp;
+	HASH_ITER(hh, symtab, sym, tmp)
+	{
+		if (sym->dyn_sym)
+			continue;
+
+		count++;
+		str_size += strlen(sym->name) + 1;
+		if (sym->file_name != NULL &&
+		    (sym->map == NULL || sym->file_name != sym->map->path))
+			str_size += strlen(sym->file_name) + 1;
+	}
+
+	if (count == 0 || str_size > UINT32_MAX)
+		return -1;
+
+	sym_cache_ent_t *ents = calloc(count, sizeof(*ents));
+	char *strs = malloc(str_size);
+	if (ents == NULL || strs == NULL) {
+		pr_err("error in allocating symbol cache: %s", strerror(errno));
+		goto err;
+	}
+
+	unsigned int n = 0;
+	uint32_t off = 0;
+	const char *last_file = NULL;
+	uint32_t last_file_off = SYM_CACHE_NO_FILE;
+	HASH_ITER(hh, symtab, sym, tmp)
+	{
+		if (sym->dyn_sym)
+			continue;
+
+		sym_cache_ent_t *e = &ents[n++];
+		e->addr = sym->addr - va_base;
+		e->size = sym->size;
+		e->hashv = sym->hh.hashv;
+		e->name_len = sym->hh.keylen;
+		e->name = off;
+		memcpy(strs + off, sym->name, e->name_len + 1);
+		off += e->name_len + 1;
+
+		// only local symbols carry their own STT_FILE name, the rest
+		// use the path of the map they are in
+		e->file = SYM_CACHE_NO_FILE;
+		if (sym->file_name == NULL ||
+		    (sym->map != NULL && sym->file_name == sym->map->path)) {
+			continue;
+		}
+
+		// symbols of a file are usually next to each other
+		if (sym->file_name != last_file) {
+			size_t len = strlen(sym->file_name) + 1;
+			memcpy(strs + off, sym->file_name, len);
+			last_file = sym->file_name;
+			last_file_off = off;
+			off += len;
+		}
+		e->file = last_file_off;
+	}
+
+	qsort(ents, count, sizeof(*ents), sym_cache_ent_cmp);
+
+	memcpy(hdr.magic, SYM_CACHE_MAGIC, sizeof(hdr.magic));
+	hdr.version = SYM_CACHE_VERSION;
+	hdr.hash_id = sym_cache_hash_id();
+	hdr.build_id_len = build_id_len;
+	hdr.exe_size = exe_st.st_size;
+	hdr.exe_mtime = exe_st.st_mtime;
+	hdr.count = count;
+	hdr.str_size = off;
+
+	if (sym_cache_mkdir(dir) == -1) {
+		pr_debug("error in creating %s: %s", dir, strerror(errno));
+		goto err;
+	}
+
+	// write to a temporary file and rename, so a concurrent sherlock never
+	// maps a half written index
+	char tmp_path[SHERLOCK_MAX_STRLEN * 2 + 16];
+	snprintf(tmp_path, sizeof(tmp_path), "%s.%d", path, getpid());
+	FILE *f = fopen(tmp_path, "w");
+	if (f == NULL) {
+		pr_debug("error in creating %s: %s", tmp_path, strerror(errno));
+		goto err;
+	}
+
+	if (fwrite(&hdr, sizeof(hdr), 1, f) != 1 ||
+	    fwrite(ents, sizeof(*ents), count, f) != count ||
+	    fwrite(strs, 1, off, f) != off) {
+		pr_debug("error in writing %s", tmp_path);
+		fclose(f);
+		unlink(tmp_path);
+		goto err;
+	}
+
+	if (fclose(f) != 0 || rename(tmp_path, path) == -1) {
+		pr_debug("error in saving %s: %s", path, strerror(errno));
+		unlink(tmp_path);
+		goto err;
+	}
+
+	pr_debug("saved symbol cache %s (%u symbols)", path, count);
+	free(ents);
+	free(strs);
+	sym_cache_evict(dir);
+	return 0;
+
+err:
+	free(ents);
+	free(strs);
+	return -1;
+}
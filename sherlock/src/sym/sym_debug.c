@@ -0,0 +1,288 @@
+/*
+ * Sherlock - A Minimal Debugger
+ * Part of the Sherlock project
+ *
+ * Copyright (c) 2025-26 Mohammad Shehar Yaar Tausif <sheharyaar48@gmail.com>
+ *
+ * This file is licensed under the MIT License.
+ */
+
+#include "sym_internal.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
+
+/*
+ * Separate debug files. Stripped binaries can ship their .symtab in a
+ * separate file, found the same way GDB finds it:
+ *
+ *   <debug-dir>/.build-id/xx/yyyy.debug     from .note.gnu.build-id
+ *   <dir>/<debuglink>                       from .gnu_debuglink
+ *   <dir>/.debug/<debuglink>
+ *   <debug-dir>/<dir>/<debuglink>
+ *
+ * <debug-dir> is /usr/lib/debug unless SHERLOCK_DEBUG_DIR is set. A candidate
+ * is only used if its build-id matches (or, without a build-id, the CRC in the
+ * debuglink). The path found is cached by build-id (the debuglink path
+ * otherwise) so an object mapped twice or a failed search is not repeated.
+ *
+ * libelf loads sections lazily, an Elf handle cannot be used by two threads at
+ * once. Every caller gets its own handle on the debug file, mapped like the
+ * binaries themselves, and ends it once its symbols are gone. The library
+ * loader threads search too, hence the lock.
+ */
+
+#define SYM_DEBUG_DIR "/usr/lib/debug"
+
+typedef struct SYM_DEBUG {
+	char *key;
+	char *path; // NULL if no debug file was found
+	UT_hash_handle hh;
+} sym_debug_t;
+
+static sym_debug_t *sym_debug_cache = NULL;
+static pthread_mutex_t sym_debug_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t sym_crc_table[256];
+static bool sym_crc_ready = false;
+
+// CRC-32 as used by .gnu_debuglink (the zlib one)
+static uint32_t sym_debug_crc(const unsigned char *buf, size_t len)
+{
+	if (!sym_crc_ready) {
+		for (uint32_t i = 0; i < 256; i++) {
+			uint32_t c = i;
+			for (int k = 0; k < 8; k++)
+				c = (c & 1) ? 0xEDB88320U ^ (c >> 1) : c >> 1;
+			sym_crc_table[i] = c;
+		}
+		sym_crc_ready = true;
+	}
+
+	uint32_t crc = 0xFFFFFFFFU;
+	for (size_t i = 0; i < len; i++)
+		crc = sym_crc_table[(crc ^ buf[i]) & 0xFF] ^ (crc >> 8);
+
+	return crc ^ 0xFFFFFFFFU;
+}
+
+// Reads the .gnu_debuglink section: the file name followed by the CRC of the
+// debug file at the next 4 byte boundary.
+static const char *sym_debug_link(Elf *elf, uint32_t *crc)
+{
+	size_t shstr_indx;
+	if (elf_getshdrstrndx(elf, &shstr_indx) == -1)
+		return NULL;
+
+	Elf_Scn *scn = NULL;
+	while ((scn = elf_nextscn(elf, scn)) != NULL) {
+		Elf64_Shdr *hdr = elf64_getshdr(scn);
+		if (hdr == NULL)
+			continue;
+
+		const char *name = elf_strptr(elf, shstr_indx, hdr->sh_name);
+		if (name == NULL || strcmp(name, ".gnu_debuglink") != 0)
+			continue;
+
+		Elf_Data *data = elf_getdata(scn, NULL);
+		if (data == NULL || data->d_buf == NULL)
+			return NULL;
+
+		const char *link = data->d_buf;
+		size_t len = strnlen(link, data->d_size);
+		size_t crc_off = (len + 4) & ~3UL;
+		if (len == 0 || crc_off + 4 > data->d_size)
+			return NULL;
+
+		memcpy(crc, link + crc_off, sizeof(*crc));
+		return link;
+	}
+
+	return NULL;
+}
+
+static Elf *sym_debug_elf(const char *path)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return NULL;
+
+	Elf *elf = elf_begin(fd, ELF_C_READ_MMAP, NULL);
+	if (elf == NULL || elf_cntl(elf, ELF_C_FDDONE) == -1) {
+		pr_debug("error in elf_begin for %s: %s", path,
+		    elf_errmsg(elf_errno()));
+		if (elf != NULL)
+			elf_end(elf);
+		close(fd);
+		return NULL;
+	}
+
+	close(fd);
+	return elf;
+}
+
+// Opens 'path' as a debug file for an object with the given build-id (or the
+// debuglink CRC when there is none). Returns NULL if it does not exist or does
+// not belong to the object.
+static Elf *sym_debug_try(const char *path, const unsigned char *build_id,
+    size_t build_id_len, const uint32_t *crc)
+{
+	Elf *elf = sym_debug_elf(path);
+	if (elf == NULL)
+		return NULL;
+
+	if (build_id_len > 0) {
+		unsigned char id[SYM_BUILD_ID_MAX];
+		if (sym_elf_build_id(elf, id, sizeof(id)) != build_id_len ||
+		    memcmp(id, build_id, build_id_len) != 0) {
+			pr_debug("build-id of %s does not match", path);
+			goto out;
+		}
+	} else if (crc != NULL) {
+		size_t size = 0;
+		char *raw = elf_rawfile(elf, &size);
+		if (raw == NULL ||
+		    sym_debug_crc((unsigned char *)raw, size) != *crc) {
+			pr_debug("crc of %s does not match", path);
+			goto out;
+		}
+	}
+
+	pr_debug("using debug file %s", path);
+	return elf;
+
+out:
+	elf_end(elf);
+	return NULL;
+}
+
+// Searches the debug file of the object, 'found' gets its path.
+static Elf *sym_debug_find(const char *path, const unsigned char *id,
+    size_t id_len, const char *link, uint32_t crc, char **found)
+{
+	const char *debug_dir = getenv("SHERLOCK_DEBUG_DIR");
+	if (debug_dir == NULL || debug_dir[0] == '\0')
+		debug_dir = SYM_DEBUG_DIR;
+
+	char buf[SHERLOCK_MAX_STRLEN * 2];
+	Elf *dbg = NULL;
+
+	if (id_len > 1) {
+		int n = snprintf(buf, sizeof(buf), "%s/.build-id/%02x/", debug_dir,
+		    id[0]);
+		for (size_t i = 1; i < id_len && n + 3 < (int)sizeof(buf); i++)
+			n += sprintf(&buf[n], "%02x", id[i]);
+		snprintf(&buf[n], sizeof(buf) - n, ".debug");
+
+		if ((dbg = sym_debug_try(buf, id, id_len, NULL)) != NULL)
+			goto found;
+	}
+
+	if (link == NULL)
+		return NULL;
+
+	const char *slash = strrchr(path, '/');
+	int dir_len = (slash != NULL) ? slash - path : 0;
+	const char *fmts[] = { "%.*s/%s", "%.*s/.debug/%s" };
+	for (size_t i = 0; i < sizeof(fmts) / sizeof(fmts[0]); i++) {
+		snprintf(buf, sizeof(buf), fmts[i], dir_len, path, link);
+		if (strcmp(buf, path) == 0)
+			continue;
+
+		if ((dbg = sym_debug_try(buf, id, id_len, &crc)) != NULL)
+			goto found;
+	}
+
+	snprintf(buf, sizeof(buf), "%s%.*s/%s", debug_dir, dir_len, path, link);
+	if ((dbg = sym_debug_try(buf, id, id_len, &crc)) == NULL)
+		return NULL;
+
+found:
+	if ((*found = strdup(buf)) == NULL) {
+		pr_err("error in allocating debug file path: %s",
+		    strerror(errno));
+		elf_end(dbg);
+		return NULL;
+	}
+
+	return dbg;
+}
+
+// Every call gives a new handle on the debug file, the caller ends it.
+Elf *sym_debug_open(Elf *elf, const char *path)
+{
+	unsigned char id[SYM_BUILD_ID_MAX];
+	size_t id_len = sym_elf_build_id(elf, id, sizeof(id));
+	uint32_t crc = 0;
+	const char *link = sym_debug_link(elf, &crc);
+
+	if (id_len == 0 && link == NULL)
+		return NULL;
+
+	char key[SHERLOCK_MAX_STRLEN * 2];
+	if (id_len > 0) {
+		for (size_t i = 0; i < id_len; i++)
+			sprintf(&key[i * 2], "%02x", id[i]);
+	} else {
+		snprintf(key, sizeof(key), "%s:%08x", link, crc);
+	}
+
+	// the lock is held over the search so two threads never open the
+	// same debug file
+	pthread_mutex_lock(&sym_debug_lock);
+
+	sym_debug_t *dbg = NULL;
+	HASH_FIND_STR(sym_debug_cache, key, dbg);
+	if (dbg == NULL) {
+		dbg = calloc(1, sizeof(*dbg));
+		if (dbg == NULL || (dbg->key = strdup(key)) == NULL) {
+			pr_err("error in allocating debug file entry: %s",
+			    strerror(errno));
+			free(dbg);
+			pthread_mutex_unlock(&sym_debug_lock);
+			return NULL;
+		}
+
+		// the first caller gets the handle the search opened
+		Elf *res =
+		    sym_debug_find(path, id, id_len, link, crc, &dbg->path);
+		HASH_ADD_KEYPTR(hh, sym_debug_cache, dbg->key, strlen(dbg->key),
+		    dbg);
+		pthread_mutex_unlock(&sym_debug_lock);
+		return res;
+	}
+
+	// the path does not change once the entry is in the cache
+	const char *found = dbg->path;
+	pthread_mutex_unlock(&sym_debug_lock);
+	if (found == NULL)
+		return NULL;
+
+	return sym_debug_elf(found);
+}
+
+Elf_Scn *sym_elf_symtab(Elf *elf, Elf64_Shdr **hdr)
+{
+	Elf_Scn *scn = NULL;
+	while ((scn = elf_nextscn(elf, scn)) != NULL) {
+		Elf64_Shdr *h = elf64_getshdr(scn);
+		if (h != NULL && h->sh_type == SHT_SYMTAB && h->sh_size > 0) {
+			*hdr = h;
+			return scn;
+		}
+	}
+
+	return NULL;
+}
+
+void sym_debug_cleanup(void)
+{
+	sym_debug_t *dbg, *tmp;
+	HASH_ITER(hh, sym_debug_cache, dbg, tmp)
+	{
+		HASH_DEL(sym_debug_cache, dbg);
+		free(dbg->path);
+		free(dbg->key);
+		free(dbg);
+	}
+}
@@ -0,0 +1,396 @@
+/*
+ * Sherlock - A Minimal Debugger
+ * Part of the Sherlock project
+ *
+ * Copyright (c) 2025-26 Mohammad Shehar Yaar Tausif <sheharyaar48@gmail.com>
+ *
+ * This file is licensed under the MIT License.
+ */
+
+#include "sym_internal.h"
+#include <dlfcn.h>
+#include <pthread.h>
+#include <unistd.h>
+
+/*
+ * C++ names. The symbol tables have the mangled names (_ZN2ns3fooEi), users
+ * type the demangled ones (ns::foo or ns::foo(int)). Demangling is done by
+ * __cxa_demangle, loaded from libstdc++ at runtime so the debugger does not
+ * link against it; without it C++ names can only be used mangled.
+ *
+ * Every name index gets a second one keyed by the demangled name without the
+ * parameter list (and without spaces, "ns::foo<int, int>" is typed without
+ * them), so all the overloads of ns::foo are one run and a query with the
+ * parameters picks the matching signatures from it. It is built the first
+ * time a name is not found as is. Demangling every _Z name of a library like
+ * libstdc++ is the expensive part, it is split over threads that each fill
+ * their own slice of the names. Lookups never demangle, they hash the query
+ * and probe.
+ *
+ * Names shown to the user (breakpoints, info) go through a small direct-mapped
+ * cache instead: a breakpoint hit in a loop does not demangle the same name
+ * every time and listing a large library does not keep every string around.
+ */
+
+#define SYM_DEMANGLE_MAX_WORKERS 8
+// below this many names per thread starting one is not worth it
+#define SYM_DEMANGLE_MIN_NAMES 512
+#define SYM_DEMANGLE_CACHE_SIZE 256
+
+typedef char *(*sym_cxa_demangle_t)(
+    const char *name, char *buf, size_t *len, int *status);
+
+typedef struct SYM_DEMANGLE_JOB {
+	sym_name_index_t *idx;
+	unsigned int start;
+	unsigned int end;
+	pthread_t thread;
+} sym_demangle_job_t;
+
+typedef struct SYM_DEMANGLE_SLOT {
+	char *name;
+	char *demangled; // NULL if it could not be demangled
+} sym_demangle_slot_t;
+
+static pthread_once_t sym_demangle_once = PTHREAD_ONCE_INIT;
+static sym_cxa_demangle_t sym_cxa_demangle = NULL;
+static sym_demangle_slot_t sym_demangle_cache[SYM_DEMANGLE_CACHE_SIZE];
+
+static void sym_demangle_load(void)
+{
+	void *lib = dlopen("libstdc++.so.6", RTLD_LAZY | RTLD_LOCAL);
+	if (lib == NULL) {
+		pr_debug("C++ names are not demangled: %s", dlerror());
+		return;
+	}
+
+	sym_cxa_demangle = (sym_cxa_demangle_t)dlsym(lib, "__cxa_demangle");
+	if (sym_cxa_demangle == NULL) {
+		pr_debug("C++ names are not demangled: %s", dlerror());
+		dlclose(lib);
+	}
+}
+
+// Returns the demangled name, to be freed, or NULL if 'name' is not a C++ name.
+static char *sym_demangle_str(const char *name)
+{
+	pthread_once(&sym_demangle_once, sym_demangle_load);
+	if (sym_cxa_demangle == NULL || strncmp(name, "_Z", 2) != 0)
+		return NULL;
+
+	int status = 0;
+	char *res = sym_cxa_demangle(name, NULL, NULL, &status);
+	if (status != 0) {
+		free(res);
+		return NULL;
+	}
+
+	return res;
+}
+
+// Returns where the name proper starts in a demangled name, its length is set
+// in 'len': functions lose the parameter list and the qualifiers after it,
+// template functions also the return type in front.
+const char *sym_demangle_base(const char *name, size_t *len)
+{
+	size_t n = strlen(name);
+
+	// the parameters are the last (...), unless a scope follows it like in
+	// foo()::counter for the static locals of a function
+	const char *close = strrchr(name, ')');
+	if (close != NULL && strstr(close, "::") == NULL) {
+		int depth = 0;
+		for (const char *p = close; p >= name; p--) {
+			if (*p == ')') {
+				depth++;
+			} else if (*p == '(' && --depth == 0) {
+				n = p - name;
+				break;
+			}
+		}
+	}
+
+	const char *start = name;
+	if (n > 0 && name[n - 1] == '>') {
+		int depth = 0;
+		for (size_t i = 0; i < n; i++) {
+			char c = name[i];
+			if (c == '<' || c == '(') {
+				depth++;
+			} else if (c == '>' || c == ')') {
+				depth--;
+			} else if (c == ' ' && depth == 0 &&
+			    (i < 8 ||
+				strncmp(&name[i - 8], "operator", 8) != 0)) {
+				start = &name[i + 1];
+			}
+		}
+	}
+
+	*len = n - (start - name);
+	return start;
+}
+
+// Copies 'len' bytes of 'name' to 'buf' without the spaces.
+static void sym_demangle_squeeze(
+    const char *name, size_t len, char *buf, size_t size)
+{
+	size_t n = 0;
+	for (size_t i = 0; i < len && name[i] != '\0' && n + 1 < size; i++) {
+		if (name[i] != ' ')
+			buf[n++] = name[i];
+	}
+
+	buf[n] = '\0';
+}
+
+// Compares two demangled names ignoring the spaces.
+static bool sym_demangle_eq(const char *a, const char *b)
+{
+	for (;;) {
+		while (*a == ' ')
+			a++;
+		while (*b == ' ')
+			b++;
+
+		if (*a != *b)
+			return false;
+		if (*a == '\0')
+			return true;
+
+		a++;
+		b++;
+	}
+}
+
+static void *sym_demangle_worker(void *arg)
+{
+	sym_demangle_job_t *job = arg;
+	sym_name_index_t *idx = job->idx;
+
+	for (unsigned int i = job->start; i < job->end; i++) {
+		char *dm = sym_demangle_str(idx->ents[i].name);
+		if (dm == NULL)
+			continue;
+
+		size_t len;
+		const char *base = sym_demangle_base(dm, &len);
+		char *key = malloc(len + 1);
+		if (key == NULL) {
+			// the name is only found mangled
+			free(dm);
+			continue;
+		}
+
+		sym_demangle_squeeze(base, len, key, len + 1);
+		idx->demangled[i] = dm;
+		idx->dm_keys[i] = key;
+	}
+
+	return NULL;
+}
+
+// Demangles every name of the index, 'idx' has to be built already.
+int sym_demangle_index_build(sym_name_index_t *idx)
+{
+	if (idx->dm_built)
+		return 0;
+
+	pthread_once(&sym_demangle_once, sym_demangle_load);
+	if (sym_cxa_demangle == NULL || idx->mangled == 0) {
+		idx->dm_built = true;
+		return 0;
+	}
+
+	idx->demangled = calloc(idx->count, sizeof(char *));
+	idx->dm_keys = calloc(idx->count, sizeof(char *));
+	idx->dm_ents = calloc(idx->mangled, sizeof(sym_name_ent_t));
+	idx->dm_runs = calloc(idx->mangled, sizeof(unsigned int));
+	if (idx->demangled == NULL || idx->dm_keys == NULL ||
+	    idx->dm_ents == NULL || idx->dm_runs == NULL) {
+		pr_err("error in allocating demangled names: %s",
+		    strerror(errno));
+		sym_demangle_index_free(idx);
+		return -1;
+	}
+
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned int workers = (ncpu > 0) ? ncpu : 1;
+	if (workers > SYM_DEMANGLE_MAX_WORKERS)
+		workers = SYM_DEMANGLE_MAX_WORKERS;
+	if (workers > idx->mangled / SYM_DEMANGLE_MIN_NAMES)
+		workers = idx->mangled / SYM_DEMANGLE_MIN_NAMES;
+	if (workers == 0)
+		workers = 1;
+
+	// the first slice is done by this thread, also the slices of the
+	// threads that could not be started
+	sym_demangle_job_t jobs[SYM_DEMANGLE_MAX_WORKERS];
+	bool started[SYM_DEMANGLE_MAX_WORKERS] = { false };
+	unsigned int slice = (idx->count + workers - 1) / workers;
+	for (unsigned int i = 0; i < workers; i++) {
+		jobs[i].idx = idx;
+		jobs[i].start = i * slice;
+		jobs[i].end = (i + 1) * slice;
+		if (jobs[i].start > idx->count)
+			jobs[i].start = idx->count;
+		if (jobs[i].end > idx->count)
+			jobs[i].end = idx->count;
+
+		if (i > 0 && pthread_create(&jobs[i].thread, NULL,
+				 sym_demangle_worker, &jobs[i]) == 0) {
+			started[i] = true;
+		}
+	}
+
+	for (unsigned int i = 0; i < workers; i++) {
+		if (!started[i])
+			sym_demangle_worker(&jobs[i]);
+	}
+
+	for (unsigned int i = 1; i < workers; i++) {
+		if (started[i])
+			pthread_join(jobs[i].thread, NULL);
+	}
+
+	// group the overloads, the same two passes as the name index
+	unsigned int n = 0;
+	for (unsigned int i = 0; i < idx->count; i++) {
+		const char *key = idx->dm_keys[i];
+		if (key == NULL)
+			continue;
+
+		sym_name_ent_t *ent = NULL;
+		HASH_FIND_STR(idx->dm_hash, key, ent);
+		if (ent == NULL) {
+			ent = &idx->dm_ents[n++];
+			ent->name = key;
+			HASH_ADD_KEYPTR(hh, idx->dm_hash, ent->name,
+			    strlen(ent->name), ent);
+		}
+		ent->count++;
+	}
+
+	unsigned int first = 0;
+	for (unsigned int i = 0; i < n; i++) {
+		idx->dm_ents[i].first = first;
+		first += idx->dm_ents[i].count;
+		idx->dm_ents[i].count = 0;
+	}
+
+	for (unsigned int i = 0; i < idx->count; i++) {
+		if (idx->dm_keys[i] == NULL)
+			continue;
+
+		sym_name_ent_t *ent = NULL;
+		HASH_FIND_STR(idx->dm_hash, idx->dm_keys[i], ent);
+		idx->dm_runs[ent->first + ent->count++] = i;
+	}
+
+	idx->dm_built = true;
+	pr_debug("demangled %u names into %u with %u threads", first, n,
+	    workers);
+	return 0;
+}
+
+int sym_demangle_index_foreach(sym_name_index_t *idx, symbol_t *symtab,
+    sym_name_spec_t *q, tracee_t *tracee, sym_name_cb cb, void *arg)
+{
+	if (!idx->built && sym_name_index_build(idx, symtab) == -1)
+		return -1;
+
+	if (idx->mangled == 0)
+		return 0;
+
+	if (sym_demangle_index_build(idx) == -1)
+		return -1;
+
+	size_t len;
+	const char *base = sym_demangle_base(q->name, &len);
+	char key[SHERLOCK_MAX_STRLEN];
+	sym_demangle_squeeze(base, len, key, sizeof(key));
+
+	sym_name_ent_t *ent = NULL;
+	HASH_FIND_STR(idx->dm_hash, key, ent);
+	if (ent == NULL)
+		return 0;
+
+	// with parameters only that overload, the return type of template
+	// functions is not typed
+	bool signature = base[len] == '(';
+	int found = 0;
+	bool stop = false;
+	for (unsigned int i = 0; i < ent->count && !stop; i++) {
+		unsigned int e = idx->dm_runs[ent->first + i];
+		size_t dm_len;
+		if (signature &&
+		    !sym_demangle_eq(
+			sym_demangle_base(idx->demangled[e], &dm_len), base)) {
+			continue;
+		}
+
+		int n = sym_name_ent_foreach(
+		    idx, &idx->ents[e], q, tracee, cb, arg, &stop);
+		if (n == -1)
+			return -1;
+		found += n;
+	}
+
+	return found;
+}
+
+void sym_demangle_index_free(sym_name_index_t *idx)
+{
+	HASH_CLEAR(hh, idx->dm_hash);
+	for (unsigned int i = 0; idx->demangled != NULL && i < idx->count;
+	    i++) {
+		free(idx->demangled[i]);
+		free(idx->dm_keys[i]);
+	}
+
+	free(idx->demangled);
+	free(idx->dm_keys);
+	free(idx->dm_ents);
+	free(idx->dm_runs);
+	idx->demangled = NULL;
+	idx->dm_keys = NULL;
+	idx->dm_ents = NULL;
+	idx->dm_runs = NULL;
+	idx->dm_built = false;
+}
+
+const char *sym_demangle(const char *name)
+{
+	if (name == NULL || strncmp(name, "_Z", 2) != 0)
+		return name;
+
+	// FNV-1a
+	uint32_t h = 2166136261U;
+	for (const char *p = name; *p != '\0'; p++)
+		h = (h ^ (unsigned char)*p) * 16777619U;
+
+	sym_demangle_slot_t *slot =
+	    &sym_demangle_cache[h % SYM_DEMANGLE_CACHE_SIZE];
+	if (slot->name == NULL || strcmp(slot->name, name) != 0) {
+		char *copy = strdup(name);
+		if (copy == NULL)
+			return name;
+
+		free(slot->name);
+		free(slot->demangled);
+		slot->name = copy;
+		slot->demangled = sym_demangle_str(name);
+	}
+
+	return (slot->demangled != NULL) ? slot->demangled : name;
+}
+
+void sym_demangle_cleanup(void)
+{
+	for (unsigned int i = 0; i < SYM_DEMANGLE_CACHE_SIZE; i++) {
+		free(sym_demangle_cache[i].name);
+		free(sym_demangle_cache[i].demangled);
+		sym_demangle_cache[i].name = NULL;
+		sym_demangle_cache[i].demangled = NULL;
+	}
+}
@@ -0,0 +1,819 @@
+/*
+ * Sherlock - A Minimal Debugger
+ * Part of the Sherlock project
+ *
+ * Copyright (c) 2025-26 Mohammad Shehar Yaar Tausif <sheharyaar48@gmail.com>
+ *
+ * This file is licensed under the MIT License.
+ */
+
+#include "sym_internal.h"
+
+/*
+ * Minimal DWARF reader, just what the source line and variable lookups need:
+ * the primitive encodings, the forms (to read or skip an attribute), the
+ * abbreviation tables, and the unit header and attributes of a compilation
+ * unit. Versions 2 to 5 are handled, split DWARF (.dwo) and supplementary
+ * files are not.
+ *
+ * The sections are used in place from the mapped file, nothing is copied
+ * unless the section is compressed. The executable's DWARF (or the one of its
+ * separate debug file) is only located on the first query.
+ */
+
+static Elf *sym_dwarf_exe_elf = NULL;
+static const char *sym_dwarf_exe_path = NULL;
+// separate debug file the DWARF comes from
+static Elf *sym_dwarf_exe_dbg = NULL;
+// 0 not loaded yet, 1 loaded, -1 no DWARF
+static int sym_dwarf_exe_state = 0;
+static sym_dwarf_t sym_dwarf_exe_dw = { 0 };
+
+uint64_t sym_dwarf_u(sym_dwarf_buf_t *b, size_t n)
+{
+	if ((size_t)(b->end - b->p) < n) {
+		b->err = true;
+		b->p = b->end;
+		return 0;
+	}
+
+	// x86_64 is little endian like the DWARF we read
+	uint64_t v = 0;
+	memcpy(&v, b->p, n > sizeof(v) ? sizeof(v) : n);
+	b->p += n;
+	return v;
+}
+
+uint64_t sym_dwarf_uleb(sym_dwarf_buf_t *b)
+{
+	uint64_t v = 0;
+	unsigned int shift = 0;
+	while (b->p < b->end) {
+		unsigned char byte = *b->p++;
+		if (shift < 64)
+			v |= (uint64_t)(byte & 0x7f) << shift;
+		shift += 7;
+		if ((byte & 0x80) == 0)
+			return v;
+	}
+
+	b->err = true;
+	return 0;
+}
+
+int64_t sym_dwarf_sleb(sym_dwarf_buf_t *b)
+{
+	int64_t v = 0;
+	unsigned int shift = 0;
+	while (b->p < b->end) {
+		unsigned char byte = *b->p++;
+		if (shift < 64)
+			v |= (int64_t)(byte & 0x7f) << shift;
+		shift += 7;
+		if ((byte & 0x80) == 0) {
+			if (shift < 64 && (byte & 0x40))
+				v |= -((int64_t)1 << shift);
+			return v;
+		}
+	}
+
+	b->err = true;
+	return 0;
+}
+
+const char *sym_dwarf_str(sym_dwarf_buf_t *b)
+{
+	const unsigned char *nul = memchr(b->p, '\0', b->end - b->p);
+	if (nul == NULL) {
+		b->err = true;
+		b->p = b->end;
+		return NULL;
+	}
+
+	const char *s = (const char *)b->p;
+	b->p = nul + 1;
+	return s;
+}
+
+// Reads the initial length of a unit, 'is64' tells if the offsets in it are 8
+// bytes (64-bit DWARF).
+uint64_t sym_dwarf_unit_length(sym_dwarf_buf_t *b, bool *is64)
+{
+	uint64_t len = sym_dwarf_u(b, 4);
+	*is64 = false;
+	if (len == 0xffffffffULL) {
+		len = sym_dwarf_u(b, 8);
+		*is64 = true;
+	} else if (len >= 0xfffffff0ULL) {
+		// reserved values
+		b->err = true;
+	}
+
+	return len;
+}
+
+static const char *sym_dwarf_strp(const sym_dwarf_sec_t *sec, uint64_t off)
+{
+	if (sec->buf == NULL || off >= sec->size)
+		return NULL;
+
+	const char *s = (const char *)sec->buf + off;
+	if (memchr(s, '\0', sec->size - off) == NULL)
+		return NULL;
+
+	return s;
+}
+
+static int sym_dwarf_section(Elf_Scn *scn, sym_dwarf_sec_t *sec)
+{
+	Elf64_Shdr *hdr = elf64_getshdr(scn);
+	if (hdr == NULL || hdr->sh_type == SHT_NOBITS)
+		return -1;
+
+	// decompressed into the heap by libelf, freed by elf_end
+	if ((hdr->sh_flags & SHF_COMPRESSED) && elf_compress(scn, 0, 0) == -1) {
+		pr_debug("error in decompressing section: %s",
+		    elf_errmsg(elf_errno()));
+		return -1;
+	}
+
+	Elf_Data *data = elf_getdata(scn, NULL);
+	if (data == NULL || data->d_buf == NULL)
+		return -1;
+
+	sec->buf = data->d_buf;
+	sec->size = data->d_size;
+	return 0;
+}
+
+static int sym_dwarf_load(sym_dwarf_t *dw, Elf *elf)
+{
+	size_t shstr_indx;
+	if (elf_getshdrstrndx(elf, &shstr_indx) == -1)
+		return -1;
+
+	memset(dw, 0, sizeof(*dw));
+	dw->elf = elf;
+
+	static const struct {
+		const char *name;
+		size_t off;
+	} secs[] = {
+		{ ".debug_info", offsetof(sym_dwarf_t, info) },
+		{ ".debug_abbrev", offsetof(sym_dwarf_t, abbrev) },
+		{ ".debug_line", offsetof(sym_dwarf_t, line) },
+		{ ".debug_line_str", offsetof(sym_dwarf_t, line_str) },
+		{ ".debug_str", offsetof(sym_dwarf_t, str) },
+		{ ".debug_str_offsets", offsetof(sym_dwarf_t, str_offsets) },
+		{ ".debug_addr", offsetof(sym_dwarf_t, addr) },
+		{ ".debug_aranges", offsetof(sym_dwarf_t, aranges) },
+		{ ".debug_frame", offsetof(sym_dwarf_t, frame) },
+	};
+
+	Elf_Scn *scn = NULL;
+	while ((scn = elf_nextscn(elf, scn)) != NULL) {
+		Elf64_Shdr *hdr = elf64_getshdr(scn);
+		if (hdr == NULL)
+			continue;
+
+		const char *name = elf_strptr(elf, shstr_indx, hdr->sh_name);
+		if (name == NULL || strncmp(name, ".debug_", 7) != 0)
+			continue;
+
+		for (size_t i = 0; i < sizeof(secs) / sizeof(secs[0]); i++) {
+			if (strcmp(name, secs[i].name) != 0)
+				continue;
+
+			sym_dwarf_sec_t *sec =
+			    (sym_dwarf_sec_t *)((char *)dw + secs[i].off);
+			if (sym_dwarf_section(scn, sec) == -1)
+				pr_debug("section %s unusable", name);
+			break;
+		}
+	}
+
+	return (dw->info.buf != NULL || dw->line.buf != NULL) ? 0 : -1;
+}
+
+// Resolves an index into the DWARF 5 string offsets table of the unit.
+static const char *sym_dwarf_strx(
+    sym_dwarf_t *dw, const sym_dwarf_cu_t *cu, uint64_t idx)
+{
+	size_t offsz = cu->is64 ? 8 : 4;
+	uint64_t pos = cu->str_offsets_base + idx * offsz;
+	if (dw->str_offsets.buf == NULL || cu->str_offsets_base == 0 ||
+	    pos + offsz > dw->str_offsets.size) {
+		return NULL;
+	}
+
+	uint64_t off = 0;
+	memcpy(&off, dw->str_offsets.buf + pos, offsz);
+	return sym_dwarf_strp(&dw->str, off);
+}
+
+// Resolves an index into the DWARF 5 address table of the unit.
+static uint64_t sym_dwarf_addrx(
+    sym_dwarf_t *dw, const sym_dwarf_cu_t *cu, uint64_t idx)
+{
+	uint64_t pos = cu->addr_base + idx * cu->addr_size;
+	if (dw->addr.buf == NULL || cu->addr_base == 0 ||
+	    pos + cu->addr_size > dw->addr.size) {
+		return 0;
+	}
+
+	uint64_t addr = 0;
+	memcpy(&addr, dw->addr.buf + pos, cu->addr_size);
+	return addr;
+}
+
+// Decodes (or, with a NULL 'val', skips) an attribute value of the given form.
+int sym_dwarf_form(sym_dwarf_t *dw, sym_dwarf_buf_t *b, unsigned int form,
+    const sym_dwarf_cu_t *cu, sym_dwarf_val_t *val)
+{
+	sym_dwarf_val_t tmp;
+	if (val == NULL)
+		val = &tmp;
+
+	size_t offsz = cu->is64 ? 8 : 4;
+	val->u = 0;
+	val->str = NULL;
+
+	switch (form) {
+	case SYM_DW_FORM_addr:
+		val->u = sym_dwarf_u(b, cu->addr_size);
+		break;
+	case SYM_DW_FORM_data1:
+	case SYM_DW_FORM_ref1:
+	case SYM_DW_FORM_flag:
+		val->u = sym_dwarf_u(b, 1);
+		break;
+	case SYM_DW_FORM_data2:
+	case SYM_DW_FORM_ref2:
+		val->u = sym_dwarf_u(b, 2);
+		break;
+	case SYM_DW_FORM_data4:
+	case SYM_DW_FORM_ref4:
+	case SYM_DW_FORM_ref_sup4:
+		val->u = sym_dwarf_u(b, 4);
+		break;
+	case SYM_DW_FORM_strx1:
+	case SYM_DW_FORM_strx2:
+	case SYM_DW_FORM_strx3:
+	case SYM_DW_FORM_strx4:
+		val->u = sym_dwarf_u(b, form - SYM_DW_FORM_strx1 + 1);
+		val->str = sym_dwarf_strx(dw, cu, val->u);
+		break;
+	case SYM_DW_FORM_addrx1:
+	case SYM_DW_FORM_addrx2:
+	case SYM_DW_FORM_addrx3:
+	case SYM_DW_FORM_addrx4:
+		val->u = sym_dwarf_addrx(
+		    dw, cu, sym_dwarf_u(b, form - SYM_DW_FORM_addrx1 + 1));
+		break;
+	case SYM_DW_FORM_strx:
+	case SYM_DW_FORM_GNU_str_index:
+		val->u = sym_dwarf_uleb(b);
+		val->str = sym_dwarf_strx(dw, cu, val->u);
+		break;
+	case SYM_DW_FORM_addrx:
+	case SYM_DW_FORM_GNU_addr_index:
+		val->u = sym_dwarf_addrx(dw, cu, sym_dwarf_uleb(b));
+		break;
+	case SYM_DW_FORM_data8:
+	case SYM_DW_FORM_ref8:
+	case SYM_DW_FORM_ref_sig8:
+	case SYM_DW_FORM_ref_sup8:
+		val->u = sym_dwarf_u(b, 8);
+		break;
+	case SYM_DW_FORM_data16:
+		sym_dwarf_u(b, 16);
+		break;
+	case SYM_DW_FORM_sdata:
+		val->u = (uint64_t)sym_dwarf_sleb(b);
+		break;
+	case SYM_DW_FORM_udata:
+	case SYM_DW_FORM_ref_udata:
+	case SYM_DW_FORM_loclistx:
+	case SYM_DW_FORM_rnglistx:
+		val->u = sym_dwarf_uleb(b);
+		break;
+	case SYM_DW_FORM_ref_addr:
+		val->u = sym_dwarf_u(b, cu->version <= 2 ? cu->addr_size : offsz);
+		break;
+	case SYM_DW_FORM_sec_offset:
+	case SYM_DW_FORM_strp_sup:
+	case SYM_DW_FORM_GNU_ref_alt:
+	case SYM_DW_FORM_GNU_strp_alt:
+		val->u = sym_dwarf_u(b, offsz);
+		break;
+	case SYM_DW_FORM_strp:
+		val->u = sym_dwarf_u(b, offsz);
+		val->str = sym_dwarf_strp(&dw->str, val->u);
+		break;
+	case SYM_DW_FORM_line_strp:
+		val->u = sym_dwarf_u(b, offsz);
+		val->str = sym_dwarf_strp(&dw->line_str, val->u);
+		break;
+	case SYM_DW_FORM_string:
+		val->str = sym_dwarf_str(b);
+		break;
+	case SYM_DW_FORM_block1:
+		val->u = sym_dwarf_u(b, 1);
+		sym_dwarf_u(b, val->u);
+		break;
+	case SYM_DW_FORM_block2:
+		val->u = sym_dwarf_u(b, 2);
+		sym_dwarf_u(b, val->u);
+		break;
+	case SYM_DW_FORM_block4:
+		val->u = sym_dwarf_u(b, 4);
+		sym_dwarf_u(b, val->u);
+		break;
+	case SYM_DW_FORM_block:
+	case SYM_DW_FORM_exprloc:
+		val->u = sym_dwarf_uleb(b);
+		sym_dwarf_u(b, val->u);
+		break;
+	case SYM_DW_FORM_flag_present:
+		val->u = 1;
+		break;
+	case SYM_DW_FORM_implicit_const:
+		// the value lives in the abbreviation, the caller has it
+		break;
+	case SYM_DW_FORM_indirect:
+		return sym_dwarf_form(
+		    dw, b, (unsigned int)sym_dwarf_uleb(b), cu, val);
+	default:
+		pr_debug("unknown DWARF form %#x", form);
+		return -1;
+	}
+
+	return b->err ? -1 : 0;
+}
+
+int sym_dwarf_cu_header(sym_dwarf_t *dw, uint64_t off, sym_dwarf_cu_t *cu)
+{
+	if (off >= dw->info.size)
+		return -1;
+
+	sym_dwarf_buf_t b = { dw->info.buf + off, dw->info.buf + dw->info.size,
+		false };
+	uint64_t len = sym_dwarf_unit_length(&b, &cu->is64);
+	if (b.err || len > (uint64_t)(b.end - b.p))
+		return -1;
+
+	cu->off = off;
+	cu->end = (b.p - dw->info.buf) + len;
+	cu->version = sym_dwarf_u(&b, 2);
+	if (cu->version < 2 || cu->version > 5)
+		return -1;
+
+	size_t offsz = cu->is64 ? 8 : 4;
+	if (cu->version >= 5) {
+		uint8_t type = sym_dwarf_u(&b, 1);
+		cu->addr_size = sym_dwarf_u(&b, 1);
+		cu->abbrev_off = sym_dwarf_u(&b, offsz);
+
+		// skeleton and split units carry a dwo id, type units a
+		// signature and the offset of the type
+		if (type == 4 || type == 5)
+			sym_dwarf_u(&b, 8);
+		else if (type == 2 || type == 6)
+			sym_dwarf_u(&b, 8 + offsz);
+	} else {
+		cu->abbrev_off = sym_dwarf_u(&b, offsz);
+		cu->addr_size = sym_dwarf_u(&b, 1);
+	}
+
+	if (b.err || cu->addr_size == 0 || cu->addr_size > 8)
+		return -1;
+
+	cu->die_off = b.p - dw->info.buf;
+	return 0;
+}
+
+static int sym_dwarf_abbrev_cmp(const void *a, const void *b)
+{
+	const sym_dwarf_abbrev_t *x = a;
+	const sym_dwarf_abbrev_t *y = b;
+
+	if (x->code != y->code)
+		return (x->code < y->code) ? -1 : 1;
+
+	return 0;
+}
+
+// Reads the abbreviation table at 'off' in .debug_abbrev. The attribute specs
+// are not decoded, sym_dwarf_attr_next walks them along with the DIE.
+int sym_dwarf_abbrevs(
+    sym_dwarf_t *dw, uint64_t off, sym_dwarf_abbrevs_t *abbrevs)
+{
+	abbrevs->ents = NULL;
+	abbrevs->count = 0;
+	if (dw->abbrev.buf == NULL || off >= dw->abbrev.size)
+		return -1;
+
+	unsigned int cap = 0;
+	bool sorted = true;
+	sym_dwarf_buf_t b = { dw->abbrev.buf + off,
+		dw->abbrev.buf + dw->abbrev.size, false };
+	while (!b.err) {
+		uint64_t code = sym_dwarf_uleb(&b);
+		if (code == 0)
+			break;
+
+		if (abbrevs->count == cap) {
+			cap = cap ? cap * 2 : 64;
+			sym_dwarf_abbrev_t *t =
+			    realloc(abbrevs->ents, cap * sizeof(*t));
+			if (t == NULL) {
+				pr_err("error in allocating abbreviations: %s",
+				    strerror(errno));
+				free(abbrevs->ents);
+				abbrevs->ents = NULL;
+				return -1;
+			}
+			abbrevs->ents = t;
+		}
+
+		sym_dwarf_abbrev_t *ab = &abbrevs->ents[abbrevs->count];
+		if (abbrevs->count > 0 && code < ab[-1].code)
+			sorted = false;
+
+		ab->code = code;
+		ab->tag = sym_dwarf_uleb(&b);
+		ab->children = sym_dwarf_u(&b, 1) != 0;
+		ab->specs = b.p;
+		abbrevs->count++;
+
+		for (;;) {
+			uint64_t at = sym_dwarf_uleb(&b);
+			uint64_t form = sym_dwarf_uleb(&b);
+			if (form == SYM_DW_FORM_implicit_const)
+				sym_dwarf_sleb(&b);
+			if ((at == 0 && form == 0) || b.err)
+				break;
+		}
+	}
+
+	if (b.err) {
+		free(abbrevs->ents);
+		abbrevs->ents = NULL;
+		abbrevs->count = 0;
+		return -1;
+	}
+
+	if (!sorted) {
+		qsort(abbrevs->ents, abbrevs->count, sizeof(sym_dwarf_abbrev_t),
+		    sym_dwarf_abbrev_cmp);
+	}
+
+	return 0;
+}
+
+sym_dwarf_abbrev_t *sym_dwarf_abbrev_find(
+    sym_dwarf_abbrevs_t *abbrevs, uint64_t code)
+{
+	// the codes are usually 1..n in order
+	if (code >= 1 && code <= abbrevs->count &&
+	    abbrevs->ents[code - 1].code == code) {
+		return &abbrevs->ents[code - 1];
+	}
+
+	unsigned int lo = 0;
+	unsigned int hi = abbrevs->count;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (abbrevs->ents[mid].code < code)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo < abbrevs->count && abbrevs->ents[lo].code == code)
+		return &abbrevs->ents[lo];
+
+	return NULL;
+}
+
+// Decodes the next attribute of a DIE, 'spec' walks the abbreviation and 'die'
+// the DIE. Returns 1 for an attribute, 0 at the end and -1 on errors.
+int sym_dwarf_attr_next(sym_dwarf_t *dw, const sym_dwarf_cu_t *cu,
+    sym_dwarf_buf_t *spec, sym_dwarf_buf_t *die, sym_dwarf_attr_t *attr)
+{
+	attr->at = sym_dwarf_uleb(spec);
+	attr->form = sym_dwarf_uleb(spec);
+	attr->block = NULL;
+	if (spec->err)
+		return -1;
+	if (attr->at == 0 && attr->form == 0)
+		return 0;
+
+	if (attr->form == SYM_DW_FORM_implicit_const) {
+		attr->val.u = (uint64_t)sym_dwarf_sleb(spec);
+		attr->val.str = NULL;
+		return 1;
+	}
+
+	const unsigned char *start = die->p;
+	if (sym_dwarf_form(dw, die, attr->form, cu, &attr->val) == -1)
+		return -1;
+
+	switch (attr->form) {
+	case SYM_DW_FORM_ref1:
+	case SYM_DW_FORM_ref2:
+	case SYM_DW_FORM_ref4:
+	case SYM_DW_FORM_ref8:
+	case SYM_DW_FORM_ref_udata:
+		// unit relative
+		attr->val.u += cu->off;
+		break;
+	case SYM_DW_FORM_block1:
+	case SYM_DW_FORM_block2:
+	case SYM_DW_FORM_block4:
+	case SYM_DW_FORM_block:
+	case SYM_DW_FORM_exprloc:
+		attr->block = die->p - attr->val.u;
+		if (attr->block < start)
+			return -1;
+		break;
+	default:
+		break;
+	}
+
+	return 1;
+}
+
+// Reads the attributes of the unit DIE of 'cu', and the string and address
+// table bases that the other DIEs of the unit need.
+int sym_dwarf_cu_attrs(
+    sym_dwarf_t *dw, sym_dwarf_cu_t *cu, sym_dwarf_unit_t *unit)
+{
+	memset(unit, 0, sizeof(*unit));
+	unit->stmt_list = ~0ULL;
+
+	sym_dwarf_abbrevs_t abbrevs;
+	if (sym_dwarf_abbrevs(dw, cu->abbrev_off, &abbrevs) == -1)
+		return -1;
+
+	int ret = -1;
+	bool high_off = false;
+	sym_dwarf_buf_t die = { dw->info.buf + cu->die_off,
+		dw->info.buf + cu->end, false };
+	sym_dwarf_abbrev_t *ab =
+	    sym_dwarf_abbrev_find(&abbrevs, sym_dwarf_uleb(&die));
+	if (die.err || ab == NULL)
+		goto out;
+
+	// the bases can come after the attributes that need them, so they are
+	// read first
+	for (int pass = 0; pass < 2; pass++) {
+		sym_dwarf_buf_t spec = { ab->specs,
+			dw->abbrev.buf + dw->abbrev.size, false };
+		sym_dwarf_buf_t b = die;
+		sym_dwarf_attr_t attr;
+		int r;
+		while ((r = sym_dwarf_attr_next(dw, cu, &spec, &b, &attr)) == 1) {
+			if (pass == 0) {
+				if (attr.at == SYM_DW_AT_str_offsets_base)
+					cu->str_offsets_base = attr.val.u;
+				else if (attr.at == SYM_DW_AT_addr_base)
+					cu->addr_base = attr.val.u;
+				continue;
+			}
+
+			switch (attr.at) {
+			case SYM_DW_AT_stmt_list:
+				unit->stmt_list = attr.val.u;
+				break;
+			case SYM_DW_AT_name:
+				unit->name = attr.val.str;
+				break;
+			case SYM_DW_AT_comp_dir:
+				unit->comp_dir = attr.val.str;
+				break;
+			case SYM_DW_AT_low_pc:
+				unit->low_pc = attr.val.u;
+				break;
+			case SYM_DW_AT_high_pc:
+				unit->high_pc = attr.val.u;
+				high_off = (attr.form != SYM_DW_FORM_addr &&
+				    attr.form != SYM_DW_FORM_addrx &&
+				    (attr.form < SYM_DW_FORM_addrx1 ||
+					attr.form > SYM_DW_FORM_addrx4));
+				break;
+			}
+		}
+
+		if (r == -1)
+			goto out;
+	}
+
+	// DWARF 4+ can give the high pc as the size
+	if (high_off)
+		unit->high_pc += unit->low_pc;
+
+	ret = 0;
+
+out:
+	free(abbrevs.ents);
+	return ret;
+}
+
+static int sym_dwarf_range_cmp(const void *a, const void *b)
+{
+	const sym_dwarf_arange_t *x = a;
+	const sym_dwarf_arange_t *y = b;
+
+	if (x->start != y->start)
+		return (x->start < y->start) ? -1 : 1;
+
+	return 0;
+}
+
+static int sym_dwarf_range_add(
+    sym_dwarf_t *dw, uint64_t start, uint64_t end, uint64_t cu_off,
+    unsigned int *cap)
+{
+	if (dw->range_count == *cap) {
+		*cap = *cap ? *cap * 2 : 64;
+		sym_dwarf_arange_t *t =
+		    realloc(dw->ranges, *cap * sizeof(*t));
+		if (t == NULL) {
+			pr_err("error in allocating address ranges: %s",
+			    strerror(errno));
+			return -1;
+		}
+		dw->ranges = t;
+	}
+
+	sym_dwarf_arange_t *r = &dw->ranges[dw->range_count++];
+	r->start = start;
+	r->end = end;
+	r->cu_off = cu_off;
+	return 0;
+}
+
+// Reads the address ranges of every unit from .debug_aranges.
+static int sym_dwarf_read_aranges(sym_dwarf_t *dw, unsigned int *cap)
+{
+	const unsigned char *base = dw->aranges.buf;
+	sym_dwarf_buf_t b = { base, base + dw->aranges.size, false };
+	while (b.p < b.end && !b.err) {
+		const unsigned char *set = b.p;
+		bool is64;
+		uint64_t len = sym_dwarf_unit_length(&b, &is64);
+		if (b.err || len > (uint64_t)(b.end - b.p))
+			break;
+
+		sym_dwarf_buf_t s = { b.p, b.p + len, false };
+		b.p += len;
+
+		sym_dwarf_u(&s, 2); // version
+		uint64_t cu_off = sym_dwarf_u(&s, is64 ? 8 : 4);
+		uint8_t addr_size = sym_dwarf_u(&s, 1);
+		uint8_t seg_size = sym_dwarf_u(&s, 1);
+		if (s.err || addr_size == 0 || addr_size > 8 || seg_size != 0)
+			continue;
+
+		// the tuples are aligned to twice the address size from the
+		// start of the set
+		size_t tuple = 2 * addr_size;
+		size_t pad = (tuple - (s.p - set) % tuple) % tuple;
+		sym_dwarf_u(&s, pad);
+
+		while (!s.err) {
+			uint64_t start = sym_dwarf_u(&s, addr_size);
+			uint64_t size = sym_dwarf_u(&s, addr_size);
+			if (s.err || (start == 0 && size == 0))
+				break;
+			if (start == 0 || size == 0)
+				continue;
+
+			if (sym_dwarf_range_add(
+				dw, start, start + size, cu_off, cap) == -1) {
+				return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+// Without .debug_aranges (clang does not emit it), the ranges come from the
+// low and high pc of every unit DIE. Units using DW_AT_ranges are not found.
+static int sym_dwarf_read_unit_ranges(sym_dwarf_t *dw, unsigned int *cap)
+{
+	uint64_t off = 0;
+	while (off < dw->info.size) {
+		sym_dwarf_cu_t cu = { 0 };
+		sym_dwarf_unit_t unit;
+		if (sym_dwarf_cu_header(dw, off, &cu) == -1)
+			break;
+
+		if (sym_dwarf_cu_attrs(dw, &cu, &unit) == 0 &&
+		    unit.low_pc != 0 && unit.high_pc > unit.low_pc &&
+		    sym_dwarf_range_add(
+			dw, unit.low_pc, unit.high_pc, off, cap) == -1) {
+			return -1;
+		}
+
+		off = cu.end;
+	}
+
+	return 0;
+}
+
+int sym_dwarf_cu_of_addr(sym_dwarf_t *dw, uint64_t addr, uint64_t *cu_off)
+{
+	if (!dw->ranges_read) {
+		dw->ranges_read = true;
+
+		unsigned int cap = 0;
+		int ret = (dw->aranges.buf != NULL)
+		    ? sym_dwarf_read_aranges(dw, &cap)
+		    : sym_dwarf_read_unit_ranges(dw, &cap);
+		if (ret == -1)
+			dw->range_count = 0;
+
+		qsort(dw->ranges, dw->range_count, sizeof(sym_dwarf_arange_t),
+		    sym_dwarf_range_cmp);
+		pr_debug("%u unit address ranges", dw->range_count);
+	}
+
+	sym_dwarf_arange_t *r = NULL;
+	SYM_RANGE_FIND(dw->ranges, dw->range_count, addr, 0, r);
+	if (r == NULL || addr == r->end)
+		return -1;
+
+	*cu_off = r->cu_off;
+	return 0;
+}
+
+// .eh_frame of the executable, a separate debug file only has it as NOBITS.
+static void sym_dwarf_load_eh_frame(sym_dwarf_t *dw, Elf *elf)
+{
+	size_t shstr_indx;
+	if (elf_getshdrstrndx(elf, &shstr_indx) == -1)
+		return;
+
+	Elf_Scn *scn = NULL;
+	while ((scn = elf_nextscn(elf, scn)) != NULL) {
+		Elf64_Shdr *hdr = elf64_getshdr(scn);
+		if (hdr == NULL)
+			continue;
+
+		const char *name = elf_strptr(elf, shstr_indx, hdr->sh_name);
+		if (name == NULL || strcmp(name, ".eh_frame") != 0)
+			continue;
+
+		if (sym_dwarf_section(scn, &dw->eh_frame) == 0)
+			dw->eh_frame_addr = hdr->sh_addr;
+		return;
+	}
+}
+
+void sym_dwarf_setup(Elf *elf, const char *path)
+{
+	sym_dwarf_exe_elf = elf;
+	sym_dwarf_exe_path = path;
+}
+
+// The DWARF of the executable, or NULL if it has none.
+sym_dwarf_t *sym_dwarf_exe(void)
+{
+	if (sym_dwarf_exe_state != 0)
+		return (sym_dwarf_exe_state == 1) ? &sym_dwarf_exe_dw : NULL;
+
+	sym_dwarf_exe_state = -1;
+	if (sym_dwarf_exe_elf == NULL)
+		return NULL;
+
+	if (sym_dwarf_load(&sym_dwarf_exe_dw, sym_dwarf_exe_elf) == -1) {
+		Elf *dbg = sym_debug_open(sym_dwarf_exe_elf, sym_dwarf_exe_path);
+		if (dbg == NULL || sym_dwarf_load(&sym_dwarf_exe_dw, dbg) == -1) {
+			pr_debug("no DWARF for %s", sym_dwarf_exe_path);
+			if (dbg != NULL)
+				elf_end(dbg);
+			return NULL;
+		}
+		sym_dwarf_exe_dbg = dbg;
+	}
+
+	sym_dwarf_load_eh_frame(&sym_dwarf_exe_dw, sym_dwarf_exe_elf);
+	sym_dwarf_exe_state = 1;
+	return &sym_dwarf_exe_dw;
+}
+
+void sym_dwarf_cleanup(void)
+{
+	free(sym_dwarf_exe_dw.ranges);
+	memset(&sym_dwarf_exe_dw, 0, sizeof(sym_dwarf_exe_dw));
+	sym_dwarf_exe_state = 0;
+	if (sym_dwarf_exe_dbg != NULL) {
+		elf_end(sym_dwarf_exe_dbg);
+		sym_dwarf_exe_dbg = NULL;
+	}
+	sym_dwarf_exe_elf = NULL;
+	sym_dwarf_exe_path = NULL;
+}
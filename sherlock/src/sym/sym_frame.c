@@ -0,0 +1,493 @@
+/*
+ * Sherlock - A Minimal Debugger
+ * Part of the Sherlock project
+ *
+ * Copyright (c) 2025-26 Mohammad Shehar Yaar Tausif <sheharyaar48@gmail.com>
+ *
+ * This file is licensed under the MIT License.
+ */
+
+#include "sym_internal.h"
+
+/*
+ * Call frame information of the executable, just enough to know the canonical
+ * frame address (CFA) at a pc, which is what DW_OP_call_frame_cfa and so the
+ * frame base of every function built with -g needs.
+ *
+ * libunwind finds the CFI through .eh_frame_hdr, which static executables
+ * usually do not have, and then silently falls back to the frame pointer
+ * chain. Here .eh_frame is read directly (.debug_frame if there is none): the
+ * FDEs are indexed by address on first use, a lookup is a binary search and
+ * a run of the CIE and FDE instructions up to the pc, ignoring every rule but
+ * the CFA one.
+ */
+
+#define SYM_DW_CFA_advance_loc 0x40
+#define SYM_DW_CFA_offset 0x80
+#define SYM_DW_CFA_restore 0xc0
+#define SYM_DW_CFA_nop 0x00
+#define SYM_DW_CFA_set_loc 0x01
+#define SYM_DW_CFA_advance_loc1 0x02
+#define SYM_DW_CFA_advance_loc2 0x03
+#define SYM_DW_CFA_advance_loc4 0x04
+#define SYM_DW_CFA_offset_extended 0x05
+#define SYM_DW_CFA_restore_extended 0x06
+#define SYM_DW_CFA_undefined 0x07
+#define SYM_DW_CFA_same_value 0x08
+#define SYM_DW_CFA_register 0x09
+#define SYM_DW_CFA_remember_state 0x0a
+#define SYM_DW_CFA_restore_state 0x0b
+#define SYM_DW_CFA_def_cfa 0x0c
+#define SYM_DW_CFA_def_cfa_register 0x0d
+#define SYM_DW_CFA_def_cfa_offset 0x0e
+#define SYM_DW_CFA_def_cfa_expression 0x0f
+#define SYM_DW_CFA_expression 0x10
+#define SYM_DW_CFA_offset_extended_sf 0x11
+#define SYM_DW_CFA_def_cfa_sf 0x12
+#define SYM_DW_CFA_def_cfa_offset_sf 0x13
+#define SYM_DW_CFA_val_offset 0x14
+#define SYM_DW_CFA_val_offset_sf 0x15
+#define SYM_DW_CFA_val_expression 0x16
+#define SYM_DW_CFA_GNU_args_size 0x2e
+#define SYM_DW_CFA_GNU_negative_offset_extended 0x2f
+
+// pointer encodings of .eh_frame
+#define SYM_DW_EH_PE_omit 0xff
+#define SYM_DW_EH_PE_pcrel 0x10
+
+#define SYM_FRAME_STATES 16
+
+typedef struct SYM_FRAME_FDE {
+	unsigned long long start;
+	unsigned long long end;
+	// the FDE in the section
+	const unsigned char *fde;
+} sym_frame_fde_t;
+
+typedef struct SYM_FRAME_CIE {
+	uint64_t code_align;
+	int64_t data_align;
+	uint8_t fde_enc;
+	uint8_t addr_size;
+	bool aug_data;
+	const unsigned char *insns;
+	const unsigned char *end;
+} sym_frame_cie_t;
+
+typedef struct SYM_FRAME_RULE {
+	uint64_t reg;
+	int64_t off;
+	bool expr;
+} sym_frame_rule_t;
+
+typedef struct SYM_FRAME_SEC {
+	const unsigned char *buf;
+	const unsigned char *end;
+	uint64_t addr;
+	bool eh;
+} sym_frame_sec_t;
+
+static sym_frame_fde_t *sym_frame_fdes = NULL;
+static unsigned int sym_frame_fde_count = 0;
+static bool sym_frame_read = false;
+static sym_frame_sec_t sym_frame_sec = { 0 };
+
+// Reads a pointer in the given .eh_frame encoding, pc relative ones are made
+// absolute.
+static uint64_t sym_frame_ptr(sym_dwarf_buf_t *b, uint8_t enc)
+{
+	const unsigned char *field = b->p;
+	uint64_t v = 0;
+
+	switch (enc & 0x0f) {
+	case 0x00:
+	case 0x04:
+	case 0x0c:
+		v = sym_dwarf_u(b, 8);
+		break;
+	case 0x01:
+		v = sym_dwarf_uleb(b);
+		break;
+	case 0x02:
+		v = sym_dwarf_u(b, 2);
+		break;
+	case 0x03:
+		v = sym_dwarf_u(b, 4);
+		break;
+	case 0x09:
+		v = (uint64_t)sym_dwarf_sleb(b);
+		break;
+	case 0x0a:
+		v = (uint64_t)(int64_t)(int16_t)sym_dwarf_u(b, 2);
+		break;
+	case 0x0b:
+		v = (uint64_t)(int64_t)(int32_t)sym_dwarf_u(b, 4);
+		break;
+	default:
+		b->err = true;
+		return 0;
+	}
+
+	switch (enc & 0x70) {
+	case 0:
+		break;
+	case SYM_DW_EH_PE_pcrel:
+		v += sym_frame_sec.addr + (field - sym_frame_sec.buf);
+		break;
+	default:
+		// text and data relative ones are not used on x86_64
+		b->err = true;
+	}
+
+	return v;
+}
+
+static int sym_frame_cie(const unsigned char *p, sym_frame_cie_t *cie)
+{
+	sym_dwarf_buf_t b = { p, sym_frame_sec.end, false };
+	bool is64;
+	uint64_t len = sym_dwarf_unit_length(&b, &is64);
+	if (b.err || len > (uint64_t)(b.end - b.p))
+		return -1;
+
+	memset(cie, 0, sizeof(*cie));
+	cie->end = b.p + len;
+	cie->addr_size = 8;
+	b.end = cie->end;
+
+	sym_dwarf_u(&b, is64 ? 8 : 4); // CIE id
+	uint8_t version = sym_dwarf_u(&b, 1);
+	const char *aug = sym_dwarf_str(&b);
+	if (b.err)
+		return -1;
+
+	if (strstr(aug, "eh") != NULL)
+		sym_dwarf_u(&b, 8);
+
+	if (version >= 4) {
+		cie->addr_size = sym_dwarf_u(&b, 1);
+		sym_dwarf_u(&b, 1); // segment size
+	}
+
+	cie->code_align = sym_dwarf_uleb(&b);
+	cie->data_align = sym_dwarf_sleb(&b);
+	if (version == 1)
+		sym_dwarf_u(&b, 1);
+	else
+		sym_dwarf_uleb(&b); // return address register
+
+	if (aug[0] == 'z') {
+		uint64_t aug_len = sym_dwarf_uleb(&b);
+		const unsigned char *aug_end = b.p + aug_len;
+		for (const char *c = aug + 1; *c != '\0' && !b.err; c++) {
+			if (*c == 'R') {
+				cie->fde_enc = sym_dwarf_u(&b, 1);
+			} else if (*c == 'P') {
+				// only skipped, its encoding gives the size
+				uint8_t enc = sym_dwarf_u(&b, 1);
+				sym_frame_ptr(&b, enc & 0x0f);
+			} else if (*c == 'L') {
+				sym_dwarf_u(&b, 1);
+			} else if (*c != 'S' && *c != 'B') {
+				break;
+			}
+		}
+
+		if (aug_end > b.end)
+			return -1;
+		b.p = aug_end;
+		cie->aug_data = true;
+	} else if (aug[0] != '\0' && strcmp(aug, "eh") != 0) {
+		pr_debug("unknown CIE augmentation '%s'", aug);
+		return -1;
+	}
+
+	cie->insns = b.p;
+	return b.err ? -1 : 0;
+}
+
+// Parses the start of an FDE, up to its instructions.
+static int sym_frame_fde(const unsigned char *p, sym_frame_cie_t *cie,
+    uint64_t *start, uint64_t *range, sym_dwarf_buf_t *insns)
+{
+	sym_dwarf_buf_t b = { p, sym_frame_sec.end, false };
+	bool is64;
+	uint64_t len = sym_dwarf_unit_length(&b, &is64);
+	if (b.err || len > (uint64_t)(b.end - b.p))
+		return -1;
+
+	b.end = b.p + len;
+	const unsigned char *id_pos = b.p;
+	uint64_t id = sym_dwarf_u(&b, is64 ? 8 : 4);
+
+	// .eh_frame points back from the field, .debug_frame has an offset
+	const unsigned char *cie_p = sym_frame_sec.eh
+	    ? id_pos - id
+	    : sym_frame_sec.buf + id;
+	if (b.err || cie_p < sym_frame_sec.buf || cie_p >= sym_frame_sec.end ||
+	    sym_frame_cie(cie_p, cie) == -1) {
+		return -1;
+	}
+
+	if (sym_frame_sec.eh) {
+		*start = sym_frame_ptr(&b, cie->fde_enc);
+		*range = sym_frame_ptr(&b, cie->fde_enc & 0x0f);
+	} else {
+		*start = sym_dwarf_u(&b, cie->addr_size);
+		*range = sym_dwarf_u(&b, cie->addr_size);
+	}
+
+	if (cie->aug_data) {
+		uint64_t aug_len = sym_dwarf_uleb(&b);
+		sym_dwarf_u(&b, aug_len);
+	}
+
+	*insns = b;
+	return b.err ? -1 : 0;
+}
+
+static int sym_frame_fde_cmp(const void *a, const void *b)
+{
+	const sym_frame_fde_t *x = a;
+	const sym_frame_fde_t *y = b;
+
+	if (x->start != y->start)
+		return (x->start < y->start) ? -1 : 1;
+
+	return 0;
+}
+
+static void sym_frame_index(sym_dwarf_t *dw)
+{
+	sym_frame_read = true;
+	if (dw->eh_frame.buf != NULL) {
+		sym_frame_sec.buf = dw->eh_frame.buf;
+		sym_frame_sec.end = dw->eh_frame.buf + dw->eh_frame.size;
+		sym_frame_sec.addr = dw->eh_frame_addr;
+		sym_frame_sec.eh = true;
+	} else if (dw->frame.buf != NULL) {
+		sym_frame_sec.buf = dw->frame.buf;
+		sym_frame_sec.end = dw->frame.buf + dw->frame.size;
+		sym_frame_sec.eh = false;
+	} else {
+		pr_debug("no call frame information");
+		return;
+	}
+
+	unsigned int cap = 0;
+	sym_dwarf_buf_t b = { sym_frame_sec.buf, sym_frame_sec.end, false };
+	while (b.p < b.end) {
+		const unsigned char *entry = b.p;
+		bool is64;
+		uint64_t len = sym_dwarf_unit_length(&b, &is64);
+		if (b.err || len > (uint64_t)(b.end - b.p))
+			break;
+		// the terminator of .eh_frame
+		if (len == 0)
+			break;
+
+		sym_dwarf_buf_t e = { b.p, b.p + len, false };
+		b.p += len;
+
+		uint64_t id = sym_dwarf_u(&e, is64 ? 8 : 4);
+		uint64_t cie_id = is64 ? ~0ULL : 0xffffffffULL;
+		if (e.err || id == (sym_frame_sec.eh ? 0 : cie_id))
+			continue;
+
+		sym_frame_cie_t cie;
+		uint64_t start, range;
+		sym_dwarf_buf_t insns;
+		if (sym_frame_fde(entry, &cie, &start, &range, &insns) == -1 ||
+		    range == 0) {
+			continue;
+		}
+
+		if (sym_frame_fde_count == cap) {
+			cap = cap ? cap * 2 : 256;
+			sym_frame_fde_t *t =
+			    realloc(sym_frame_fdes, cap * sizeof(*t));
+			if (t == NULL) {
+				pr_err("error in allocating frame entries: %s",
+				    strerror(errno));
+				break;
+			}
+			sym_frame_fdes = t;
+		}
+
+		sym_frame_fde_t *fde = &sym_frame_fdes[sym_frame_fde_count++];
+		fde->start = start;
+		fde->end = start + range;
+		fde->fde = entry;
+	}
+
+	qsort(sym_frame_fdes, sym_frame_fde_count, sizeof(sym_frame_fde_t),
+	    sym_frame_fde_cmp);
+	pr_debug("%u frame entries", sym_frame_fde_count);
+}
+
+// Runs CFA instructions until the location passes 'pc'.
+static int sym_frame_run(sym_dwarf_buf_t *b, sym_frame_cie_t *cie,
+    uint64_t *loc, uint64_t pc, sym_frame_rule_t *rule)
+{
+	sym_frame_rule_t stack[SYM_FRAME_STATES];
+	int depth = 0;
+
+	while (b->p < b->end && !b->err) {
+		uint8_t op = sym_dwarf_u(b, 1);
+		uint64_t delta = 0;
+		bool advance = false;
+
+		switch (op & 0xc0) {
+		case SYM_DW_CFA_advance_loc:
+			delta = op & 0x3f;
+			advance = true;
+			break;
+		case SYM_DW_CFA_offset:
+			sym_dwarf_uleb(b);
+			continue;
+		case SYM_DW_CFA_restore:
+			continue;
+		}
+
+		if (!advance) {
+			switch (op) {
+			case SYM_DW_CFA_nop:
+				break;
+			case SYM_DW_CFA_set_loc: {
+				uint64_t to = sym_frame_sec.eh
+				    ? sym_frame_ptr(b, cie->fde_enc)
+				    : sym_dwarf_u(b, cie->addr_size);
+				if (to > pc)
+					return 0;
+				*loc = to;
+				break;
+			}
+			case SYM_DW_CFA_advance_loc1:
+				delta = sym_dwarf_u(b, 1);
+				advance = true;
+				break;
+			case SYM_DW_CFA_advance_loc2:
+				delta = sym_dwarf_u(b, 2);
+				advance = true;
+				break;
+			case SYM_DW_CFA_advance_loc4:
+				delta = sym_dwarf_u(b, 4);
+				advance = true;
+				break;
+			case SYM_DW_CFA_offset_extended:
+			case SYM_DW_CFA_register:
+			case SYM_DW_CFA_val_offset:
+			case SYM_DW_CFA_GNU_negative_offset_extended:
+				sym_dwarf_uleb(b);
+				sym_dwarf_uleb(b);
+				break;
+			case SYM_DW_CFA_offset_extended_sf:
+			case SYM_DW_CFA_val_offset_sf:
+				sym_dwarf_uleb(b);
+				sym_dwarf_sleb(b);
+				break;
+			case SYM_DW_CFA_restore_extended:
+			case SYM_DW_CFA_undefined:
+			case SYM_DW_CFA_same_value:
+			case SYM_DW_CFA_GNU_args_size:
+				sym_dwarf_uleb(b);
+				break;
+			case SYM_DW_CFA_remember_state:
+				if (depth == SYM_FRAME_STATES)
+					return -1;
+				stack[depth++] = *rule;
+				break;
+			case SYM_DW_CFA_restore_state:
+				if (depth == 0)
+					return -1;
+				*rule = stack[--depth];
+				break;
+			case SYM_DW_CFA_def_cfa:
+				rule->reg = sym_dwarf_uleb(b);
+				rule->off = sym_dwarf_uleb(b);
+				rule->expr = false;
+				break;
+			case SYM_DW_CFA_def_cfa_sf:
+				rule->reg = sym_dwarf_uleb(b);
+				rule->off = sym_dwarf_sleb(b) * cie->data_align;
+				rule->expr = false;
+				break;
+			case SYM_DW_CFA_def_cfa_register:
+				rule->reg = sym_dwarf_uleb(b);
+				rule->expr = false;
+				break;
+			case SYM_DW_CFA_def_cfa_offset:
+				rule->off = sym_dwarf_uleb(b);
+				break;
+			case SYM_DW_CFA_def_cfa_offset_sf:
+				rule->off = sym_dwarf_sleb(b) * cie->data_align;
+				break;
+			case SYM_DW_CFA_def_cfa_expression:
+				rule->expr = true;
+				sym_dwarf_u(b, sym_dwarf_uleb(b));
+				break;
+			case SYM_DW_CFA_expression:
+			case SYM_DW_CFA_val_expression:
+				sym_dwarf_uleb(b);
+				sym_dwarf_u(b, sym_dwarf_uleb(b));
+				break;
+			default:
+				pr_debug("unknown CFA instruction %#x", op);
+				return -1;
+			}
+		}
+
+		if (advance) {
+			uint64_t to = *loc + delta * cie->code_align;
+			if (to > pc)
+				return 0;
+			*loc = to;
+		}
+	}
+
+	return b->err ? -1 : 0;
+}
+
+// Finds how the CFA is computed at 'pc' (a link time address): the value of
+// DWARF register 'reg' plus 'off'.
+int sym_frame_cfa_rule(uint64_t pc, uint64_t *reg, int64_t *off)
+{
+	sym_dwarf_t *dw = sym_dwarf_exe();
+	if (dw == NULL)
+		return -1;
+
+	if (!sym_frame_read)
+		sym_frame_index(dw);
+
+	sym_frame_fde_t *fde = NULL;
+	SYM_RANGE_FIND(sym_frame_fdes, sym_frame_fde_count, pc, 0, fde);
+	if (fde == NULL || pc == fde->end)
+		return -1;
+
+	sym_frame_cie_t cie;
+	uint64_t start, range;
+	sym_dwarf_buf_t insns;
+	if (sym_frame_fde(fde->fde, &cie, &start, &range, &insns) == -1)
+		return -1;
+
+	sym_frame_rule_t rule = { 0 };
+	uint64_t loc = start;
+	sym_dwarf_buf_t init = { cie.insns, cie.end, false };
+	if (sym_frame_run(&init, &cie, &loc, ~0ULL, &rule) == -1 ||
+	    sym_frame_run(&insns, &cie, &loc, pc, &rule) == -1 || rule.expr) {
+		return -1;
+	}
+
+	*reg = rule.reg;
+	*off = rule.off;
+	return 0;
+}
+
+void sym_frame_cleanup(void)
+{
+	free(sym_frame_fdes);
+	sym_frame_fdes = NULL;
+	sym_frame_fde_count = 0;
+	sym_frame_read = false;
+	memset(&sym_frame_sec, 0, sizeof(sym_frame_sec));
+}
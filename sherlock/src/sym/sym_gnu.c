@@ -0,0 +1,442 @@
+/*
+ * Sherlock - A Minimal Debugger
+ * Part of the Sherlock project
+ *
+ * Copyright (c) 2025-26 Mohammad Shehar Yaar Tausif <sheharyaar48@gmail.com>
+ *
+ * This file is licensed under the MIT License.
+ */
+
+#define _GNU_SOURCE
+#include "sym_internal.h"
+#include <link.h>
+
+/*
+ * Name lookups in the loaded objects through the dynamic linker's own tables,
+ * without parsing the library files. r_debug.r_map lists every object with
+ * its load bias and _DYNAMIC, which has the addresses of .gnu.hash, .dynsym
+ * and .dynstr in the tracee. A lookup is what ld.so does for every object:
+ *
+ *   h = dl_new_hash(name)
+ *   bloom word (h / 64) % bloom_size must have bits h % 64 and
+ *   (h >> bloom_shift) % 64 set, else the object does not define it
+ *   bucket[h % nbuckets] is the first symbol of the chain, chain entries
+ *   hold the hash of every symbol (low bit set on the last one), only
+ *   symbols with the same hash have their name compared
+ *
+ * The objects come from the link map walker (sym_link.c) through the library
+ * ranges. Per object, the dynamic entries, the bloom filter and the buckets
+ * are read once (one bulk read each) on its first lookup and kept until the
+ * object is unloaded; a lookup then reads a block of the chain, and the symbol
+ * and its name for every hash match. Only exported names can be found this
+ * way, the callers fall back to the symbol table for the rest.
+ *
+ * An exported ifunc (memcpy, strlen, ...) is the resolver, not the function
+ * that runs. Its object calls it through an IRELATIVE relocation with the
+ * resolver as addend, whose slot ld.so filled with the implementation the
+ * resolver picked. The relocation tables and then the span of those slots are
+ * read in bulk on the first ifunc lookup in the object.
+ */
+
+// chain entries read at once, chains are short
+#define SYM_GNU_CHAIN_BLOCK 16
+#define SYM_GNU_PAGE 4096UL
+
+typedef struct SYM_GNU_IREL {
+	unsigned long long resolver;
+	unsigned long long slot;
+	unsigned long long target;
+} sym_gnu_irel_t;
+
+typedef struct SYM_GNU_OBJ {
+	unsigned long long bias;
+	unsigned long long ld;
+	unsigned long long hash;
+	unsigned long long symtab;
+	unsigned long long strtab;
+	unsigned long long versym;
+	uint32_t nbuckets;
+	uint32_t symoffset;
+	uint32_t bloom_size;
+	uint32_t bloom_shift;
+	// bloom_size words followed by nbuckets buckets
+	uint64_t *tables;
+	bool failed;
+	// DT_JMPREL and DT_RELA tables
+	unsigned long long rel[2];
+	unsigned long long rel_size[2];
+	// IRELATIVE resolvers and the slot values, sorted by resolver
+	sym_gnu_irel_t *irel;
+	unsigned int irel_count;
+	bool irel_read;
+	UT_hash_handle hh;
+} sym_gnu_obj_t;
+
+// objects looked up so far, keyed by the address of their _DYNAMIC
+static sym_gnu_obj_t *sym_gnu_objs = NULL;
+
+static uint32_t sym_gnu_hash(const char *name)
+{
+	uint32_t h = 5381;
+	for (const unsigned char *p = (const unsigned char *)name; *p != '\0';
+	    p++) {
+		h = (h << 5) + h + *p;
+	}
+
+	return h;
+}
+
+// Reads the dynamic entries of the object and its hash table header, bloom
+// filter and buckets.
+static int sym_gnu_load(pid_t pid, sym_gnu_obj_t *obj)
+{
+	// entries never straddle a page, read up to the end of each page
+	Elf64_Dyn dyn[SYM_GNU_PAGE / sizeof(Elf64_Dyn)];
+	unsigned long long addr = obj->ld;
+	bool done = false;
+	while (!done) {
+		size_t len = SYM_GNU_PAGE - (addr % SYM_GNU_PAGE);
+		if (sym_mem_read(pid, addr, dyn, len) == -1)
+			return -1;
+
+		for (size_t i = 0; i < len / sizeof(Elf64_Dyn); i++) {
+			// ld.so relocates these in place, except in read-only
+			// dynamic sections like the vdso's
+			unsigned long long ptr = dyn[i].d_un.d_ptr;
+			if (ptr < obj->bias)
+				ptr += obj->bias;
+
+			if (dyn[i].d_tag == DT_NULL) {
+				done = true;
+				break;
+			} else if (dyn[i].d_tag == DT_GNU_HASH) {
+				obj->hash = ptr;
+			} else if (dyn[i].d_tag == DT_SYMTAB) {
+				obj->symtab = ptr;
+			} else if (dyn[i].d_tag == DT_STRTAB) {
+				obj->strtab = ptr;
+			} else if (dyn[i].d_tag == DT_VERSYM) {
+				obj->versym = ptr;
+			} else if (dyn[i].d_tag == DT_JMPREL) {
+				obj->rel[0] = ptr;
+			} else if (dyn[i].d_tag == DT_PLTRELSZ) {
+				obj->rel_size[0] = dyn[i].d_un.d_val;
+			} else if (dyn[i].d_tag == DT_RELA) {
+				obj->rel[1] = ptr;
+			} else if (dyn[i].d_tag == DT_RELASZ) {
+				obj->rel_size[1] = dyn[i].d_un.d_val;
+			}
+		}
+		addr += len;
+	}
+
+	if (obj->hash == 0 || obj->symtab == 0 || obj->strtab == 0) {
+		pr_debug("no DT_GNU_HASH in object at %#llx", obj->bias);
+		return -1;
+	}
+
+	uint32_t hdr[4];
+	if (sym_mem_read(pid, obj->hash, hdr, sizeof(hdr)) == -1)
+		return -1;
+
+	obj->nbuckets = hdr[0];
+	obj->symoffset = hdr[1];
+	obj->bloom_size = hdr[2];
+	obj->bloom_shift = hdr[3];
+	if (obj->nbuckets == 0 || obj->bloom_size == 0 ||
+	    (obj->bloom_size & (obj->bloom_size - 1)) != 0) {
+		pr_debug("invalid DT_GNU_HASH in object at %#llx", obj->bias);
+		return -1;
+	}
+
+	size_t len = obj->bloom_size * sizeof(uint64_t) +
+	    obj->nbuckets * sizeof(uint32_t);
+	obj->tables = malloc(len);
+	if (obj->tables == NULL) {
+		pr_err("error in allocating hash table: %s", strerror(errno));
+		return -1;
+	}
+
+	if (sym_mem_read(pid, obj->hash + sizeof(hdr), obj->tables, len) ==
+	    -1) {
+		free(obj->tables);
+		obj->tables = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+static int sym_gnu_irel_cmp(const void *a, const void *b)
+{
+	const sym_gnu_irel_t *x = a;
+	const sym_gnu_irel_t *y = b;
+
+	if (x->resolver != y->resolver)
+		return (x->resolver < y->resolver) ? -1 : 1;
+
+	return 0;
+}
+
+// Reads the relocation tables of the object, keeps the IRELATIVE entries and
+// then reads all their slots at once.
+static int sym_gnu_irel_load(pid_t pid, sym_gnu_obj_t *obj)
+{
+	unsigned int cap = 0;
+	for (int t = 0; t < 2; t++) {
+		size_t count = obj->rel_size[t] / sizeof(Elf64_Rela);
+		if (obj->rel[t] == 0 || count == 0)
+			continue;
+
+		Elf64_Rela *rela = malloc(count * sizeof(Elf64_Rela));
+		if (rela == NULL) {
+			pr_err("error in allocating relocations: %s",
+			    strerror(errno));
+			return -1;
+		}
+
+		if (sym_mem_read(pid, obj->rel[t], rela,
+			count * sizeof(Elf64_Rela)) == -1) {
+			free(rela);
+			return -1;
+		}
+
+		for (size_t i = 0; i < count; i++) {
+			if (ELF64_R_TYPE(rela[i].r_info) != R_X86_64_IRELATIVE)
+				continue;
+
+			if (obj->irel_count == cap) {
+				cap = cap ? cap * 2 : 32;
+				sym_gnu_irel_t *n =
+				    realloc(obj->irel, cap * sizeof(*n));
+				if (n == NULL) {
+					pr_err("error in allocating ifuncs: %s",
+					    strerror(errno));
+					free(rela);
+					return -1;
+				}
+				obj->irel = n;
+			}
+
+			sym_gnu_irel_t *e = &obj->irel[obj->irel_count++];
+			e->resolver = rela[i].r_addend;
+			e->slot = obj->bias + rela[i].r_offset;
+		}
+		free(rela);
+	}
+
+	if (obj->irel_count == 0)
+		return 0;
+
+	unsigned long long lo = ~0ULL;
+	unsigned long long hi = 0;
+	for (unsigned int i = 0; i < obj->irel_count; i++) {
+		if (obj->irel[i].slot < lo)
+			lo = obj->irel[i].slot;
+		if (obj->irel[i].slot + sizeof(uint64_t) > hi)
+			hi = obj->irel[i].slot + sizeof(uint64_t);
+	}
+
+	unsigned char *slots = malloc(hi - lo);
+	if (slots == NULL) {
+		pr_err("error in allocating ifunc slots: %s", strerror(errno));
+		return -1;
+	}
+
+	if (sym_mem_read(pid, lo, slots, hi - lo) == -1) {
+		free(slots);
+		return -1;
+	}
+
+	for (unsigned int i = 0; i < obj->irel_count; i++) {
+		memcpy(&obj->irel[i].target, slots + (obj->irel[i].slot - lo),
+		    sizeof(uint64_t));
+	}
+	free(slots);
+
+	qsort(obj->irel, obj->irel_count, sizeof(sym_gnu_irel_t),
+	    sym_gnu_irel_cmp);
+	pr_debug("%u ifunc slots in object at %#llx", obj->irel_count,
+	    obj->bias);
+	return 0;
+}
+
+// Finds the implementation picked for the ifunc whose resolver is at
+// 'resolver' (relative to the object). Returns 0 if the object never calls
+// it itself.
+static int sym_gnu_ifunc(pid_t pid, sym_gnu_obj_t *obj,
+    unsigned long long resolver, unsigned long long *addr)
+{
+	if (!obj->irel_read) {
+		obj->irel_read = true;
+		if (sym_gnu_irel_load(pid, obj) == -1) {
+			free(obj->irel);
+			obj->irel = NULL;
+			obj->irel_count = 0;
+			return -1;
+		}
+	}
+
+	sym_gnu_irel_t key = { .resolver = resolver };
+	sym_gnu_irel_t *e = bsearch(&key, obj->irel, obj->irel_count,
+	    sizeof(sym_gnu_irel_t), sym_gnu_irel_cmp);
+	if (e == NULL || e->target == 0)
+		return 0;
+
+	*addr = e->target;
+	return 1;
+}
+
+// Compares the name of symbol 'idx' and checks it is a function definition
+// (or an ifunc) that unversioned lookups can bind to.
+static int sym_gnu_check(pid_t pid, sym_gnu_obj_t *obj, uint32_t idx,
+    const char *name, size_t name_len, Elf64_Sym *sym)
+{
+	if (sym_mem_read(pid, obj->symtab + idx * sizeof(Elf64_Sym), sym,
+		sizeof(*sym)) == -1) {
+		return -1;
+	}
+
+	unsigned char type = ELF64_ST_TYPE(sym->st_info);
+	if ((type != STT_FUNC && type != STT_GNU_IFUNC) ||
+	    sym->st_shndx == SHN_UNDEF || sym->st_value == 0) {
+		return 0;
+	}
+
+	// page by page, a shorter name can end right before an unmapped one
+	unsigned long long at = obj->strtab + sym->st_name;
+	char buf[SHERLOCK_MAX_STRLEN];
+	for (size_t off = 0; off < name_len + 1;) {
+		size_t len = SYM_GNU_PAGE - ((at + off) % SYM_GNU_PAGE);
+		if (len > name_len + 1 - off)
+			len = name_len + 1 - off;
+		if (len > sizeof(buf))
+			len = sizeof(buf);
+
+		if (sym_mem_read(pid, at + off, buf, len) == -1)
+			return -1;
+		if (memcmp(buf, name + off, len) != 0)
+			return 0;
+		off += len;
+	}
+
+	// hidden versions (foo@OLD) are only for versioned references
+	if (obj->versym != 0) {
+		uint16_t ver = 0;
+		if (sym_mem_read(pid, obj->versym + idx * sizeof(ver), &ver,
+			sizeof(ver)) == 0 &&
+		    (ver & 0x8000) != 0) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+int sym_gnu_lookup(tracee_t *tracee, unsigned long long bias,
+    unsigned long long ld, const char *name, unsigned long long *addr,
+    unsigned long long *size)
+{
+	sym_gnu_obj_t *obj = NULL;
+	HASH_FIND(hh, sym_gnu_objs, &ld, sizeof(ld), obj);
+	if (obj == NULL) {
+		obj = calloc(1, sizeof(*obj));
+		if (obj == NULL) {
+			pr_err("error in allocating link map object: %s",
+			    strerror(errno));
+			return -1;
+		}
+
+		obj->bias = bias;
+		obj->ld = ld;
+		obj->failed = (sym_gnu_load(tracee->pid, obj) == -1);
+		HASH_ADD(hh, sym_gnu_objs, ld, sizeof(obj->ld), obj);
+	}
+
+	if (obj->failed)
+		return -1;
+
+	uint32_t h = sym_gnu_hash(name);
+	uint64_t word = obj->tables[(h / 64) & (obj->bloom_size - 1)];
+	uint64_t mask =
+	    (1UL << (h % 64)) | (1UL << ((h >> obj->bloom_shift) % 64));
+	if ((word & mask) != mask)
+		return 0;
+
+	uint32_t *buckets = (uint32_t *)&obj->tables[obj->bloom_size];
+	uint32_t idx = buckets[h % obj->nbuckets];
+	if (idx < obj->symoffset)
+		return 0;
+
+	unsigned long long chain = obj->hash + 4 * sizeof(uint32_t) +
+	    obj->bloom_size * sizeof(uint64_t) +
+	    obj->nbuckets * sizeof(uint32_t);
+	size_t name_len = strlen(name);
+	uint32_t block[SYM_GNU_CHAIN_BLOCK];
+	for (;;) {
+		// the chain array can end at the end of the mapping
+		unsigned long long at =
+		    chain + (idx - obj->symoffset) * sizeof(uint32_t);
+		size_t len = SYM_GNU_PAGE - (at % SYM_GNU_PAGE);
+		if (len > sizeof(block))
+			len = sizeof(block);
+
+		if (sym_mem_read(tracee->pid, at, block, len) == -1)
+			return -1;
+
+		unsigned int n = len / sizeof(uint32_t);
+		for (unsigned int i = 0; i < n; i++, idx++) {
+			if ((block[i] | 1) == (h | 1)) {
+				Elf64_Sym sym;
+				int ret = sym_gnu_check(tracee->pid, obj, idx,
+				    name, name_len, &sym);
+				if (ret == -1)
+					return -1;
+
+				bool ifunc = ELF64_ST_TYPE(sym.st_info) ==
+				    STT_GNU_IFUNC;
+				if (ret == 1 && ifunc) {
+					// the size is the resolver's
+					*size = 0;
+					return sym_gnu_ifunc(tracee->pid, obj,
+					    sym.st_value, addr);
+				}
+
+				if (ret == 1) {
+					*addr = obj->bias + sym.st_value;
+					*size = sym.st_size;
+					return 1;
+				}
+			}
+
+			// the last symbol of the chain
+			if (block[i] & 1)
+				return 0;
+		}
+	}
+}
+
+static void sym_gnu_free(sym_gnu_obj_t *obj)
+{
+	HASH_DEL(sym_gnu_objs, obj);
+	free(obj->irel);
+	free(obj->tables);
+	free(obj);
+}
+
+void sym_gnu_drop(unsigned long long ld)
+{
+	sym_gnu_obj_t *obj = NULL;
+	HASH_FIND(hh, sym_gnu_objs, &ld, sizeof(ld), obj);
+	if (obj != NULL)
+		sym_gnu_free(obj);
+}
+
+void sym_gnu_cleanup(void)
+{
+	sym_gnu_obj_t *obj, *tmp;
+	HASH_ITER(hh, sym_gnu_objs, obj, tmp)
+	{
+		sym_gnu_free(obj);
+	}
+}
@@ -0,0 +1,174 @@
+/*
+ * Sherlock - A Minimal Debugger
+ * Part of the Sherlock project
+ *
+ * Copyright (c) 2025-26 Mohammad Shehar Yaar Tausif <sheharyaar48@gmail.com>
+ *
+ * This file is licensed under the MIT License.
+ */
+
+#define _GNU_SOURCE
+#include "sym_internal.h"
+#include <sherlock/mem.h>
+
+/*
+ * Snapshot of the GOT slots of the dynamic symbols. On every r_brk stop the
+ * GOT may have been patched by the dynamic linker, instead of a PEEKDATA per
+ * slot the whole span from the lowest to the highest slot (.got and .got.plt
+ * are adjacent) is read with one mem_read and compared against the
+ * previous read. Only the slots that differ are handed to the caller.
+ *
+ * The comparison is done in blocks with memcmp, which is vectorised in libc,
+ * and only blocks that differ are looked at word by word.
+ */
+
+#define SYM_GOT_BLOCK 64
+
+static int sym_got_slot_cmp(const void *a, const void *b)
+{
+	const sym_got_slot_t *x = a;
+	const sym_got_slot_t *y = b;
+
+	if (x->off != y->off)
+		return (x->off < y->off) ? -1 : 1;
+
+	return 0;
+}
+
+int sym_mem_read(pid_t pid, unsigned long long addr, void *buf, size_t len)
+{
+	if (mem_read(pid, addr, buf, len) == -1) {
+		pr_err("error in reading tracee memory at %#llx: %s", addr,
+		    strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+int sym_got_build(sym_got_t *got, symbol_t *symtab)
+{
+	unsigned int count = 0;
+	unsigned long long lo = ~0ULL;
+	unsigned long long hi = 0;
+
+	symbol_t *sym, *tmp;
+	HASH_ITER(hh, symtab, sym, tmp)
+	{
+		if (!sym->dyn_sym || !sym->needs_resolve)
+			continue;
+
+		if (sym->got.addr < lo)
+			lo = sym->got.addr;
+		if (sym->got.addr > hi)
+			hi = sym->got.addr;
+		count++;
+	}
+
+	if (count == 0)
+		return 0;
+
+	got->start = lo;
+	got->size = hi - lo + sizeof(uint64_t);
+	got->slots = calloc(count, sizeof(sym_got_slot_t));
+	got->prev = calloc(2, got->size);
+	if (got->slots == NULL || got->prev == NULL) {
+		pr_err("error in allocating GOT snapshot: %s", strerror(errno));
+		sym_got_free(got);
+		return -1;
+	}
+	got->cur = got->prev + got->size;
+
+	unsigned int n = 0;
+	HASH_ITER(hh, symtab, sym, tmp)
+	{
+		if (!sym->dyn_sym || !sym->needs_resolve)
+			continue;
+
+		got->slots[n].off = sym->got.addr - lo;
+		got->slots[n].sym = sym;
+		n++;
+	}
+
+	qsort(got->slots, n, sizeof(sym_got_slot_t), sym_got_slot_cmp);
+	got->count = n;
+	got->valid = false;
+
+	pr_debug("GOT snapshot of %u slots over %#llx-%#llx", n, lo,
+	    lo + got->size);
+	return 0;
+}
+
+int sym_got_refresh(sym_got_t *got, pid_t pid, sym_got_cb cb, void *arg)
+{
+	if (got->count == 0)
+		return 0;
+
+	if (sym_mem_read(pid, got->start, got->cur, got->size) == -1)
+		return -1;
+
+	int ret = 0;
+	unsigned int s = 0;
+	for (size_t off = 0; off < got->size && s < got->count;
+	    off += SYM_GOT_BLOCK) {
+		size_t len = got->size - off;
+		if (len > SYM_GOT_BLOCK)
+			len = SYM_GOT_BLOCK;
+
+		// the first refresh has nothing to compare against, every slot
+		// is checked against the value the symbol was created with
+		if (got->valid &&
+		    memcmp(got->prev + off, got->cur + off, len) == 0) {
+			continue;
+		}
+
+		while (s < got->count && got->slots[s].off < off)
+			s++;
+
+		for (; s < got->count && got->slots[s].off < off + len; s++) {
+			uint64_t old_val, new_val;
+			memcpy(&old_val, got->prev + got->slots[s].off,
+			    sizeof(old_val));
+			memcpy(&new_val, got->cur + got->slots[s].off,
+			    sizeof(new_val));
+			if (got->valid && old_val == new_val)
+				continue;
+
+			int r = cb(got->slots[s].sym, new_val, arg);
+			if (r == -1) {
+				// keep the old snapshot so the next refresh
+				// retries the same slots
+				return -1;
+			}
+			ret += r;
+		}
+	}
+
+	unsigned char *t = got->prev;
+	got->prev = got->cur;
+	got->cur = t;
+	got->valid = true;
+	return ret;
+}
+
+void sym_got_free(sym_got_t *got)
+{
+	if (got->slots != NULL) {
+		free(got->slots);
+		got->slots = NULL;
+	}
+
+	// prev and cur share one allocation
+	if (got->prev != NULL) {
+		unsigned char *buf = got->prev;
+		if (got->cur != NULL && got->cur < buf)
+			buf = got->cur;
+		free(buf);
+		got->prev = NULL;
+		got->cur = NULL;
+	}
+
+	got->count = 0;
+	got->size = 0;
+	got->valid = false;
+}
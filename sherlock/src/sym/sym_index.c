@@ -0,0 +1,214 @@
+/*
+ * Sherlock - A Minimal Debugger
+ * Part of the Sherlock project
+ *
+ * Copyright (c) 2025-26 Mohammad Shehar Yaar Tausif <sheharyaar48@gmail.com>
+ *
+ * This file is licensed under the MIT License.
+ */
+
+#include "sym_internal.h"
+
+/*
+ * Address index for the symbol table. The symbols live in a uthash keyed by
+ * name, which is fine for name lookups but means an address lookup has to walk
+ * every symbol. The index is a flat array of [start, end] ranges sorted by
+ * start address, so lookups are a binary search.
+ *
+ * Symbols can overlap (aliases, nested local labels), so each entry also keeps
+ * the highest end address seen so far (cover). After the binary search we walk
+ * back only while an earlier entry can still contain the address, which is
+ * almost always zero or one step.
+ *
+ * Only dynamic symbols change address after setup (a GLOB_DAT slot getting
+ * filled, a PLT symbol resolving to its target). Rebuilding for those would be
+ * O(n log n) per event, so the full index is left alone and entries whose
+ * symbol has moved away are skipped as stale. The moved symbols are kept in a
+ * second, small index which is updated in place with sym_index_move.
+ */
+
+// Returns the position of the first entry whose start is > addr.
+static unsigned int sym_index_upper(
+    sym_addr_index_t *idx, unsigned long long addr)
+{
+	unsigned int lo = 0;
+	unsigned int hi = idx->count;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (idx->ents[mid].start <= addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+// Recomputes the cover of the entries from 'pos' on. An entry's cover only
+// depends on the previous cover and its own end, so this stops as soon as a
+// cover comes out unchanged.
+static void sym_index_cover(sym_addr_index_t *idx, unsigned int pos)
+{
+	unsigned long long cover = (pos > 0) ? idx->ents[pos - 1].cover : 0;
+	for (unsigned int i = pos; i < idx->count; i++) {
+		if (idx->ents[i].end > cover)
+			cover = idx->ents[i].end;
+
+		if (i > pos && idx->ents[i].cover == cover)
+			break;
+		idx->ents[i].cover = cover;
+	}
+}
+
+static int sym_index_cmp(const void *a, const void *b)
+{
+	const sym_addr_ent_t *x = a;
+	const sym_addr_ent_t *y = b;
+
+	if (x->start != y->start)
+		return (x->start < y->start) ? -1 : 1;
+
+	return 0;
+}
+
+// Computes the last address covered by the symbol. Static symbols know their
+// size, dynamic ones (PLT entries and GOT resolved addresses) do not, so they
+// are bounded by the section they live in. Returns 0 if the symbol should not
+// be indexed.
+static unsigned long long sym_index_end(symbol_t *sym)
+{
+	if (sym->addr == 0)
+		return 0;
+
+	if (!sym->dyn_sym)
+		return sym->addr + sym->size;
+
+	// the section pointer can be stale once the GOT resolves to another
+	// object, so look it up again
+	section_t *sec = sym_addr_section(sym->addr, 0);
+	if (sec != NULL)
+		return sec->end;
+
+	// outside the binary, only the exact address is known
+	return sym->addr;
+}
+
+int sym_index_build(sym_addr_index_t *idx, symbol_t *symtab)
+{
+	unsigned int count = HASH_COUNT(symtab);
+	if (count > idx->cap) {
+		sym_addr_ent_t *t = realloc(idx->ents, count * sizeof(*t));
+		if (t == NULL) {
+			pr_err("error in realloc sym index: %s",
+			    strerror(errno));
+			return -1;
+		}
+
+		idx->ents = t;
+		idx->cap = count;
+	}
+
+	unsigned int n = 0;
+	symbol_t *sym, *tmp;
+	HASH_ITER(hh, symtab, sym, tmp)
+	{
+		if (sym->addr == 0)
+			continue;
+
+		idx->ents[n].start = sym->addr;
+		idx->ents[n].end = sym_index_end(sym);
+		idx->ents[n].sym = sym;
+		n++;
+	}
+
+	qsort(idx->ents, n, sizeof(sym_addr_ent_t), sym_index_cmp);
+
+	unsigned long long cover = 0;
+	for (unsigned int i = 0; i < n; i++) {
+		if (idx->ents[i].end > cover)
+			cover = idx->ents[i].end;
+		idx->ents[i].cover = cover;
+	}
+
+	idx->count = n;
+	pr_debug("sym index built with %u entries", n);
+	return 0;
+}
+
+symbol_t *sym_index_lookup(sym_addr_index_t *idx, unsigned long long addr)
+{
+	unsigned int lo = sym_index_upper(idx, addr);
+
+	// walk back over entries starting at or before addr, the closest one
+	// that contains addr wins
+	while (lo > 0) {
+		sym_addr_ent_t *ent = &idx->ents[--lo];
+		if (ent->cover < addr)
+			break;
+
+		// the symbol has moved since the entry was added
+		if (ent->start != ent->sym->addr)
+			continue;
+
+		if (addr <= ent->end)
+			return ent->sym;
+	}
+
+	return NULL;
+}
+
+int sym_index_move(
+    sym_addr_index_t *idx, symbol_t *sym, unsigned long long old_addr)
+{
+	// drop the entry at the old address, if the symbol had one here
+	if (old_addr != 0) {
+		unsigned int pos = sym_index_upper(idx, old_addr);
+		while (pos > 0 && idx->ents[pos - 1].start == old_addr) {
+			if (idx->ents[--pos].sym != sym)
+				continue;
+
+			memmove(&idx->ents[pos], &idx->ents[pos + 1],
+			    (idx->count - pos - 1) * sizeof(sym_addr_ent_t));
+			idx->count--;
+			sym_index_cover(idx, pos);
+			break;
+		}
+	}
+
+	if (sym->addr == 0)
+		return 0;
+
+	if (idx->count == idx->cap) {
+		unsigned int cap = idx->cap ? idx->cap * 2 : 64;
+		sym_addr_ent_t *t = realloc(idx->ents, cap * sizeof(*t));
+		if (t == NULL) {
+			pr_err("error in realloc sym index: %s",
+			    strerror(errno));
+			return -1;
+		}
+
+		idx->ents = t;
+		idx->cap = cap;
+	}
+
+	unsigned int pos = sym_index_upper(idx, sym->addr);
+	memmove(&idx->ents[pos + 1], &idx->ents[pos],
+	    (idx->count - pos) * sizeof(sym_addr_ent_t));
+	idx->ents[pos].start = sym->addr;
+	idx->ents[pos].end = sym_index_end(sym);
+	idx->ents[pos].sym = sym;
+	idx->count++;
+	sym_index_cover(idx, pos);
+	return 0;
+}
+
+void sym_index_free(sym_addr_index_t *idx)
+{
+	if (idx->ents != NULL) {
+		free(idx->ents);
+		idx->ents = NULL;
+	}
+
+	idx->count = 0;
+	idx->cap = 0;
+}
@@ -16,9 +16,30 @@
 #include <libelf.h>
 #include <gelf.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
 
 #define MATCH_STR(str_var, str) strcmp(str_var, #str) == 0
 
+// Binary searches 'list' (sorted by start, non-overlapping) for the entry
+// containing [addr, addr + size] and stores it in 'res' (NULL if none).
+#define SYM_RANGE_FIND(list, count, addr, size, res)                          \
+	do {                                                                   \
+		unsigned int _lo = 0;                                          \
+		unsigned int _hi = (count);                                    \
+		res = NULL;                                                    \
+		while (_lo < _hi) {                                            \
+			unsigned int _mid = _lo + (_hi - _lo) / 2;             \
+			if ((list)[_mid].start <= (addr))                      \
+				_lo = _mid + 1;                                \
+			else                                                   \
+				_hi = _mid;                                    \
+		}                                                              \
+                                                                               \
+		if (_lo > 0 && (addr) + (size) <= (list)[_lo - 1].end)         \
+			res = &(list)[_lo - 1];                                \
+	} while (0)
+
 #define SHERLOCK_SYMBOL(                                                       \
     _sym, _base, _addr, _gotaddr, _gotval, _sz, _name, _dyn, _res)             \
 	do {                                                                   \
@@ -60,7 +81,421 @@
 	SHERLOCK_SYMBOL(                                                       \
 	    _sym, _base, _addr, _got_addr, _got_val, 0UL, _name, true, _res)
 
+typedef struct SYM_ADDR_ENT {
+	unsigned long long start;
+	unsigned long long end;
+	// highest end address among this and all the previous entries
+	unsigned long long cover;
+	symbol_t *sym;
+} sym_addr_ent_t;
+
+typedef struct SYM_ADDR_INDEX {
+	sym_addr_ent_t *ents;
+	unsigned int count;
+	unsigned int cap;
+} sym_addr_index_t;
+
+typedef struct SYM_NAME_ENT {
+	const char *name;
+	// run of the definitions in sym_name_index_t::syms
+	unsigned int first;
+	unsigned int count;
+	UT_hash_handle hh;
+} sym_name_ent_t;
+
+typedef struct SYM_NAME_INDEX {
+	sym_name_ent_t *hash;
+	sym_name_ent_t *ents;
+	unsigned int count;
+	symbol_t **syms;
+	// ents sorted by name, only built for pattern lookups
+	sym_name_ent_t **sorted;
+	// number of C++ (_Z) names in ents, counted on build
+	unsigned int mangled;
+	// demangled names, built on the first lookup that needs them:
+	// demangled[i] is the name of ents[i] (NULL if not C++), dm_hash is
+	// keyed by the name without parameters and dm_runs holds the ents
+	// indices of every run (sym_demangle.c)
+	char **demangled;
+	char **dm_keys;
+	sym_name_ent_t *dm_hash;
+	sym_name_ent_t *dm_ents;
+	unsigned int *dm_runs;
+	bool built;
+	bool dm_built;
+} sym_name_index_t;
+
+typedef struct SYM_NAME_SPEC {
+	char buf[SHERLOCK_MAX_STRLEN];
+	const char *name;
+	const char *file;
+	const char *lib;
+} sym_name_spec_t;
+
+typedef struct SYM_ARENA_CHUNK {
+	struct SYM_ARENA_CHUNK *next;
+	size_t used;
+	size_t cap;
+	symbol_t syms[];
+} sym_arena_chunk_t;
+
+typedef struct SYM_ARENA {
+	sym_arena_chunk_t *head;
+	size_t count;
+} sym_arena_t;
+
+typedef enum {
+	SYM_LIB_NEW,
+	SYM_LIB_LOADING,
+	SYM_LIB_LOADED,
+	SYM_LIB_FAILED,
+} sym_lib_state_e;
+
+typedef struct SYM_LIB {
+	char *key;
+	const char *path;
+	unsigned long inode;
+	unsigned long long map_start;
+	unsigned long long bias;
+	sym_lib_state_e state;
+	Elf *elf;
+	// separate debug file the symbols come from
+	Elf *dbg;
+	symbol_t *symtab;
+	sym_arena_t arena;
+	sym_addr_index_t index;
+	sym_name_index_t names;
+	// exported functions found through the link map before the library
+	// was parsed (sym_gnu.c)
+	symbol_t *dynsyms;
+	UT_hash_handle hh;
+} sym_lib_t;
+
+typedef struct SYM_LIB_RANGE {
+	unsigned long long start;
+	unsigned long long end;
+	// load bias and _DYNAMIC from the link map, 0 when the range comes
+	// from the mappings alone
+	unsigned long long bias;
+	unsigned long long ld;
+	sym_lib_t *lib;
+} sym_lib_range_t;
+
+#define SYM_CACHE_NO_FILE 0xFFFFFFFFU
+#define SYM_BUILD_ID_MAX 64
+
+typedef struct SYM_CACHE_ENT {
+	uint64_t addr;
+	uint64_t size;
+	uint32_t name;
+	uint32_t name_len;
+	uint32_t file;
+	uint32_t hashv;
+} sym_cache_ent_t;
+
+typedef struct SYM_CACHE {
+	void *map;
+	size_t map_len;
+	const sym_cache_ent_t *ents;
+	uint32_t count;
+	const char *strs;
+} sym_cache_t;
+
+typedef struct SYM_GOT_SLOT {
+	unsigned long long off;
+	symbol_t *sym;
+} sym_got_slot_t;
+
+typedef struct SYM_GOT {
+	unsigned long long start;
+	size_t size;
+	sym_got_slot_t *slots;
+	unsigned int count;
+	// the last read and the scratch buffer for the next one
+	unsigned char *prev;
+	unsigned char *cur;
+	bool valid;
+} sym_got_t;
+
+// DWARF constants used by the readers, there is no dwarf.h to rely on
+#define SYM_DW_AT_location 0x02
+#define SYM_DW_AT_name 0x03
+#define SYM_DW_AT_byte_size 0x0b
+#define SYM_DW_AT_stmt_list 0x10
+#define SYM_DW_AT_low_pc 0x11
+#define SYM_DW_AT_high_pc 0x12
+#define SYM_DW_AT_comp_dir 0x1b
+#define SYM_DW_AT_const_value 0x1c
+#define SYM_DW_AT_upper_bound 0x2f
+#define SYM_DW_AT_abstract_origin 0x31
+#define SYM_DW_AT_count 0x37
+#define SYM_DW_AT_data_member_location 0x38
+#define SYM_DW_AT_declaration 0x3c
+#define SYM_DW_AT_encoding 0x3e
+#define SYM_DW_AT_external 0x3f
+#define SYM_DW_AT_frame_base 0x40
+#define SYM_DW_AT_specification 0x47
+#define SYM_DW_AT_type 0x49
+#define SYM_DW_AT_str_offsets_base 0x72
+#define SYM_DW_AT_addr_base 0x73
+#define SYM_DW_FORM_addr 0x01
+#define SYM_DW_FORM_block2 0x03
+#define SYM_DW_FORM_block4 0x04
+#define SYM_DW_FORM_data2 0x05
+#define SYM_DW_FORM_data4 0x06
+#define SYM_DW_FORM_data8 0x07
+#define SYM_DW_FORM_string 0x08
+#define SYM_DW_FORM_block 0x09
+#define SYM_DW_FORM_block1 0x0a
+#define SYM_DW_FORM_data1 0x0b
+#define SYM_DW_FORM_flag 0x0c
+#define SYM_DW_FORM_sdata 0x0d
+#define SYM_DW_FORM_strp 0x0e
+#define SYM_DW_FORM_udata 0x0f
+#define SYM_DW_FORM_ref_addr 0x10
+#define SYM_DW_FORM_ref1 0x11
+#define SYM_DW_FORM_ref2 0x12
+#define SYM_DW_FORM_ref4 0x13
+#define SYM_DW_FORM_ref8 0x14
+#define SYM_DW_FORM_ref_udata 0x15
+#define SYM_DW_FORM_indirect 0x16
+#define SYM_DW_FORM_sec_offset 0x17
+#define SYM_DW_FORM_exprloc 0x18
+#define SYM_DW_FORM_flag_present 0x19
+#define SYM_DW_FORM_strx 0x1a
+#define SYM_DW_FORM_addrx 0x1b
+#define SYM_DW_FORM_ref_sup4 0x1c
+#define SYM_DW_FORM_strp_sup 0x1d
+#define SYM_DW_FORM_data16 0x1e
+#define SYM_DW_FORM_line_strp 0x1f
+#define SYM_DW_FORM_ref_sig8 0x20
+#define SYM_DW_FORM_implicit_const 0x21
+#define SYM_DW_FORM_loclistx 0x22
+#define SYM_DW_FORM_rnglistx 0x23
+#define SYM_DW_FORM_ref_sup8 0x24
+#define SYM_DW_FORM_strx1 0x25
+#define SYM_DW_FORM_strx2 0x26
+#define SYM_DW_FORM_strx3 0x27
+#define SYM_DW_FORM_strx4 0x28
+#define SYM_DW_FORM_addrx1 0x29
+#define SYM_DW_FORM_addrx2 0x2a
+#define SYM_DW_FORM_addrx3 0x2b
+#define SYM_DW_FORM_addrx4 0x2c
+#define SYM_DW_FORM_GNU_addr_index 0x1f01
+#define SYM_DW_FORM_GNU_str_index 0x1f02
+#define SYM_DW_FORM_GNU_ref_alt 0x1f20
+#define SYM_DW_FORM_GNU_strp_alt 0x1f21
+
+// Bounds checked cursor over a DWARF section. Reading past the end sets 'err'
+// and returns zeroes, so a decoder only has to check it once per record.
+typedef struct SYM_DWARF_BUF {
+	const unsigned char *p;
+	const unsigned char *end;
+	bool err;
+} sym_dwarf_buf_t;
+
+typedef struct SYM_DWARF_SEC {
+	const unsigned char *buf;
+	size_t size;
+} sym_dwarf_sec_t;
+
+typedef struct SYM_DWARF_ARANGE {
+	unsigned long long start;
+	unsigned long long end;
+	uint64_t cu_off;
+} sym_dwarf_arange_t;
+
+typedef struct SYM_DWARF {
+	Elf *elf;
+	sym_dwarf_sec_t info;
+	sym_dwarf_sec_t abbrev;
+	sym_dwarf_sec_t line;
+	sym_dwarf_sec_t line_str;
+	sym_dwarf_sec_t str;
+	sym_dwarf_sec_t str_offsets;
+	sym_dwarf_sec_t addr;
+	sym_dwarf_sec_t aranges;
+	sym_dwarf_sec_t frame;
+	// .eh_frame is always in the executable, its pointers are relative to
+	// where it is loaded
+	sym_dwarf_sec_t eh_frame;
+	uint64_t eh_frame_addr;
+	// address ranges of the compilation units, sorted on first use
+	sym_dwarf_arange_t *ranges;
+	unsigned int range_count;
+	bool ranges_read;
+} sym_dwarf_t;
+
+// what a form decodes to, strings point into the mapped sections
+typedef struct SYM_DWARF_VAL {
+	uint64_t u;
+	const char *str;
+} sym_dwarf_val_t;
+
+// header of a .debug_info unit, needed to decode its forms
+typedef struct SYM_DWARF_CU {
+	uint64_t off;
+	uint64_t end;
+	uint64_t abbrev_off;
+	// where the first DIE starts
+	uint64_t die_off;
+	// DWARF 5 string and address tables, from the unit DIE
+	uint64_t str_offsets_base;
+	uint64_t addr_base;
+	uint16_t version;
+	uint8_t addr_size;
+	bool is64;
+} sym_dwarf_cu_t;
+
+// attributes of the unit DIE
+typedef struct SYM_DWARF_UNIT {
+	uint64_t stmt_list;
+	uint64_t low_pc;
+	uint64_t high_pc;
+	const char *name;
+	const char *comp_dir;
+} sym_dwarf_unit_t;
+
+typedef struct SYM_DWARF_ABBREV {
+	uint64_t code;
+	uint64_t tag;
+	// the attribute specs, in .debug_abbrev
+	const unsigned char *specs;
+	bool children;
+} sym_dwarf_abbrev_t;
+
+typedef struct SYM_DWARF_ABBREVS {
+	sym_dwarf_abbrev_t *ents;
+	unsigned int count;
+} sym_dwarf_abbrevs_t;
+
+// A decoded attribute. References are made absolute (offsets in .debug_info)
+// and blocks point at their data.
+typedef struct SYM_DWARF_ATTR {
+	uint64_t at;
+	uint64_t form;
+	sym_dwarf_val_t val;
+	const unsigned char *block;
+} sym_dwarf_attr_t;
+
+typedef int (*sym_proc_map_cb)(mem_map_t *map, void *arg);
+typedef int (*sym_got_cb)(symbol_t *sym, unsigned long long val, void *arg);
+
 void proc_cleanup(tracee_t *tracee);
+int sym_proc_map_foreach(sym_proc_map_cb cb, void *arg);
+mem_map_t *sym_proc_object_maps(
+    unsigned long long addr, unsigned long long *end);
+int sym_proc_map_refresh(tracee_t *tracee);
 int sym_resolve_dyn(tracee_t *tracee);
 
+// address index (sym_index.c)
+int sym_index_build(sym_addr_index_t *idx, symbol_t *symtab);
+symbol_t *sym_index_lookup(sym_addr_index_t *idx, unsigned long long addr);
+int sym_index_move(
+    sym_addr_index_t *idx, symbol_t *sym, unsigned long long old_addr);
+void sym_index_free(sym_addr_index_t *idx);
+
+// name index (sym_name.c)
+int sym_name_parse(const char *spec, sym_name_spec_t *q, bool pattern);
+bool sym_name_match_file(const char *path, const char *file, bool object);
+int sym_name_index_build(sym_name_index_t *idx, symbol_t *symtab);
+int sym_name_index_foreach(sym_name_index_t *idx, symbol_t *symtab,
+    sym_name_spec_t *q, tracee_t *tracee, sym_name_cb cb, void *arg);
+int sym_name_index_match(sym_name_index_t *idx, symbol_t *symtab,
+    sym_name_spec_t *q, tracee_t *tracee, sym_name_cb cb, void *arg);
+int sym_name_ent_foreach(sym_name_index_t *idx, sym_name_ent_t *ent,
+    sym_name_spec_t *q, tracee_t *tracee, sym_name_cb cb, void *arg,
+    bool *stop);
+void sym_name_index_free(sym_name_index_t *idx);
+
+// C++ names (sym_demangle.c)
+const char *sym_demangle_base(const char *name, size_t *len);
+int sym_demangle_index_build(sym_name_index_t *idx);
+int sym_demangle_index_foreach(sym_name_index_t *idx, symbol_t *symtab,
+    sym_name_spec_t *q, tracee_t *tracee, sym_name_cb cb, void *arg);
+void sym_demangle_index_free(sym_name_index_t *idx);
+void sym_demangle_cleanup(void);
+
+// symbol storage (sym_arena.c)
+int sym_arena_reserve(sym_arena_t *arena, size_t count);
+symbol_t *sym_arena_alloc(sym_arena_t *arena);
+void sym_arena_free(sym_arena_t *arena);
+
+// GOT snapshots (sym_got.c)
+int sym_mem_read(pid_t pid, unsigned long long addr, void *buf, size_t len);
+int sym_got_build(sym_got_t *got, symbol_t *symtab);
+int sym_got_refresh(sym_got_t *got, pid_t pid, sym_got_cb cb, void *arg);
+void sym_got_free(sym_got_t *got);
+
+// separate debug files (sym_debug.c)
+Elf *sym_debug_open(Elf *elf, const char *path);
+Elf_Scn *sym_elf_symtab(Elf *elf, Elf64_Shdr **hdr);
+void sym_debug_cleanup(void);
+
+// DWARF reader (sym_dwarf.c)
+uint64_t sym_dwarf_u(sym_dwarf_buf_t *b, size_t n);
+uint64_t sym_dwarf_uleb(sym_dwarf_buf_t *b);
+int64_t sym_dwarf_sleb(sym_dwarf_buf_t *b);
+const char *sym_dwarf_str(sym_dwarf_buf_t *b);
+uint64_t sym_dwarf_unit_length(sym_dwarf_buf_t *b, bool *is64);
+int sym_dwarf_form(sym_dwarf_t *dw, sym_dwarf_buf_t *b, unsigned int form,
+    const sym_dwarf_cu_t *cu, sym_dwarf_val_t *val);
+int sym_dwarf_abbrevs(
+    sym_dwarf_t *dw, uint64_t off, sym_dwarf_abbrevs_t *abbrevs);
+sym_dwarf_abbrev_t *sym_dwarf_abbrev_find(
+    sym_dwarf_abbrevs_t *abbrevs, uint64_t code);
+int sym_dwarf_attr_next(sym_dwarf_t *dw, const sym_dwarf_cu_t *cu,
+    sym_dwarf_buf_t *spec, sym_dwarf_buf_t *die, sym_dwarf_attr_t *attr);
+int sym_dwarf_cu_header(sym_dwarf_t *dw, uint64_t off, sym_dwarf_cu_t *cu);
+int sym_dwarf_cu_attrs(
+    sym_dwarf_t *dw, sym_dwarf_cu_t *cu, sym_dwarf_unit_t *unit);
+int sym_dwarf_cu_of_addr(sym_dwarf_t *dw, uint64_t addr, uint64_t *cu_off);
+void sym_dwarf_setup(Elf *elf, const char *path);
+sym_dwarf_t *sym_dwarf_exe(void);
+void sym_dwarf_cleanup(void);
+
+// call frame information (sym_frame.c)
+int sym_frame_cfa_rule(uint64_t pc, uint64_t *reg, int64_t *off);
+void sym_frame_cleanup(void);
+
+// source lines (sym_line.c)
+void sym_line_cleanup(void);
+
+// variables (sym_var.c)
+void sym_var_cleanup(void);
+
+// on-disk symbol cache (sym_cache.c)
+size_t sym_elf_build_id(Elf *elf, unsigned char *buf, size_t len);
+int sym_cache_open(Elf *elf, const char *exe_path, sym_cache_t *cache);
+int sym_cache_store(Elf *elf, const char *exe_path, symbol_t *symtab,
+    unsigned long long va_base);
+void sym_cache_close(sym_cache_t *cache);
+
+// exported names of the loaded objects (sym_gnu.c)
+int sym_gnu_lookup(tracee_t *tracee, unsigned long long bias,
+    unsigned long long ld, const char *name, unsigned long long *addr,
+    unsigned long long *size);
+void sym_gnu_drop(unsigned long long ld);
+void sym_gnu_cleanup(void);
+
+// objects in the dynamic linker's list (sym_link.c)
+int sym_link_update(tracee_t *tracee);
+void sym_link_reset(void);
+
+// shared library symbols (sym_lib.c)
+symbol_t *sym_lib_lookup_addr(tracee_t *tracee, unsigned long long addr);
+int sym_lib_foreach_name(tracee_t *tracee, sym_name_spec_t *q,
+    bool demangled, sym_name_cb cb, void *arg);
+int sym_lib_foreach_match(
+    tracee_t *tracee, sym_name_spec_t *q, sym_name_cb cb, void *arg);
+int sym_lib_preload(tracee_t *tracee);
+int sym_lib_update(tracee_t *tracee);
+void sym_lib_ranges_clear(void);
+int sym_lib_attach(tracee_t *tracee, unsigned long long bias,
+    unsigned long long ld, sym_lib_t **lib, unsigned long long *start);
+void sym_lib_detach(
+    tracee_t *tracee, unsigned long long start, unsigned long long ld);
+void sym_lib_ingest(sym_lib_t **libs, unsigned int count);
+void sym_lib_cleanup(void);
+
 #endif
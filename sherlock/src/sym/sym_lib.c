@@ -0,0 +1,829 @@
+/*
+ * Sherlock - A Minimal Debugger
+ * Part of the Sherlock project
+ *
+ * Copyright (c) 2025-26 Mohammad Shehar Yaar Tausif <sheharyaar48@gmail.com>
+ *
+ * This file is licensed under the MIT License.
+ */
+
+#include "sym_internal.h"
+#include <sherlock/breakpoint.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
+
+/*
+ * Symbols of the shared libraries mapped in the tracee. Only the main
+ * executable is parsed in sym_setup, the libraries are parsed the first time
+ * an address inside them is looked up or a name is not found in the
+ * executable.
+ *
+ * Parsed libraries are cached by (inode, path) for the whole session, so a
+ * library that is unmapped and mapped again (dlclose + dlopen) is not parsed
+ * twice, its symbols are only rebased if it comes back at a different address.
+ *
+ * When attaching, all the libraries mapped at that point are handed to a pool
+ * of worker threads (one per core) which parse them in the background, each
+ * into its own table and index. The prompt does not wait for them; a lookup
+ * that needs a library which is still being parsed waits for that one only,
+ * and a lookup that reaches a library no worker has picked yet parses it
+ * itself.
+ *
+ * The ranges follow the dynamic linker's list of objects (sym_link.c): a dl
+ * event only adds the ranges of the objects that were loaded, hands their
+ * libraries to the pool and drops the ranges of the ones that were unloaded.
+ * Breakpoints in an unloaded library wait for it to come back, they are put
+ * in again at the new addresses of their symbols.
+ * Without a link map (before ld.so ran, static executables) they are rebuilt
+ * from the mappings on the next lookup instead.
+ *
+ * Exported names are looked up in the dynamic linker's hash tables in the
+ * tracee (sym_gnu.c), which costs a few reads instead of the whole symbol
+ * table and gives the same answer whether or not the library is parsed yet.
+ * Only names no library exports (static functions) make the lookup parse
+ * them.
+ */
+
+#define SYM_LIB_MAX_WORKERS 16
+
+// libraries seen so far, keyed by "<inode>:<path>"
+static sym_lib_t *sym_lib_cache = NULL;
+
+// address ranges of the libraries currently mapped, sorted by start
+static sym_lib_range_t *sym_lib_ranges = NULL;
+static unsigned int sym_lib_range_count = 0;
+static unsigned int sym_lib_range_cap = 0;
+
+// set when the mappings may have changed since the last scan
+static bool sym_lib_dirty = true;
+
+// protects lib->state and the worker queue
+static pthread_mutex_t sym_lib_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sym_lib_cond = PTHREAD_COND_INITIALIZER;
+
+static pthread_t sym_lib_workers[SYM_LIB_MAX_WORKERS];
+static unsigned int sym_lib_worker_count = 0;
+// workers still taking libraries from the queue
+static unsigned int sym_lib_busy = 0;
+static sym_lib_t **sym_lib_queue = NULL;
+static unsigned int sym_lib_queue_len = 0;
+static unsigned int sym_lib_queue_cap = 0;
+static unsigned int sym_lib_queue_next = 0;
+static bool sym_lib_stop = false;
+
+// Computes the load bias of the library from the first PT_LOAD segment and
+// the start address of the mapping at file offset 0.
+static unsigned long long sym_lib_bias(Elf *elf, unsigned long long map_start)
+{
+	size_t phnum = 0;
+	if (elf_getphdrnum(elf, &phnum) == -1)
+		return map_start;
+
+	Elf64_Phdr *phdr = elf64_getphdr(elf);
+	if (phdr == NULL)
+		return map_start;
+
+	for (size_t i = 0; i < phnum; i++) {
+		if (phdr[i].p_type != PT_LOAD)
+			continue;
+
+		unsigned long long vaddr = phdr[i].p_vaddr;
+		if (phdr[i].p_align > 1)
+			vaddr -= vaddr % phdr[i].p_align;
+
+		return map_start - vaddr;
+	}
+
+	return map_start;
+}
+
+static int sym_lib_add_syms(
+    sym_lib_t *lib, Elf *elf, Elf_Scn *scn, Elf64_Shdr *hdr)
+{
+	Elf_Data *data = elf_getdata(scn, NULL);
+	if (data == NULL) {
+		pr_err("error in getting symtab data of %s", lib->path);
+		return -1;
+	}
+
+	size_t count = hdr->sh_size / hdr->sh_entsize;
+	if (sym_arena_reserve(&lib->arena, count) == -1) {
+		pr_err("error in reserving symbols of %s", lib->path);
+		return -1;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		GElf_Sym sym;
+		if (gelf_getsym(data, i, &sym) == NULL) {
+			pr_err("error in getting symbol at index %ld of %s", i,
+			    lib->path);
+			return -1;
+		}
+
+		if (GELF_ST_TYPE(sym.st_info) != STT_FUNC ||
+		    sym.st_value == 0 || sym.st_shndx == SHN_UNDEF) {
+			continue;
+		}
+
+		const char *name = elf_strptr(elf, hdr->sh_link, sym.st_name);
+		if (name == NULL || name[0] == '\0') {
+			continue;
+		}
+
+		symbol_t *new_sym = sym_arena_alloc(&lib->arena);
+		if (new_sym == NULL) {
+			pr_err("allocating sym failed");
+			return -1;
+		}
+
+		// the arena hands out zeroed symbols, only set what is known
+		new_sym->base = lib->bias;
+		new_sym->addr = lib->bias + sym.st_value;
+		new_sym->size = sym.st_size;
+		new_sym->name = name;
+		new_sym->file_name = lib->path;
+		HASH_ADD_KEYPTR(hh, lib->symtab, new_sym->name,
+		    strlen(new_sym->name), new_sym);
+	}
+
+	return 0;
+}
+
+// Parses the library's symbol table (.symtab, from the separate debug file when
+// stripped, or .dynsym when there is none) and builds its address index. Only
+// touches 'lib', so several libraries can be loaded at the same time.
+static int sym_lib_load(sym_lib_t *lib)
+{
+	int fd = open(lib->path, O_RDONLY);
+	if (fd == -1) {
+		pr_debug("error in opening %s: %s", lib->path, strerror(errno));
+		return -1;
+	}
+
+	lib->elf = elf_begin(fd, ELF_C_READ_MMAP, NULL);
+	if (lib->elf == NULL || elf_cntl(lib->elf, ELF_C_FDDONE) == -1) {
+		pr_debug("error in elf_begin for %s: %s", lib->path,
+		    elf_errmsg(elf_errno()));
+		goto out;
+	}
+	close(fd);
+	fd = -1;
+
+	Elf64_Ehdr *ehdr = elf64_getehdr(lib->elf);
+	if (ehdr == NULL || ehdr->e_type != ET_DYN) {
+		pr_debug("%s is not a shared object", lib->path);
+		goto out;
+	}
+
+	lib->bias = sym_lib_bias(lib->elf, lib->map_start);
+
+	Elf_Scn *scn = NULL;
+	Elf_Scn *symtab_scn = NULL;
+	Elf64_Shdr *symtab_hdr = NULL;
+	Elf_Scn *dynsym_scn = NULL;
+	Elf64_Shdr *dynsym_hdr = NULL;
+	while ((scn = elf_nextscn(lib->elf, scn)) != NULL) {
+		Elf64_Shdr *hdr = elf64_getshdr(scn);
+		if (hdr == NULL)
+			continue;
+
+		if (hdr->sh_type == SHT_SYMTAB) {
+			symtab_scn = scn;
+			symtab_hdr = hdr;
+		} else if (hdr->sh_type == SHT_DYNSYM) {
+			dynsym_scn = scn;
+			dynsym_hdr = hdr;
+		}
+	}
+
+	// .symtab is a superset of .dynsym, no need to read both
+	Elf *sym_elf = lib->elf;
+	if (symtab_scn == NULL) {
+		lib->dbg = sym_debug_open(lib->elf, lib->path);
+		if (lib->dbg != NULL)
+			symtab_scn = sym_elf_symtab(lib->dbg, &symtab_hdr);
+
+		if (symtab_scn != NULL) {
+			sym_elf = lib->dbg;
+		} else if (lib->dbg != NULL) {
+			elf_end(lib->dbg);
+			lib->dbg = NULL;
+		}
+	}
+
+	if (symtab_scn == NULL) {
+		symtab_scn = dynsym_scn;
+		symtab_hdr = dynsym_hdr;
+	}
+
+	if (symtab_scn == NULL) {
+		pr_debug("no symbols in %s", lib->path);
+		goto out;
+	}
+
+	if (sym_lib_add_syms(lib, sym_elf, symtab_scn, symtab_hdr) == -1)
+		goto out;
+
+	if (sym_index_build(&lib->index, lib->symtab) == -1)
+		goto out;
+
+	pr_debug("loaded %u symbols from %s, bias=%#llx",
+	    HASH_COUNT(lib->symtab), lib->path, lib->bias);
+	return 0;
+
+out:
+	if (fd != -1)
+		close(fd);
+
+	// a failed library keeps nothing, it is not loaded again
+	HASH_CLEAR(hh, lib->symtab);
+	sym_arena_free(&lib->arena);
+	sym_index_free(&lib->index);
+	if (lib->dbg != NULL) {
+		elf_end(lib->dbg);
+		lib->dbg = NULL;
+	}
+	if (lib->elf != NULL) {
+		elf_end(lib->elf);
+		lib->elf = NULL;
+	}
+
+	return -1;
+}
+
+// Claims and loads the library unless someone else already did, waits if it
+// is being loaded by another thread. Returns true if its symbols are usable.
+// Failures are remembered so a library that cannot be read is not retried on
+// every lookup.
+static bool sym_lib_ready(sym_lib_t *lib)
+{
+	pthread_mutex_lock(&sym_lib_lock);
+	while (lib->state == SYM_LIB_LOADING)
+		pthread_cond_wait(&sym_lib_cond, &sym_lib_lock);
+
+	if (lib->state == SYM_LIB_NEW) {
+		lib->state = SYM_LIB_LOADING;
+		pthread_mutex_unlock(&sym_lib_lock);
+
+		int ret = sym_lib_load(lib);
+
+		pthread_mutex_lock(&sym_lib_lock);
+		lib->state = (ret == 0) ? SYM_LIB_LOADED : SYM_LIB_FAILED;
+		pthread_cond_broadcast(&sym_lib_cond);
+	}
+
+	bool ready = (lib->state == SYM_LIB_LOADED);
+	pthread_mutex_unlock(&sym_lib_lock);
+	return ready;
+}
+
+static void *sym_lib_worker(__attribute__((unused)) void *arg)
+{
+	pthread_mutex_lock(&sym_lib_lock);
+	while (!sym_lib_stop && sym_lib_queue_next < sym_lib_queue_len) {
+		sym_lib_t *lib = sym_lib_queue[sym_lib_queue_next++];
+		pthread_mutex_unlock(&sym_lib_lock);
+
+		sym_lib_ready(lib);
+
+		pthread_mutex_lock(&sym_lib_lock);
+	}
+	sym_lib_busy--;
+	pthread_mutex_unlock(&sym_lib_lock);
+	return NULL;
+}
+
+static void sym_lib_workers_join(void)
+{
+	pthread_mutex_lock(&sym_lib_lock);
+	sym_lib_stop = true;
+	pthread_mutex_unlock(&sym_lib_lock);
+
+	for (unsigned int i = 0; i < sym_lib_worker_count; i++)
+		pthread_join(sym_lib_workers[i], NULL);
+
+	sym_lib_worker_count = 0;
+	sym_lib_stop = false;
+	if (sym_lib_queue != NULL) {
+		free(sym_lib_queue);
+		sym_lib_queue = NULL;
+	}
+	sym_lib_queue_len = 0;
+	sym_lib_queue_cap = 0;
+	sym_lib_queue_next = 0;
+}
+
+// Queues libraries for the workers. Running workers pick them up, otherwise
+// the finished ones are joined and new ones started for the queue.
+void sym_lib_ingest(sym_lib_t **libs, unsigned int count)
+{
+	if (count == 0)
+		return;
+
+	pthread_mutex_lock(&sym_lib_lock);
+	if (sym_lib_queue_next == sym_lib_queue_len) {
+		sym_lib_queue_len = 0;
+		sym_lib_queue_next = 0;
+	}
+
+	if (sym_lib_queue_len + count > sym_lib_queue_cap) {
+		unsigned int cap = sym_lib_queue_cap ? sym_lib_queue_cap : 32;
+		while (cap < sym_lib_queue_len + count)
+			cap *= 2;
+
+		sym_lib_t **t =
+		    realloc(sym_lib_queue, cap * sizeof(sym_lib_t *));
+		if (t == NULL) {
+			// they are loaded on demand instead
+			pr_err("error in allocating library queue: %s",
+			    strerror(errno));
+			pthread_mutex_unlock(&sym_lib_lock);
+			return;
+		}
+
+		sym_lib_queue = t;
+		sym_lib_queue_cap = cap;
+	}
+
+	memcpy(&sym_lib_queue[sym_lib_queue_len], libs,
+	    count * sizeof(sym_lib_t *));
+	sym_lib_queue_len += count;
+	unsigned int pending = sym_lib_queue_len - sym_lib_queue_next;
+	bool idle = (sym_lib_busy == 0);
+	pthread_mutex_unlock(&sym_lib_lock);
+
+	if (!idle)
+		return;
+
+	// they have all returned, only their exit status is left
+	for (unsigned int i = 0; i < sym_lib_worker_count; i++)
+		pthread_join(sym_lib_workers[i], NULL);
+	sym_lib_worker_count = 0;
+
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned int workers = (ncpu > 0) ? ncpu : 1;
+	if (workers > SYM_LIB_MAX_WORKERS)
+		workers = SYM_LIB_MAX_WORKERS;
+	if (workers > pending)
+		workers = pending;
+
+	for (unsigned int i = 0; i < workers; i++) {
+		pthread_mutex_lock(&sym_lib_lock);
+		sym_lib_busy++;
+		pthread_mutex_unlock(&sym_lib_lock);
+
+		if (pthread_create(&sym_lib_workers[i], NULL, sym_lib_worker,
+			NULL) != 0) {
+			// the rest of the libraries are loaded on demand
+			pr_warn("could only start %u symbol loader threads", i);
+			pthread_mutex_lock(&sym_lib_lock);
+			sym_lib_busy--;
+			pthread_mutex_unlock(&sym_lib_lock);
+			break;
+		}
+		sym_lib_worker_count++;
+	}
+
+	pr_debug("loading %u libraries with %u threads", pending,
+	    sym_lib_worker_count);
+}
+
+// Moves the symbols of a cached library to its new load address.
+static void sym_lib_rebase(sym_lib_t *lib, unsigned long long bias)
+{
+	unsigned long long delta = bias - lib->bias;
+	symbol_t *sym, *tmp;
+	HASH_ITER(hh, lib->symtab, sym, tmp)
+	{
+		sym->addr += delta;
+		sym->base = bias;
+	}
+
+	// the relative order does not change, shift the index in place
+	for (unsigned int i = 0; i < lib->index.count; i++) {
+		lib->index.ents[i].start += delta;
+		lib->index.ents[i].end += delta;
+		lib->index.ents[i].cover += delta;
+	}
+
+	lib->bias = bias;
+}
+
+static sym_lib_t *sym_lib_get(mem_map_t *map)
+{
+	char key[SHERLOCK_MAX_STRLEN + 32];
+	snprintf(key, sizeof(key), "%lx:%s", map->inode, map->path);
+
+	sym_lib_t *lib = NULL;
+	HASH_FIND_STR(sym_lib_cache, key, lib);
+	if (lib != NULL)
+		return lib;
+
+	lib = calloc(1, sizeof(*lib));
+	if (lib == NULL) {
+		pr_err("error in allocating library: %s", strerror(errno));
+		return NULL;
+	}
+
+	lib->key = strdup(key);
+	if (lib->key == NULL) {
+		pr_err("error in allocating library key: %s", strerror(errno));
+		free(lib);
+		return NULL;
+	}
+
+	lib->path = strchr(lib->key, ':') + 1;
+	lib->inode = map->inode;
+	lib->state = SYM_LIB_NEW;
+	HASH_ADD_KEYPTR(hh, sym_lib_cache, lib->key, strlen(lib->key), lib);
+	return lib;
+}
+
+// Moves a library to the object mapped at 'start', waiting for a worker that
+// may still be computing the bias from the old start.
+static void sym_lib_place(sym_lib_t *lib, unsigned long long start)
+{
+	pthread_mutex_lock(&sym_lib_lock);
+	while (lib->state == SYM_LIB_LOADING)
+		pthread_cond_wait(&sym_lib_cond, &sym_lib_lock);
+
+	if (lib->state == SYM_LIB_LOADED && lib->map_start != start)
+		sym_lib_rebase(lib, lib->bias + (start - lib->map_start));
+
+	symbol_t *sym, *tmp;
+	HASH_ITER(hh, lib->dynsyms, sym, tmp)
+	{
+		sym->addr += start - lib->map_start;
+		sym->base = start;
+	}
+	lib->map_start = start;
+	pthread_mutex_unlock(&sym_lib_lock);
+}
+
+// Index of the first range starting at or after 'start'.
+static unsigned int sym_lib_range_pos(unsigned long long start)
+{
+	unsigned int lo = 0;
+	unsigned int hi = sym_lib_range_count;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (sym_lib_ranges[mid].start < start)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static sym_lib_range_t *sym_lib_range_insert(unsigned long long start)
+{
+	if (sym_lib_range_count == sym_lib_range_cap) {
+		unsigned int cap = sym_lib_range_cap ? sym_lib_range_cap * 2 : 32;
+		sym_lib_range_t *t =
+		    realloc(sym_lib_ranges, cap * sizeof(sym_lib_range_t));
+		if (t == NULL) {
+			pr_err("error in realloc lib ranges: %s",
+			    strerror(errno));
+			return NULL;
+		}
+
+		sym_lib_ranges = t;
+		sym_lib_range_cap = cap;
+	}
+
+	unsigned int pos = sym_lib_range_pos(start);
+	memmove(&sym_lib_ranges[pos + 1], &sym_lib_ranges[pos],
+	    (sym_lib_range_count - pos) * sizeof(sym_lib_range_t));
+	sym_lib_range_count++;
+
+	sym_lib_range_t *r = &sym_lib_ranges[pos];
+	memset(r, 0, sizeof(*r));
+	r->start = start;
+	return r;
+}
+
+void sym_lib_ranges_clear(void) { sym_lib_range_count = 0; }
+
+// Adds the range of the object with _DYNAMIC at 'ld'. Returns 1 and sets
+// 'lib' and 'start' if it is a library, 0 if it is not one (the executable,
+// the vdso) and -1 if it is not in the mappings.
+int sym_lib_attach(tracee_t *tracee, unsigned long long bias,
+    unsigned long long ld, sym_lib_t **lib, unsigned long long *start)
+{
+	unsigned long long end = 0;
+	mem_map_t *map = sym_proc_object_maps(ld, &end);
+	if (map == NULL)
+		return (sym_proc_addr_map(ld, 1) != NULL) ? 0 : -1;
+
+	if (map->path[0] != '/' || strcmp(map->path, tracee->exe_path) == 0)
+		return 0;
+
+	sym_lib_t *l = sym_lib_get(map);
+	if (l == NULL)
+		return -1;
+
+	sym_lib_place(l, map->start);
+
+	sym_lib_range_t *r = sym_lib_range_insert(map->start);
+	if (r == NULL)
+		return -1;
+
+	r->end = end;
+	r->bias = bias;
+	r->ld = ld;
+	r->lib = l;
+
+	*lib = l;
+	*start = map->start;
+	return 1;
+}
+
+void sym_lib_detach(
+    tracee_t *tracee, unsigned long long start, unsigned long long ld)
+{
+	unsigned int pos = sym_lib_range_pos(start);
+	if (pos < sym_lib_range_count && sym_lib_ranges[pos].start == start) {
+		// the text is gone, and so are the breakpoints in it
+		breakpoint_unload(tracee, start, sym_lib_ranges[pos].end);
+		memmove(&sym_lib_ranges[pos], &sym_lib_ranges[pos + 1],
+		    (sym_lib_range_count - pos - 1) * sizeof(sym_lib_range_t));
+		sym_lib_range_count--;
+	}
+
+	sym_gnu_drop(ld);
+}
+
+static int sym_lib_scan_map(mem_map_t *map, void *arg)
+{
+	tracee_t *tracee = arg;
+
+	// pseudo maps ([heap], [vdso], ...) and the executable itself
+	if (map->path[0] != '/' || map->inode == 0 ||
+	    strcmp(map->path, tracee->exe_path) == 0) {
+		return 0;
+	}
+
+	// mappings of the same object are contiguous, extend the last range
+	if (sym_lib_range_count > 0) {
+		sym_lib_range_t *last = &sym_lib_ranges[sym_lib_range_count - 1];
+		if (last->lib->inode == map->inode &&
+		    strcmp(last->lib->path, map->path) == 0) {
+			last->end = map->end;
+			return 0;
+		}
+	}
+
+	// only the mapping at offset 0 marks the start of an object
+	if (map->offset != 0)
+		return 0;
+
+	sym_lib_t *lib = sym_lib_get(map);
+	if (lib == NULL)
+		return -1;
+
+	sym_lib_place(lib, map->start);
+
+	sym_lib_range_t *r = sym_lib_range_insert(map->start);
+	if (r == NULL)
+		return -1;
+
+	r->end = map->end;
+	r->lib = lib;
+	return 0;
+}
+
+// Brings the ranges up to date if they may have changed: from the link map
+// when there is one, else by walking the mappings of the tracee (refreshed on
+// every dl event) again. Libraries already in the cache are reused, new ones
+// are only registered here, their symbols are parsed by the workers or on
+// first use.
+static int sym_lib_scan(tracee_t *tracee)
+{
+	if (!sym_lib_dirty)
+		return 0;
+
+	if (sym_link_update(tracee) == 0) {
+		sym_lib_dirty = false;
+		return 0;
+	}
+
+	sym_link_reset();
+	sym_lib_range_count = 0;
+	if (sym_proc_map_foreach(sym_lib_scan_map, tracee) == -1) {
+		pr_err("error in scanning the tracee libraries");
+		sym_lib_range_count = 0;
+		return -1;
+	}
+
+	sym_lib_dirty = false;
+	pr_debug("%u libraries mapped", sym_lib_range_count);
+	return 0;
+}
+
+int sym_lib_update(tracee_t *tracee)
+{
+	// without a link map the mappings are scanned on the next lookup
+	if (sym_link_update(tracee) == -1) {
+		sym_link_reset();
+		sym_lib_dirty = true;
+		return -1;
+	}
+
+	sym_lib_dirty = false;
+	return 0;
+}
+
+int sym_lib_preload(tracee_t *tracee)
+{
+	if (sym_lib_scan(tracee) == -1)
+		return -1;
+
+	// the link map walk queued what it found already
+	if (sym_lib_range_count == 0 || sym_lib_ranges[0].ld != 0)
+		return 0;
+
+	sym_lib_t **libs = calloc(sym_lib_range_count, sizeof(sym_lib_t *));
+	if (libs == NULL) {
+		pr_err("error in allocating library queue: %s",
+		    strerror(errno));
+		return -1;
+	}
+
+	for (unsigned int i = 0; i < sym_lib_range_count; i++)
+		libs[i] = sym_lib_ranges[i].lib;
+
+	sym_lib_ingest(libs, sym_lib_range_count);
+	free(libs);
+	return 0;
+}
+
+symbol_t *sym_lib_lookup_addr(tracee_t *tracee, unsigned long long addr)
+{
+	if (sym_lib_scan(tracee) == -1)
+		return NULL;
+
+	sym_lib_range_t *r = NULL;
+	SYM_RANGE_FIND(sym_lib_ranges, sym_lib_range_count, addr, 0, r);
+	if (r == NULL || !sym_lib_ready(r->lib))
+		return NULL;
+
+	return sym_index_lookup(&r->lib->index, addr);
+}
+
+// Looks 'name' up in the exported functions of a library that is not parsed,
+// the symbol is kept so the same one is handed out the next time.
+static int sym_lib_dynsym(tracee_t *tracee, sym_lib_range_t *r,
+    const char *name, sym_name_cb cb, void *arg)
+{
+	sym_lib_t *lib = r->lib;
+	symbol_t *sym = NULL;
+	HASH_FIND_STR(lib->dynsyms, name, sym);
+	if (sym == NULL) {
+		unsigned long long addr = 0;
+		unsigned long long size = 0;
+		if (sym_gnu_lookup(tracee, r->bias, r->ld, name, &addr,
+			&size) != 1) {
+			return 0;
+		}
+
+		sym = calloc(1, sizeof(*sym));
+		char *copy = strdup(name);
+		if (sym == NULL || copy == NULL) {
+			pr_err("error in allocating symbol: %s",
+			    strerror(errno));
+			free(sym);
+			free(copy);
+			return -1;
+		}
+
+		sym->base = r->start;
+		sym->addr = addr;
+		sym->size = size;
+		sym->name = copy;
+		sym->file_name = lib->path;
+		HASH_ADD_KEYPTR(hh, lib->dynsyms, sym->name, strlen(sym->name),
+		    sym);
+	}
+
+	return (cb(tracee, sym, arg) == -1) ? -1 : 1;
+}
+
+int sym_lib_foreach_name(tracee_t *tracee, sym_name_spec_t *q,
+    bool demangled, sym_name_cb cb, void *arg)
+{
+	if (sym_lib_scan(tracee) == -1)
+		return -1;
+
+	// exported functions first, asked through the link map so the answer
+	// does not depend on which libraries the workers parsed already; a file
+	// qualifier needs the symbol table
+	for (unsigned int i = 0;
+	    !demangled && q->file == NULL && i < sym_lib_range_count; i++) {
+		sym_lib_range_t *r = &sym_lib_ranges[i];
+		sym_lib_t *lib = r->lib;
+		if (r->ld == 0)
+			continue;
+
+		if (q->lib != NULL &&
+		    !sym_name_match_file(lib->path, q->lib, true)) {
+			continue;
+		}
+
+		int found = sym_lib_dynsym(tracee, r, q->name, cb, arg);
+		if (found != 0)
+			return found;
+	}
+
+	// libraries are searched in load order, like the dynamic linker does
+	// for the global scope; each one is only parsed when reached and the
+	// search stops at the first one defining the name
+	for (unsigned int i = 0; i < sym_lib_range_count; i++) {
+		sym_lib_t *lib = sym_lib_ranges[i].lib;
+		if (q->lib != NULL &&
+		    !sym_name_match_file(lib->path, q->lib, true)) {
+			continue;
+		}
+
+		if (!sym_lib_ready(lib))
+			continue;
+
+		int found = demangled
+		    ? sym_demangle_index_foreach(
+			  &lib->names, lib->symtab, q, tracee, cb, arg)
+		    : sym_name_index_foreach(
+			  &lib->names, lib->symtab, q, tracee, cb, arg);
+		if (found != 0)
+			return found;
+	}
+
+	return 0;
+}
+
+int sym_lib_foreach_match(
+    tracee_t *tracee, sym_name_spec_t *q, sym_name_cb cb, void *arg)
+{
+	if (sym_lib_scan(tracee) == -1)
+		return -1;
+
+	int found = 0;
+	for (unsigned int i = 0; i < sym_lib_range_count; i++) {
+		sym_lib_t *lib = sym_lib_ranges[i].lib;
+		if (!sym_name_match_file(lib->path, q->lib, true))
+			continue;
+
+		if (!sym_lib_ready(lib))
+			continue;
+
+		int n = sym_name_index_match(
+		    &lib->names, lib->symtab, q, tracee, cb, arg);
+		if (n == -1)
+			return -1;
+		found += n;
+	}
+
+	return found;
+}
+
+void sym_lib_cleanup(void)
+{
+	sym_lib_workers_join();
+
+	sym_lib_t *lib, *tmp;
+	HASH_ITER(hh, sym_lib_cache, lib, tmp)
+	{
+		HASH_DEL(sym_lib_cache, lib);
+		HASH_CLEAR(hh, lib->symtab);
+		sym_arena_free(&lib->arena);
+		sym_index_free(&lib->index);
+		sym_name_index_free(&lib->names);
+
+		symbol_t *sym, *sym_tmp;
+		HASH_ITER(hh, lib->dynsyms, sym, sym_tmp)
+		{
+			HASH_DEL(lib->dynsyms, sym);
+			free((char *)sym->name);
+			free(sym);
+		}
+
+		if (lib->dbg != NULL)
+			elf_end(lib->dbg);
+		if (lib->elf != NULL)
+			elf_end(lib->elf);
+
+		free(lib->key);
+		free(lib);
+	}
+
+	if (sym_lib_ranges != NULL) {
+		free(sym_lib_ranges);
+		sym_lib_ranges = NULL;
+	}
+
+	sym_lib_range_count = 0;
+	sym_lib_range_cap = 0;
+	sym_lib_dirty = true;
+	sym_link_reset();
+}
@@ -0,0 +1,933 @@
+/*
+ * Sherlock - A Minimal Debugger
+ * Part of the Sherlock project
+ *
+ * Copyright (c) 2025-26 Mohammad Shehar Yaar Tausif <sheharyaar48@gmail.com>
+ *
+ * This file is licensed under the MIT License.
+ */
+
+#include "sym_internal.h"
+#include <stdio.h>
+#include <sys/ptrace.h>
+#include <sys/user.h>
+
+/*
+ * Source lines of the executable, from .debug_line (of the executable or its
+ * separate debug file).
+ *
+ * Nothing is decoded up front. The first query only walks the unit lengths of
+ * .debug_line to know where every line table starts. A line table is decoded
+ * when a query needs it, into a flat array of rows sorted by address, so an
+ * address lookup is a binary search:
+ *
+ *   addr -> unit   the unit address ranges (sym_dwarf_cu_of_addr) give the
+ *                  compilation unit, its DW_AT_stmt_list the line table. If
+ *                  there are no ranges at all the tables are decoded in order
+ *                  until one covers addr.
+ *   file -> units  only the headers (directory and file tables) are read to
+ *                  find the tables that mention the file, only those are
+ *                  decoded.
+ *
+ * Decoded tables are kept for the session.
+ */
+
+#define SYM_LINE_STMT 0x1
+#define SYM_LINE_END 0x2
+
+// standard opcodes
+#define SYM_DW_LNS_copy 1
+#define SYM_DW_LNS_advance_pc 2
+#define SYM_DW_LNS_advance_line 3
+#define SYM_DW_LNS_set_file 4
+#define SYM_DW_LNS_set_column 5
+#define SYM_DW_LNS_negate_stmt 6
+#define SYM_DW_LNS_set_basic_block 7
+#define SYM_DW_LNS_const_add_pc 8
+#define SYM_DW_LNS_fixed_advance_pc 9
+#define SYM_DW_LNS_set_prologue_end 10
+#define SYM_DW_LNS_set_epilogue_begin 11
+#define SYM_DW_LNS_set_isa 12
+// extended opcodes
+#define SYM_DW_LNE_end_sequence 1
+#define SYM_DW_LNE_set_address 2
+// DWARF 5 entry formats
+#define SYM_DW_LNCT_path 1
+#define SYM_DW_LNCT_directory_index 2
+
+typedef struct SYM_LINE_ROW {
+	uint64_t addr;
+	uint32_t line;
+	uint16_t file;
+	uint8_t flags;
+} sym_line_row_t;
+
+typedef struct SYM_LINE_FILE {
+	const char *name;
+	uint32_t dir;
+} sym_line_file_t;
+
+typedef struct SYM_LINE_SEQ {
+	uint64_t start;
+	unsigned int first;
+	unsigned int count;
+} sym_line_seq_t;
+
+typedef struct SYM_LINE_UNIT {
+	// [off, end) in .debug_line
+	uint64_t off;
+	uint64_t end;
+	bool header;
+	bool decoded;
+	bool failed;
+
+	// header
+	const unsigned char *prog;
+	const unsigned char *std_lens;
+	uint16_t version;
+	uint8_t min_inst;
+	uint8_t default_is_stmt;
+	int8_t line_base;
+	uint8_t line_range;
+	uint8_t opcode_base;
+	const char *comp_dir;
+	const char **dirs;
+	unsigned int dir_count;
+	sym_line_file_t *files;
+	unsigned int file_count;
+
+	// decoded rows, sorted by address
+	sym_line_row_t *rows;
+	unsigned int row_count;
+	uint64_t lo;
+	uint64_t hi;
+} sym_line_unit_t;
+
+// compilation unit -> line table, memoized
+typedef struct SYM_LINE_CU {
+	uint64_t cu_off;
+	// index in sym_line_units, -1 if unknown
+	int unit;
+	UT_hash_handle hh;
+} sym_line_cu_t;
+
+typedef struct SYM_LINE_CAND {
+	uint64_t addr;
+	unsigned int unit;
+	unsigned int row;
+} sym_line_cand_t;
+
+// 0 not loaded yet, 1 loaded, -1 no line tables
+static int sym_line_state = 0;
+static sym_dwarf_t *sym_line_dw = NULL;
+static sym_line_unit_t *sym_line_units = NULL;
+static unsigned int sym_line_unit_count = 0;
+static sym_line_cu_t *sym_line_cus = NULL;
+
+static int sym_line_load(void)
+{
+	if (sym_line_state != 0)
+		return (sym_line_state == 1) ? 0 : -1;
+
+	sym_line_state = -1;
+	sym_line_dw = sym_dwarf_exe();
+	if (sym_line_dw == NULL || sym_line_dw->line.buf == NULL) {
+		pr_debug("no line tables");
+		return -1;
+	}
+
+	// only the unit lengths, the headers are read on demand
+	unsigned int cap = 0;
+	sym_dwarf_buf_t b = { sym_line_dw->line.buf,
+		sym_line_dw->line.buf + sym_line_dw->line.size, false };
+	while (b.p < b.end) {
+		uint64_t off = b.p - sym_line_dw->line.buf;
+		bool is64;
+		uint64_t len = sym_dwarf_unit_length(&b, &is64);
+		if (b.err || len > (uint64_t)(b.end - b.p)) {
+			pr_debug("truncated line table at %#lx", off);
+			break;
+		}
+
+		if (sym_line_unit_count == cap) {
+			cap = cap ? cap * 2 : 64;
+			sym_line_unit_t *t =
+			    realloc(sym_line_units, cap * sizeof(*t));
+			if (t == NULL) {
+				pr_err("error in allocating line tables: %s",
+				    strerror(errno));
+				return -1;
+			}
+			sym_line_units = t;
+		}
+
+		sym_line_unit_t *unit = &sym_line_units[sym_line_unit_count++];
+		memset(unit, 0, sizeof(*unit));
+		unit->off = off;
+		b.p += len;
+		unit->end = b.p - sym_line_dw->line.buf;
+	}
+
+	pr_debug("%u line tables", sym_line_unit_count);
+	sym_line_state = 1;
+	return 0;
+}
+
+// Reads a DWARF 5 directory or file table, 'dirs' picks which one is filled.
+static int sym_line_entries(sym_line_unit_t *unit, sym_dwarf_buf_t *b,
+    const sym_dwarf_cu_t *ctx, bool dirs)
+{
+	uint8_t nfmt = sym_dwarf_u(b, 1);
+	uint64_t fmt[16][2];
+	if (nfmt > 16)
+		return -1;
+
+	for (unsigned int i = 0; i < nfmt; i++) {
+		fmt[i][0] = sym_dwarf_uleb(b);
+		fmt[i][1] = sym_dwarf_uleb(b);
+	}
+
+	uint64_t count = sym_dwarf_uleb(b);
+	if (b->err || count > (uint64_t)(b->end - b->p))
+		return -1;
+
+	void *arr = calloc(count ? count : 1,
+	    dirs ? sizeof(*unit->dirs) : sizeof(*unit->files));
+	if (arr == NULL) {
+		pr_err("error in allocating line table: %s", strerror(errno));
+		return -1;
+	}
+
+	if (dirs) {
+		unit->dirs = arr;
+		unit->dir_count = count;
+	} else {
+		unit->files = arr;
+		unit->file_count = count;
+	}
+
+	for (uint64_t n = 0; n < count; n++) {
+		for (unsigned int i = 0; i < nfmt; i++) {
+			sym_dwarf_val_t val;
+			if (sym_dwarf_form(sym_line_dw, b, fmt[i][1], ctx,
+				&val) == -1) {
+				return -1;
+			}
+
+			if (fmt[i][0] == SYM_DW_LNCT_path && dirs)
+				unit->dirs[n] = val.str;
+			else if (fmt[i][0] == SYM_DW_LNCT_path)
+				unit->files[n].name = val.str;
+			else if (fmt[i][0] == SYM_DW_LNCT_directory_index &&
+			    !dirs)
+				unit->files[n].dir = val.u;
+		}
+	}
+
+	return 0;
+}
+
+// Reads the directory and file tables of DWARF 2-4, which are lists of
+// strings ended by an empty one. Index 0 is the compilation directory (for
+// directories) or unused (for files), as in the line program.
+static int sym_line_entries_v4(sym_line_unit_t *unit, sym_dwarf_buf_t *b)
+{
+	const unsigned char *start = b->p;
+	unsigned int count = 1;
+	while (b->p < b->end && *b->p != '\0') {
+		sym_dwarf_str(b);
+		count++;
+	}
+	sym_dwarf_u(b, 1);
+
+	unit->dirs = calloc(count, sizeof(*unit->dirs));
+	if (unit->dirs == NULL) {
+		pr_err("error in allocating line table: %s", strerror(errno));
+		return -1;
+	}
+
+	unit->dir_count = count;
+	b->p = start;
+	for (unsigned int i = 1; i < count; i++)
+		unit->dirs[i] = sym_dwarf_str(b);
+	sym_dwarf_u(b, 1);
+
+	start = b->p;
+	count = 1;
+	while (b->p < b->end && *b->p != '\0') {
+		sym_dwarf_str(b);
+		sym_dwarf_uleb(b);
+		sym_dwarf_uleb(b);
+		sym_dwarf_uleb(b);
+		count++;
+	}
+
+	unit->files = calloc(count, sizeof(*unit->files));
+	if (unit->files == NULL) {
+		pr_err("error in allocating line table: %s", strerror(errno));
+		return -1;
+	}
+
+	unit->file_count = count;
+	b->p = start;
+	for (unsigned int i = 1; i < count; i++) {
+		unit->files[i].name = sym_dwarf_str(b);
+		unit->files[i].dir = sym_dwarf_uleb(b);
+		sym_dwarf_uleb(b);
+		sym_dwarf_uleb(b);
+	}
+
+	return b->err ? -1 : 0;
+}
+
+static int sym_line_header(sym_line_unit_t *unit)
+{
+	if (unit->header)
+		return 0;
+	if (unit->failed)
+		return -1;
+
+	unit->failed = true;
+	sym_dwarf_buf_t b = { sym_line_dw->line.buf + unit->off,
+		sym_line_dw->line.buf + unit->end, false };
+
+	sym_dwarf_cu_t ctx = { 0 };
+	sym_dwarf_unit_length(&b, &ctx.is64);
+	unit->version = sym_dwarf_u(&b, 2);
+	ctx.version = unit->version;
+	ctx.addr_size = 8;
+	if (unit->version < 2 || unit->version > 5) {
+		pr_debug("unsupported line table version %u", unit->version);
+		return -1;
+	}
+
+	if (unit->version >= 5) {
+		ctx.addr_size = sym_dwarf_u(&b, 1);
+		sym_dwarf_u(&b, 1); // segment selector size
+	}
+
+	uint64_t hdr_len = sym_dwarf_u(&b, ctx.is64 ? 8 : 4);
+	if (b.err || hdr_len > (uint64_t)(b.end - b.p))
+		return -1;
+
+	unit->prog = b.p + hdr_len;
+	unit->min_inst = sym_dwarf_u(&b, 1);
+	if (unit->version >= 4)
+		sym_dwarf_u(&b, 1); // max ops per instruction, VLIW only
+	unit->default_is_stmt = sym_dwarf_u(&b, 1);
+	unit->line_base = (int8_t)sym_dwarf_u(&b, 1);
+	unit->line_range = sym_dwarf_u(&b, 1);
+	unit->opcode_base = sym_dwarf_u(&b, 1);
+	unit->std_lens = b.p;
+	if (unit->opcode_base > 0)
+		sym_dwarf_u(&b, unit->opcode_base - 1);
+
+	if (b.err || unit->line_range == 0 || unit->opcode_base == 0)
+		return -1;
+
+	if (unit->version >= 5) {
+		if (sym_line_entries(unit, &b, &ctx, true) == -1 ||
+		    sym_line_entries(unit, &b, &ctx, false) == -1) {
+			return -1;
+		}
+	} else if (sym_line_entries_v4(unit, &b) == -1) {
+		return -1;
+	}
+
+	if (unit->dir_count > 0 && unit->dirs[0] == NULL)
+		unit->dirs[0] = unit->comp_dir;
+
+	unit->header = true;
+	unit->failed = false;
+	return 0;
+}
+
+// Builds the path of a file of the unit into 'buf', relative directories are
+// relative to the compilation directory.
+static void sym_line_file_path(
+    sym_line_unit_t *unit, unsigned int idx, char *buf, size_t len)
+{
+	buf[0] = '\0';
+	if (idx >= unit->file_count || unit->files[idx].name == NULL)
+		return;
+
+	sym_line_file_t *f = &unit->files[idx];
+	if (f->name[0] == '/' || f->dir >= unit->dir_count ||
+	    unit->dirs[f->dir] == NULL) {
+		snprintf(buf, len, "%s", f->name);
+		return;
+	}
+
+	const char *dir = unit->dirs[f->dir];
+	const char *comp = (unit->dir_count > 0) ? unit->dirs[0] : NULL;
+	if (dir[0] != '/' && f->dir != 0 && comp != NULL)
+		snprintf(buf, len, "%s/%s/%s", comp, dir, f->name);
+	else
+		snprintf(buf, len, "%s/%s", dir, f->name);
+}
+
+// A file matches by its base name, or by a path suffix if 'file' has a '/'.
+static bool sym_line_file_match(
+    sym_line_unit_t *unit, unsigned int idx, const char *file)
+{
+	const char *name = unit->files[idx].name;
+	if (name == NULL)
+		return false;
+
+	if (strchr(file, '/') == NULL) {
+		const char *base = strrchr(name, '/');
+		return strcmp(base ? base + 1 : name, file) == 0;
+	}
+
+	char path[SHERLOCK_MAX_STRLEN * 2];
+	sym_line_file_path(unit, idx, path, sizeof(path));
+	size_t plen = strlen(path);
+	size_t flen = strlen(file);
+	if (flen > plen)
+		return false;
+
+	return strcmp(path + plen - flen, file) == 0 &&
+	    (flen == plen || file[0] == '/' || path[plen - flen - 1] == '/');
+}
+
+static int sym_line_seq_cmp(const void *a, const void *b)
+{
+	const sym_line_seq_t *x = a;
+	const sym_line_seq_t *y = b;
+
+	if (x->start != y->start)
+		return (x->start < y->start) ? -1 : 1;
+
+	return 0;
+}
+
+// Sorts the sequences of a decoded table by address. The rows inside a
+// sequence are already in address order.
+static int sym_line_sort(sym_line_unit_t *unit, sym_line_row_t *rows,
+    unsigned int count, sym_line_seq_t *seqs, unsigned int seq_count)
+{
+	qsort(seqs, seq_count, sizeof(*seqs), sym_line_seq_cmp);
+
+	unit->rows = malloc((count ? count : 1) * sizeof(*rows));
+	if (unit->rows == NULL) {
+		pr_err("error in allocating line rows: %s", strerror(errno));
+		return -1;
+	}
+
+	unsigned int n = 0;
+	unit->lo = ~0ULL;
+	unit->hi = 0;
+	for (unsigned int i = 0; i < seq_count; i++) {
+		memcpy(&unit->rows[n], &rows[seqs[i].first],
+		    seqs[i].count * sizeof(*rows));
+		n += seqs[i].count;
+
+		uint64_t end = unit->rows[n - 1].addr;
+		if (seqs[i].start < unit->lo)
+			unit->lo = seqs[i].start;
+		if (end > unit->hi)
+			unit->hi = end;
+	}
+
+	unit->row_count = n;
+	return 0;
+}
+
+static int sym_line_decode(sym_line_unit_t *unit)
+{
+	if (unit->decoded)
+		return 0;
+	if (sym_line_header(unit) == -1)
+		return -1;
+
+	sym_line_row_t *rows = NULL;
+	unsigned int count = 0;
+	unsigned int cap = 0;
+	sym_line_seq_t *seqs = NULL;
+	unsigned int seq_count = 0;
+	unsigned int seq_cap = 0;
+	int ret = -1;
+
+	sym_dwarf_buf_t b = { unit->prog, sym_line_dw->line.buf + unit->end,
+		false };
+	uint64_t addr = 0;
+	uint32_t file = 1;
+	int64_t line = 1;
+	bool is_stmt = unit->default_is_stmt;
+	unsigned int seq_first = 0;
+
+	while (b.p < b.end && !b.err) {
+		uint8_t op = *b.p++;
+		bool emit = false;
+		bool end_seq = false;
+
+		if (op >= unit->opcode_base) {
+			// special opcode, advances both and adds a row
+			unsigned int adj = op - unit->opcode_base;
+			addr += (adj / unit->line_range) * unit->min_inst;
+			line += unit->line_base + (int)(adj % unit->line_range);
+			emit = true;
+		} else if (op == 0) {
+			uint64_t len = sym_dwarf_uleb(&b);
+			if (b.err || len == 0 || len > (uint64_t)(b.end - b.p))
+				break;
+
+			const unsigned char *next = b.p + len;
+			uint8_t sub = *b.p++;
+			if (sub == SYM_DW_LNE_end_sequence) {
+				emit = true;
+				end_seq = true;
+			} else if (sub == SYM_DW_LNE_set_address) {
+				addr = sym_dwarf_u(&b, len - 1);
+			}
+			b.p = next;
+		} else {
+			switch (op) {
+			case SYM_DW_LNS_copy:
+				emit = true;
+				break;
+			case SYM_DW_LNS_advance_pc:
+				addr += sym_dwarf_uleb(&b) * unit->min_inst;
+				break;
+			case SYM_DW_LNS_advance_line:
+				line += sym_dwarf_sleb(&b);
+				break;
+			case SYM_DW_LNS_set_file:
+				file = sym_dwarf_uleb(&b);
+				break;
+			case SYM_DW_LNS_negate_stmt:
+				is_stmt = !is_stmt;
+				break;
+			case SYM_DW_LNS_const_add_pc:
+				addr += ((255 - unit->opcode_base) /
+					    unit->line_range) *
+				    unit->min_inst;
+				break;
+			case SYM_DW_LNS_fixed_advance_pc:
+				addr += sym_dwarf_u(&b, 2);
+				break;
+			case SYM_DW_LNS_set_basic_block:
+			case SYM_DW_LNS_set_prologue_end:
+			case SYM_DW_LNS_set_epilogue_begin:
+				break;
+			default:
+				// set_column, set_isa and unknown ones, skip
+				// their operands
+				for (uint8_t i = 0; i < unit->std_lens[op - 1];
+				    i++) {
+					sym_dwarf_uleb(&b);
+				}
+				break;
+			}
+		}
+
+		if (!emit)
+			continue;
+
+		if (count == cap) {
+			cap = cap ? cap * 2 : 256;
+			sym_line_row_t *t = realloc(rows, cap * sizeof(*t));
+			if (t == NULL) {
+				pr_err("error in allocating line rows: %s",
+				    strerror(errno));
+				goto out;
+			}
+			rows = t;
+		}
+
+		rows[count].addr = addr;
+		rows[count].line = (line > 0) ? (uint32_t)line : 0;
+		rows[count].file = (file <= UINT16_MAX) ? file : 0;
+		rows[count].flags =
+		    (is_stmt ? SYM_LINE_STMT : 0) | (end_seq ? SYM_LINE_END : 0);
+		count++;
+
+		if (!end_seq)
+			continue;
+
+		// code discarded by the linker keeps its line table with the
+		// address set to 0 (or -1), drop it
+		uint64_t start = rows[seq_first].addr;
+		if (start == 0 || start == ~0ULL || count - seq_first < 2) {
+			count = seq_first;
+		} else {
+			if (seq_count == seq_cap) {
+				seq_cap = seq_cap ? seq_cap * 2 : 16;
+				sym_line_seq_t *t =
+				    realloc(seqs, seq_cap * sizeof(*t));
+				if (t == NULL) {
+					pr_err("error in allocating line "
+					       "sequences: %s",
+					    strerror(errno));
+					goto out;
+				}
+				seqs = t;
+			}
+
+			seqs[seq_count].start = start;
+			seqs[seq_count].first = seq_first;
+			seqs[seq_count].count = count - seq_first;
+			seq_count++;
+		}
+
+		seq_first = count;
+		addr = 0;
+		file = 1;
+		line = 1;
+		is_stmt = unit->default_is_stmt;
+	}
+
+	// rows after the last end_sequence do not form a sequence, dropped
+	if (sym_line_sort(unit, rows, seq_first, seqs, seq_count) == -1)
+		goto out;
+
+	unit->decoded = true;
+	pr_debug("line table at %#lx: %u rows over %#lx-%#lx", unit->off,
+	    unit->row_count, unit->lo, unit->hi);
+	ret = 0;
+
+out:
+	free(rows);
+	free(seqs);
+	if (ret == -1)
+		unit->failed = true;
+	return ret;
+}
+
+// Returns the row covering 'addr' (link time address) or NULL.
+static sym_line_row_t *sym_line_unit_find(
+    sym_line_unit_t *unit, uint64_t addr)
+{
+	if (unit->row_count == 0 || addr < unit->lo || addr >= unit->hi)
+		return NULL;
+
+	// last row with row.addr <= addr
+	unsigned int lo = 0;
+	unsigned int hi = unit->row_count;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (unit->rows[mid].addr <= addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo == 0 || (unit->rows[lo - 1].flags & SYM_LINE_END))
+		return NULL;
+
+	return &unit->rows[lo - 1];
+}
+
+// Finds the line table of the compilation unit at 'cu_off' in .debug_info.
+static int sym_line_unit_of_cu(uint64_t cu_off)
+{
+	sym_dwarf_cu_t cu = { 0 };
+	sym_dwarf_unit_t attrs;
+	if (sym_dwarf_cu_header(sym_line_dw, cu_off, &cu) == -1 ||
+	    sym_dwarf_cu_attrs(sym_line_dw, &cu, &attrs) == -1) {
+		return -1;
+	}
+
+	uint64_t stmt_list = attrs.stmt_list;
+
+	unsigned int lo = 0;
+	unsigned int hi = sym_line_unit_count;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (sym_line_units[mid].off < stmt_list)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo == sym_line_unit_count || sym_line_units[lo].off != stmt_list)
+		return -1;
+
+	// DWARF 4 line tables do not name the compilation directory
+	if (!sym_line_units[lo].header)
+		sym_line_units[lo].comp_dir = attrs.comp_dir;
+
+	return lo;
+}
+
+static sym_line_row_t *sym_line_find(uint64_t addr, sym_line_unit_t **res)
+{
+	uint64_t cu_off;
+	if (sym_dwarf_cu_of_addr(sym_line_dw, addr, &cu_off) == 0) {
+		sym_line_cu_t *cu = NULL;
+		HASH_FIND(hh, sym_line_cus, &cu_off, sizeof(cu_off), cu);
+		if (cu == NULL) {
+			cu = calloc(1, sizeof(*cu));
+			if (cu == NULL) {
+				pr_err("error in allocating unit entry: %s",
+				    strerror(errno));
+				return NULL;
+			}
+			cu->cu_off = cu_off;
+			cu->unit = sym_line_unit_of_cu(cu_off);
+			HASH_ADD(hh, sym_line_cus, cu_off, sizeof(cu->cu_off), cu);
+		}
+		if (cu->unit < 0)
+			return NULL;
+
+		sym_line_unit_t *unit = &sym_line_units[cu->unit];
+		if (sym_line_decode(unit) == -1)
+			return NULL;
+
+		*res = unit;
+		return sym_line_unit_find(unit, addr);
+	}
+
+	if (sym_line_dw->range_count > 0)
+		return NULL;
+
+	// no unit ranges, decode the tables until one covers addr
+	for (unsigned int i = 0; i < sym_line_unit_count; i++) {
+		sym_line_unit_t *unit = &sym_line_units[i];
+		if (sym_line_decode(unit) == -1)
+			continue;
+
+		sym_line_row_t *row = sym_line_unit_find(unit, addr);
+		if (row != NULL) {
+			*res = unit;
+			return row;
+		}
+	}
+
+	return NULL;
+}
+
+int sym_line_lookup_addr(
+    tracee_t *tracee, unsigned long long addr, sym_line_t *loc)
+{
+	if (addr < tracee->va_base || sym_line_load() == -1)
+		return -1;
+
+	sym_line_unit_t *unit = NULL;
+	sym_line_row_t *row = sym_line_find(addr - tracee->va_base, &unit);
+	if (row == NULL)
+		return -1;
+
+	loc->addr = row->addr + tracee->va_base;
+	loc->line = row->line;
+	sym_line_file_path(unit, row->file, loc->file, sizeof(loc->file));
+	return 0;
+}
+
+// The file 'break line' refers to, the one of the current location or, before
+// the program is running, the one of main.
+static int sym_line_default_file(tracee_t *tracee, char *buf, size_t len)
+{
+	sym_line_t loc;
+	struct user_regs_struct regs;
+	if (ptrace(PTRACE_GETREGS, tracee->pid, NULL, &regs) == 0 &&
+	    sym_line_lookup_addr(tracee, regs.rip, &loc) == 0) {
+		snprintf(buf, len, "%s", loc.file);
+		return 0;
+	}
+
+	symbol_t *sym = sym_lookup_name(tracee, "main");
+	if (sym != NULL && sym_line_lookup_addr(tracee, sym->addr, &loc) == 0) {
+		snprintf(buf, len, "%s", loc.file);
+		return 0;
+	}
+
+	return -1;
+}
+
+static int sym_line_cand_cmp(const void *a, const void *b)
+{
+	const sym_line_cand_t *x = a;
+	const sym_line_cand_t *y = b;
+
+	if (x->addr != y->addr)
+		return (x->addr < y->addr) ? -1 : 1;
+
+	return 0;
+}
+
+// Adds the rows where 'line' (or the first line after it with code) of 'file'
+// starts to 'cands', keeping only the ones for the best line seen so far.
+static int sym_line_collect(sym_line_unit_t *unit, unsigned int unit_idx,
+    const char *file, unsigned int line, unsigned int *best,
+    sym_line_cand_t **cands, unsigned int *count, unsigned int *cap)
+{
+	if (sym_line_header(unit) == -1)
+		return 0;
+
+	bool *match = calloc(unit->file_count ? unit->file_count : 1, 1);
+	if (match == NULL) {
+		pr_err("error in allocating file match: %s", strerror(errno));
+		return -1;
+	}
+
+	bool any = false;
+	for (unsigned int i = 0; i < unit->file_count; i++) {
+		match[i] = sym_line_file_match(unit, i, file);
+		any |= match[i];
+	}
+
+	if (!any || sym_line_decode(unit) == -1) {
+		free(match);
+		return 0;
+	}
+
+	for (unsigned int i = 0; i < unit->row_count; i++) {
+		sym_line_row_t *row = &unit->rows[i];
+		if (row->file >= unit->file_count || !match[row->file] ||
+		    row->line < line || row->line > *best ||
+		    !(row->flags & SYM_LINE_STMT) ||
+		    (row->flags & SYM_LINE_END)) {
+			continue;
+		}
+
+		// only where the line starts, not every row it spans
+		sym_line_row_t *prev = (i > 0) ? &unit->rows[i - 1] : NULL;
+		if (prev != NULL && !(prev->flags & SYM_LINE_END) &&
+		    prev->file == row->file && prev->line == row->line) {
+			continue;
+		}
+
+		if (row->line < *best) {
+			*best = row->line;
+			*count = 0;
+		}
+
+		if (*count == *cap) {
+			*cap = *cap ? *cap * 2 : 16;
+			sym_line_cand_t *t = realloc(*cands, *cap * sizeof(*t));
+			if (t == NULL) {
+				pr_err("error in allocating line matches: %s",
+				    strerror(errno));
+				free(match);
+				return -1;
+			}
+			*cands = t;
+		}
+
+		(*cands)[*count].addr = row->addr;
+		(*cands)[*count].unit = unit_idx;
+		(*cands)[*count].row = i;
+		(*count)++;
+	}
+
+	free(match);
+	return 0;
+}
+
+// Calls 'cb' for every location of a source line, 'spec' is <file>:<line> or
+// just <line> for the current file. Like GDB, a line without code resolves to
+// the next one that has some, and a line spanning several blocks of a function
+// (loops) only gets its first address. Returns the number of locations.
+int sym_foreach_line(tracee_t *tracee, char *spec, sym_line_cb cb, void *arg)
+{
+	if (spec == NULL || spec[0] == '\0') {
+		pr_debug("invalid spec to sym_foreach_line");
+		return -1;
+	}
+
+	char file[SHERLOCK_MAX_STRLEN];
+	const char *num = spec;
+	char *colon = strrchr(spec, ':');
+	if (colon != NULL) {
+		if (colon == spec || (size_t)(colon - spec) >= sizeof(file)) {
+			pr_err("invalid location '%s'", spec);
+			return -1;
+		}
+
+		memcpy(file, spec, colon - spec);
+		file[colon - spec] = '\0';
+		num = colon + 1;
+	}
+
+	char *endp = NULL;
+	errno = 0;
+	unsigned long line = strtoul(num, &endp, 10);
+	if (errno != 0 || endp == num || *endp != '\0' || line == 0 ||
+	    line > UINT32_MAX) {
+		pr_err("invalid line number '%s'", num);
+		return -1;
+	}
+
+	if (sym_line_load() == -1) {
+		pr_info_raw("No line information, was the program built "
+			    "with -g?\n");
+		return -1;
+	}
+
+	if (colon == NULL &&
+	    sym_line_default_file(tracee, file, sizeof(file)) == -1) {
+		pr_err("no default source file, use <file>:<line>");
+		return -1;
+	}
+
+	sym_line_cand_t *cands = NULL;
+	unsigned int count = 0;
+	unsigned int cap = 0;
+	unsigned int best = UINT32_MAX;
+	for (unsigned int i = 0; i < sym_line_unit_count; i++) {
+		if (sym_line_collect(&sym_line_units[i], i, file, line, &best,
+			&cands, &count, &cap) == -1) {
+			free(cands);
+			return -1;
+		}
+	}
+
+	qsort(cands, count, sizeof(*cands), sym_line_cand_cmp);
+
+	int found = 0;
+	symbol_t *last = NULL;
+	for (unsigned int i = 0; i < count; i++) {
+		if (i > 0 && cands[i].addr == cands[i - 1].addr)
+			continue;
+
+		sym_line_t loc;
+		loc.addr = cands[i].addr + tracee->va_base;
+
+		// one location per function, the lowest address
+		symbol_t *sym = sym_lookup_addr(tracee, loc.addr);
+		if (sym != NULL && sym == last)
+			continue;
+		last = sym;
+
+		sym_line_unit_t *unit = &sym_line_units[cands[i].unit];
+		sym_line_row_t *row = &unit->rows[cands[i].row];
+		loc.line = row->line;
+		sym_line_file_path(unit, row->file, loc.file, sizeof(loc.file));
+
+		found++;
+		int ret = cb(tracee, &loc, arg);
+		if (ret == -1) {
+			found = -1;
+			break;
+		}
+		if (ret == 1)
+			break;
+	}
+
+	free(cands);
+	return found;
+}
+
+void sym_line_cleanup(void)
+{
+	for (unsigned int i = 0; i < sym_line_unit_count; i++) {
+		free(sym_line_units[i].dirs);
+		free(sym_line_units[i].files);
+		free(sym_line_units[i].rows);
+	}
+
+	free(sym_line_units);
+	sym_line_units = NULL;
+	sym_line_unit_count = 0;
+
+	sym_line_cu_t *cu, *tmp;
+	HASH_ITER(hh, sym_line_cus, cu, tmp)
+	{
+		HASH_DEL(sym_line_cus, cu);
+		free(cu);
+	}
+
+	sym_line_state = 0;
+	sym_line_dw = NULL;
+}
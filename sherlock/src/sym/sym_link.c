@@ -0,0 +1,210 @@
+/*
+ * Sherlock - A Minimal Debugger
+ * Part of the Sherlock project
+ *
+ * Copyright (c) 2025-26 Mohammad Shehar Yaar Tausif <sheharyaar48@gmail.com>
+ *
+ * This file is licensed under the MIT License.
+ */
+
+#define _GNU_SOURCE
+#include "sym_internal.h"
+#include <sherlock/breakpoint.h>
+#include <link.h>
+
+/*
+ * The objects loaded in the tracee, as the dynamic linker lists them in
+ * r_debug.r_map. Every node seen is kept, keyed by its address, with the load
+ * bias and _DYNAMIC it had. On a dl event (r_state back to RT_CONSISTENT) the
+ * list is walked again, one read per node, and compared with the known set:
+ *
+ *   a node that is known with the same bias and _DYNAMIC is only marked seen
+ *   a new node (or a node reused for another object) becomes a library range,
+ *   its symbols are handed to the loader threads
+ *   a known node that was not seen was unloaded, its range is dropped along
+ *   with the breakpoints in it, which come back when the library does
+ *
+ * so a dlopen or dlclose only costs the walk plus the work for the objects
+ * that changed, not a rescan of every library. When r_debug cannot be read
+ * (before ld.so filled DT_DEBUG, static executables) the libraries are found
+ * from the mappings instead (sym_lib.c).
+ */
+
+// a corrupted list could loop forever
+#define SYM_LINK_MAX_OBJS 65536
+
+typedef struct SYM_LINK_OBJ {
+	unsigned long long lm;
+	unsigned long long bias;
+	unsigned long long ld;
+	// start of the library range, 0 for objects that are not libraries
+	// (the executable, the vdso)
+	unsigned long long start;
+	unsigned int gen;
+	UT_hash_handle hh;
+} sym_link_obj_t;
+
+static sym_link_obj_t *sym_link_objs = NULL;
+static unsigned int sym_link_gen = 0;
+// set while the library ranges come from the link map
+static bool sym_link_active = false;
+
+// libraries attached by the last walk, handed to the loader threads
+static sym_lib_t **sym_link_added = NULL;
+static unsigned int sym_link_added_cap = 0;
+
+static void sym_link_drop(tracee_t *tracee, sym_link_obj_t *obj)
+{
+	if (obj->start != 0)
+		sym_lib_detach(tracee, obj->start, obj->ld);
+
+	HASH_DEL(sym_link_objs, obj);
+	free(obj);
+}
+
+static int sym_link_add(tracee_t *tracee, unsigned long long lm,
+    struct link_map *node, unsigned int *added)
+{
+	sym_lib_t *lib = NULL;
+	unsigned long long start = 0;
+	int ret = sym_lib_attach(tracee, node->l_addr,
+	    (unsigned long long)node->l_ld, &lib, &start);
+	if (ret == -1) {
+		// not mapped yet as of the last refresh, retried next time
+		return 0;
+	}
+
+	sym_link_obj_t *obj = calloc(1, sizeof(*obj));
+	if (obj == NULL) {
+		pr_err("error in allocating link map object: %s",
+		    strerror(errno));
+		if (start != 0)
+			sym_lib_detach(
+			    tracee, start, (unsigned long long)node->l_ld);
+		return -1;
+	}
+
+	obj->lm = lm;
+	obj->bias = node->l_addr;
+	obj->ld = (unsigned long long)node->l_ld;
+	obj->start = start;
+	obj->gen = sym_link_gen;
+	HASH_ADD(hh, sym_link_objs, lm, sizeof(obj->lm), obj);
+
+	if (lib == NULL)
+		return 0;
+
+	if (*added == sym_link_added_cap) {
+		unsigned int cap =
+		    sym_link_added_cap ? sym_link_added_cap * 2 : 32;
+		sym_lib_t **t =
+		    realloc(sym_link_added, cap * sizeof(sym_lib_t *));
+		if (t == NULL) {
+			// the library is still parsed on first use
+			pr_err("error in allocating added libraries: %s",
+			    strerror(errno));
+			return 0;
+		}
+
+		sym_link_added = t;
+		sym_link_added_cap = cap;
+	}
+
+	sym_link_added[(*added)++] = lib;
+	return 0;
+}
+
+// Puts back the breakpoints of the libraries that were loaded again, once the
+// unloaded ones are out (a library can come back where it was), and hands the
+// new libraries to the loader threads.
+static void sym_link_finish(tracee_t *tracee, unsigned int added)
+{
+	for (unsigned int i = 0; i < added; i++) {
+		if (breakpoint_reload(tracee, sym_link_added[i]->path) == -1)
+			pr_warn("error in reloading the breakpoints of %s",
+			    sym_link_added[i]->path);
+	}
+
+	sym_lib_ingest(sym_link_added, added);
+}
+
+int sym_link_update(tracee_t *tracee)
+{
+	// before ld.so filled DT_DEBUG r_debug_addr is the DT_DEBUG slot
+	if (tracee->debug.need_watch || tracee->debug.r_debug_addr == 0)
+		return -1;
+
+	struct r_debug rdb;
+	if (sym_mem_read(tracee->pid, tracee->debug.r_debug_addr, &rdb,
+		sizeof(rdb)) == -1) {
+		return -1;
+	}
+
+	// the ranges found from the mappings are replaced as a whole once
+	if (!sym_link_active) {
+		sym_lib_ranges_clear();
+		sym_link_active = true;
+	}
+
+	sym_link_gen++;
+	unsigned int added = 0;
+	unsigned int count = 0;
+	unsigned long long lm = (unsigned long long)rdb.r_map;
+	for (; lm != 0 && count < SYM_LINK_MAX_OBJS; count++) {
+		struct link_map node;
+		if (sym_mem_read(tracee->pid, lm, &node, sizeof(node)) == -1)
+			goto err;
+
+		sym_link_obj_t *obj = NULL;
+		HASH_FIND(hh, sym_link_objs, &lm, sizeof(lm), obj);
+		unsigned long long ld = (unsigned long long)node.l_ld;
+		if (obj != NULL && (obj->bias != node.l_addr || obj->ld != ld)) {
+			// freed by dlclose and reused by a later dlopen
+			sym_link_drop(tracee, obj);
+			obj = NULL;
+		}
+
+		if (obj != NULL)
+			obj->gen = sym_link_gen;
+		else if (sym_link_add(tracee, lm, &node, &added) == -1)
+			goto err;
+
+		lm = (unsigned long long)node.l_next;
+	}
+
+	unsigned int removed = 0;
+	sym_link_obj_t *obj, *tmp;
+	HASH_ITER(hh, sym_link_objs, obj, tmp)
+	{
+		if (obj->gen != sym_link_gen) {
+			sym_link_drop(tracee, obj);
+			removed++;
+		}
+	}
+
+	pr_debug("link map: %u objects, %u added, %u removed", count, added,
+	    removed);
+	sym_link_finish(tracee, added);
+	return 0;
+
+err:
+	sym_link_finish(tracee, added);
+	return -1;
+}
+
+void sym_link_reset(void)
+{
+	sym_link_obj_t *obj, *tmp;
+	HASH_ITER(hh, sym_link_objs, obj, tmp)
+	{
+		HASH_DEL(sym_link_objs, obj);
+		free(obj);
+	}
+
+	sym_gnu_cleanup();
+	sym_link_active = false;
+
+	free(sym_link_added);
+	sym_link_added = NULL;
+	sym_link_added_cap = 0;
+}
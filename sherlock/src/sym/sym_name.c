@@ -0,0 +1,473 @@
+/*
+ * Sherlock - A Minimal Debugger
+ * Part of the Sherlock project
+ *
+ * Copyright (c) 2025-26 Mohammad Shehar Yaar Tausif <sheharyaar48@gmail.com>
+ *
+ * This file is licensed under the MIT License.
+ */
+
+#include "sym_internal.h"
+#include <fnmatch.h>
+#include <regex.h>
+
+/*
+ * Name index for the symbol table. The uthash keyed by name keeps duplicates
+ * (static functions with the same name in different translation units) but
+ * HASH_FIND only returns one of them. The index keeps one entry per distinct
+ * name pointing at a contiguous run of all its definitions, so finding every
+ * definition is one hash probe and a scan of the run.
+ *
+ * It is built on the first name lookup, in two passes over the symbols that
+ * reuse the hash values uthash already computed: count the definitions per
+ * name, then place them. Within a run global definitions come first, then
+ * the local ones, then the dynamic (PLT/GOT) ones.
+ *
+ * Names can be qualified:
+ *   file:name  - definitions from that source file (STT_FILE) or object
+ *   name@lib   - definitions from that library (or the executable)
+ * In patterns a ':' or '@' inside a bracket expression ([[:alpha:]]) or
+ * escaped with a backslash is part of the pattern.
+ *
+ * For pattern lookups (a regex like ^mempool_.* or a glob like *_alloc) the
+ * distinct names are also sorted, on first use. The literal prefix of the
+ * pattern, if any, narrows the scan to a range found by binary search, the
+ * matcher only runs on the names in that range.
+ *
+ * C++ names are also found by their demangled form, see sym_demangle.c.
+ */
+
+#define SYM_REGEX_META ".[]()*+?{}|^$\\"
+#define SYM_GLOB_META "*?[\\"
+
+static int sym_name_rank(symbol_t *sym)
+{
+	if (sym->dyn_sym)
+		return 2;
+
+	// locals carry the STT_FILE name, globals the path of their mapping
+	if (sym->map == NULL || sym->file_name != sym->map->path)
+		return 1;
+
+	return 0;
+}
+
+static int sym_name_cmp(const void *a, const void *b)
+{
+	symbol_t *x = *(symbol_t **)a;
+	symbol_t *y = *(symbol_t **)b;
+
+	int rx = sym_name_rank(x);
+	int ry = sym_name_rank(y);
+	if (rx != ry)
+		return rx - ry;
+
+	if (x->addr != y->addr)
+		return (x->addr < y->addr) ? -1 : 1;
+
+	return 0;
+}
+
+int sym_name_index_build(sym_name_index_t *idx, symbol_t *symtab)
+{
+	unsigned int count = HASH_COUNT(symtab);
+	if (count == 0) {
+		idx->built = true;
+		return 0;
+	}
+
+	idx->ents = calloc(count, sizeof(sym_name_ent_t));
+	idx->syms = calloc(count, sizeof(symbol_t *));
+	if (idx->ents == NULL || idx->syms == NULL) {
+		pr_err("error in allocating name index: %s", strerror(errno));
+		sym_name_index_free(idx);
+		return -1;
+	}
+
+	// count the definitions of every name
+	unsigned int n = 0;
+	symbol_t *sym, *tmp;
+	HASH_ITER(hh, symtab, sym, tmp)
+	{
+		sym_name_ent_t *ent = NULL;
+		HASH_FIND_BYHASHVALUE(hh, idx->hash, sym->name, sym->hh.keylen,
+		    sym->hh.hashv, ent);
+		if (ent == NULL) {
+			ent = &idx->ents[n++];
+			ent->name = sym->name;
+			HASH_ADD_KEYPTR_BYHASHVALUE(hh, idx->hash, ent->name,
+			    sym->hh.keylen, sym->hh.hashv, ent);
+			if (strncmp(ent->name, "_Z", 2) == 0)
+				idx->mangled++;
+		}
+		ent->count++;
+	}
+
+	unsigned int first = 0;
+	for (unsigned int i = 0; i < n; i++) {
+		idx->ents[i].first = first;
+		first += idx->ents[i].count;
+		idx->ents[i].count = 0;
+	}
+
+	// place them, count is the fill cursor of every run
+	HASH_ITER(hh, symtab, sym, tmp)
+	{
+		sym_name_ent_t *ent = NULL;
+		HASH_FIND_BYHASHVALUE(hh, idx->hash, sym->name, sym->hh.keylen,
+		    sym->hh.hashv, ent);
+		idx->syms[ent->first + ent->count++] = sym;
+	}
+
+	for (unsigned int i = 0; i < n; i++) {
+		if (idx->ents[i].count > 1) {
+			qsort(&idx->syms[idx->ents[i].first], idx->ents[i].count,
+			    sizeof(symbol_t *), sym_name_cmp);
+		}
+	}
+
+	idx->count = n;
+	idx->built = true;
+	pr_debug("name index built with %u names (%u C++) for %u symbols", n,
+	    idx->mangled, count);
+	return 0;
+}
+
+// Matches 'path' against a file or object qualifier, either the whole path or
+// its last component. For objects, "libc" also matches "libc.so.6".
+bool sym_name_match_file(const char *path, const char *file, bool object)
+{
+	if (path == NULL)
+		return false;
+
+	if (strcmp(path, file) == 0)
+		return true;
+
+	const char *base = strrchr(path, '/');
+	base = (base != NULL) ? base + 1 : path;
+
+	size_t len = strlen(file);
+	if (strncmp(base, file, len) != 0)
+		return false;
+
+	if (base[len] == '\0')
+		return true;
+
+	return object && (base[len] == '.' || base[len] == '-');
+}
+
+// Returns the ']' closing the bracket expression that starts at 'p', NULL if
+// it is not closed. A leading ']' is part of the set, and so is anything in
+// [:class:], [.coll.] and [=equiv=].
+static char *sym_name_bracket_end(char *p)
+{
+	p++;
+	if (*p == '^' || *p == '!')
+		p++;
+	if (*p == ']')
+		p++;
+
+	while (*p != '\0' && *p != ']') {
+		if (p[0] == '[' && p[1] != '\0' && strchr(":.=", p[1])) {
+			char delim[3] = { p[1], ']', '\0' };
+			char *end = strstr(p + 2, delim);
+			if (end == NULL)
+				return NULL;
+
+			p = end + 2;
+			continue;
+		}
+		p++;
+	}
+
+	return (*p == ']') ? p : NULL;
+}
+
+int sym_name_parse(const char *spec, sym_name_spec_t *q, bool pattern)
+{
+	if (strlen(spec) >= sizeof(q->buf)) {
+		pr_err("symbol name too long");
+		return -1;
+	}
+
+	strcpy(q->buf, spec);
+	q->name = q->buf;
+	q->file = NULL;
+	q->lib = NULL;
+
+	// the last '@' separates the library, a single ':' before it the file
+	// ('::' is part of a C++ name); in a pattern neither counts inside a
+	// bracket expression or after a backslash
+	char *at = NULL;
+	char *colon = NULL;
+	for (char *p = q->buf; *p != '\0'; p++) {
+		if (pattern && p[0] == '\\' && p[1] != '\0') {
+			p++;
+		} else if (pattern && p[0] == '[') {
+			p = sym_name_bracket_end(p);
+			if (p == NULL)
+				break;
+		} else if (p[0] == '@') {
+			at = p;
+		} else if (p[0] == ':' && p[1] == ':') {
+			p++;
+		} else if (p[0] == ':' && colon == NULL) {
+			colon = p;
+		}
+	}
+
+	if (at != NULL && at != q->buf && at[1] != '\0') {
+		*at = '\0';
+		q->lib = at + 1;
+	} else {
+		at = NULL;
+	}
+
+	if (colon != NULL && (at == NULL || colon < at) && colon != q->buf &&
+	    colon[1] != '\0' && colon + 1 != at) {
+		*colon = '\0';
+		q->file = q->buf;
+		q->name = colon + 1;
+	}
+
+	return 0;
+}
+
+// Calls 'cb' for the definitions in the run of 'ent', only those from the file
+// of the qualifier if there is one. Returns how many there were or -1 on error,
+// 'stop' is set when the callback asks to stop.
+int sym_name_ent_foreach(sym_name_index_t *idx, sym_name_ent_t *ent,
+    sym_name_spec_t *q, tracee_t *tracee, sym_name_cb cb, void *arg,
+    bool *stop)
+{
+	int found = 0;
+	for (unsigned int i = 0; i < ent->count; i++) {
+		symbol_t *sym = idx->syms[ent->first + i];
+		if (q->file != NULL &&
+		    !sym_name_match_file(sym->file_name, q->file, false)) {
+			continue;
+		}
+
+		found++;
+		int ret = cb(tracee, sym, arg);
+		if (ret == -1)
+			return -1;
+		if (ret == 1) {
+			*stop = true;
+			break;
+		}
+	}
+
+	return found;
+}
+
+int sym_name_index_foreach(sym_name_index_t *idx, symbol_t *symtab,
+    sym_name_spec_t *q, tracee_t *tracee, sym_name_cb cb, void *arg)
+{
+	if (!idx->built && sym_name_index_build(idx, symtab) == -1)
+		return -1;
+
+	sym_name_ent_t *ent = NULL;
+	HASH_FIND_STR(idx->hash, q->name, ent);
+	if (ent == NULL)
+		return 0;
+
+	bool stop = false;
+	return sym_name_ent_foreach(idx, ent, q, tracee, cb, arg, &stop);
+}
+
+static int sym_name_sorted_cmp(const void *a, const void *b)
+{
+	const sym_name_ent_t *x = *(sym_name_ent_t **)a;
+	const sym_name_ent_t *y = *(sym_name_ent_t **)b;
+	return strcmp(x->name, y->name);
+}
+
+static int sym_name_sort(sym_name_index_t *idx)
+{
+	idx->sorted = calloc(idx->count ? idx->count : 1, sizeof(*idx->sorted));
+	if (idx->sorted == NULL) {
+		pr_err("error in allocating sorted names: %s", strerror(errno));
+		return -1;
+	}
+
+	for (unsigned int i = 0; i < idx->count; i++)
+		idx->sorted[i] = &idx->ents[i];
+
+	qsort(idx->sorted, idx->count, sizeof(*idx->sorted),
+	    sym_name_sorted_cmp);
+	return 0;
+}
+
+// A pattern is a regex if it uses anything that is not glob syntax, like the
+// ^ anchor or '.'.
+static bool sym_pattern_is_regex(const char *pattern)
+{
+	return strpbrk(pattern, "^$.+(|{\\") != NULL;
+}
+
+// Copies the literal prefix every match of the pattern has to start with into
+// 'buf'. Unanchored regexes have none, globs are always anchored.
+static void sym_pattern_prefix(
+    const char *pattern, bool regex, char *buf, size_t len)
+{
+	size_t n = 0;
+	buf[0] = '\0';
+
+	if (regex) {
+		// with alternation the other branches can start with anything
+		if (pattern[0] != '^' || strchr(pattern, '|') != NULL)
+			return;
+		pattern++;
+	}
+
+	const char *meta = regex ? SYM_REGEX_META : SYM_GLOB_META;
+	while (pattern[n] != '\0' && n + 1 < len &&
+	    strchr(meta, pattern[n]) == NULL) {
+		buf[n] = pattern[n];
+		n++;
+	}
+
+	// in a regex a quantifier applies to the last literal
+	if (regex && n > 0 && pattern[n] != '\0' &&
+	    strchr("*?{", pattern[n]) != NULL) {
+		n--;
+	}
+
+	buf[n] = '\0';
+}
+
+// 're' is the compiled pattern for regexes, NULL for globs
+static bool sym_pattern_match(
+    const char *pattern, regex_t *re, const char *name)
+{
+	if (re != NULL)
+		return regexec(re, name, 0, NULL, 0) == 0;
+
+	return fnmatch(pattern, name, 0) == 0;
+}
+
+int sym_name_index_match(sym_name_index_t *idx, symbol_t *symtab,
+    sym_name_spec_t *q, tracee_t *tracee, sym_name_cb cb, void *arg)
+{
+	if (!idx->built && sym_name_index_build(idx, symtab) == -1)
+		return -1;
+
+	if (idx->sorted == NULL && sym_name_sort(idx) == -1)
+		return -1;
+
+	bool regex = sym_pattern_is_regex(q->name);
+	regex_t re;
+	if (regex) {
+		int err = regcomp(&re, q->name, REG_EXTENDED | REG_NOSUB);
+		if (err != 0) {
+			char msg[128];
+			regerror(err, &re, msg, sizeof(msg));
+			pr_err("invalid pattern '%s': %s", q->name, msg);
+			return -1;
+		}
+	}
+
+	char prefix[SHERLOCK_MAX_STRLEN];
+	sym_pattern_prefix(q->name, regex, prefix, sizeof(prefix));
+	size_t plen = strlen(prefix);
+
+	// first name >= prefix
+	unsigned int lo = 0;
+	unsigned int hi = idx->count;
+	while (plen > 0 && lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (strcmp(idx->sorted[mid]->name, prefix) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	int found = 0;
+	bool stop = false;
+	for (unsigned int i = lo; i < idx->count && !stop; i++) {
+		sym_name_ent_t *ent = idx->sorted[i];
+		if (plen > 0 && strncmp(ent->name, prefix, plen) != 0)
+			break;
+
+		if (!sym_pattern_match(q->name, regex ? &re : NULL, ent->name))
+			continue;
+
+		int n = sym_name_ent_foreach(
+		    idx, ent, q, tracee, cb, arg, &stop);
+		if (n == -1) {
+			found = -1;
+			goto out;
+		}
+		found += n;
+	}
+
+	if (stop || idx->mangled == 0)
+		goto out;
+
+	// C++ names also match by their demangled form, with or without the
+	// parameters; the ones whose mangled name matched are already done
+	if (sym_demangle_index_build(idx) == -1) {
+		found = -1;
+		goto out;
+	}
+
+	// no demangler
+	if (idx->demangled == NULL)
+		goto out;
+
+	for (unsigned int i = 0; i < idx->count && !stop; i++) {
+		sym_name_ent_t *ent = &idx->ents[i];
+		const char *dm = idx->demangled[i];
+		if (dm == NULL ||
+		    sym_pattern_match(q->name, regex ? &re : NULL, ent->name)) {
+			continue;
+		}
+
+		size_t len;
+		const char *base = sym_demangle_base(dm, &len);
+		char buf[SHERLOCK_MAX_STRLEN];
+		snprintf(buf, sizeof(buf), "%.*s", (int)len, base);
+		if (!sym_pattern_match(q->name, regex ? &re : NULL, dm) &&
+		    !sym_pattern_match(q->name, regex ? &re : NULL, buf)) {
+			continue;
+		}
+
+		int n = sym_name_ent_foreach(
+		    idx, ent, q, tracee, cb, arg, &stop);
+		if (n == -1) {
+			found = -1;
+			goto out;
+		}
+		found += n;
+	}
+
+out:
+	if (regex)
+		regfree(&re);
+	return found;
+}
+
+void sym_name_index_free(sym_name_index_t *idx)
+{
+	sym_demangle_index_free(idx);
+	HASH_CLEAR(hh, idx->hash);
+	if (idx->ents != NULL) {
+		free(idx->ents);
+		idx->ents = NULL;
+	}
+
+	if (idx->syms != NULL) {
+		free(idx->syms);
+		idx->syms = NULL;
+	}
+
+	if (idx->sorted != NULL) {
+		free(idx->sorted);
+		idx->sorted = NULL;
+	}
+
+	idx->count = 0;
+	idx->mangled = 0;
+	idx->built = false;
+}
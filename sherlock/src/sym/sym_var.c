@@ -0,0 +1,1308 @@
+/*
+ * Sherlock - A Minimal Debugger
+ * Part of the Sherlock project
+ *
+ * Copyright (c) 2025-26 Mohammad Shehar Yaar Tausif <sheharyaar48@gmail.com>
+ *
+ * This file is licensed under the MIT License.
+ */
+
+#include "sym_internal.h"
+#include <libunwind-ptrace.h>
+#include <sys/ptrace.h>
+#include <sys/user.h>
+
+/*
+ * Variables of the executable, from .debug_info.
+ *
+ * The DIE tree of a compilation unit is only parsed when a lookup needs it:
+ * the unit of the current pc for the locals, the others (in order) when a
+ * global is not found there. A parsed unit is kept for the session as a flat
+ * array of the few attributes the printer uses, in offset order, so a type
+ * reference is a binary search and a second print of anything in the unit
+ * does not touch the DWARF again.
+ *
+ *   scope    the subprograms and lexical blocks containing pc, innermost
+ *            first, then the unit itself, then the other units
+ *   location DWARF expressions on a stack (no location lists, which -O0 does
+ *            not use), the frame base is usually DW_OP_call_frame_cfa which
+ *            comes from libunwind
+ *   value    base types, pointers (char * as strings), arrays, structs,
+ *            unions, enums and the typedef/const/volatile wrappers
+ *
+ * Only the innermost frame is looked at.
+ */
+
+#define SYM_DW_TAG_array_type 0x01
+#define SYM_DW_TAG_class_type 0x02
+#define SYM_DW_TAG_enumeration_type 0x04
+#define SYM_DW_TAG_formal_parameter 0x05
+#define SYM_DW_TAG_lexical_block 0x0b
+#define SYM_DW_TAG_member 0x0d
+#define SYM_DW_TAG_pointer_type 0x0f
+#define SYM_DW_TAG_reference_type 0x10
+#define SYM_DW_TAG_structure_type 0x13
+#define SYM_DW_TAG_subroutine_type 0x15
+#define SYM_DW_TAG_typedef 0x16
+#define SYM_DW_TAG_union_type 0x17
+#define SYM_DW_TAG_subrange_type 0x21
+#define SYM_DW_TAG_base_type 0x24
+#define SYM_DW_TAG_const_type 0x26
+#define SYM_DW_TAG_enumerator 0x28
+#define SYM_DW_TAG_subprogram 0x2e
+#define SYM_DW_TAG_variable 0x34
+#define SYM_DW_TAG_volatile_type 0x35
+#define SYM_DW_TAG_restrict_type 0x37
+#define SYM_DW_TAG_rvalue_reference_type 0x42
+#define SYM_DW_TAG_atomic_type 0x47
+
+#define SYM_DW_AT_bit_size 0x0d
+
+#define SYM_DW_ATE_boolean 0x02
+#define SYM_DW_ATE_float 0x04
+#define SYM_DW_ATE_signed 0x05
+#define SYM_DW_ATE_signed_char 0x06
+#define SYM_DW_ATE_unsigned_char 0x08
+#define SYM_DW_ATE_UTF 0x10
+
+#define SYM_DW_OP_addr 0x03
+#define SYM_DW_OP_deref 0x06
+#define SYM_DW_OP_const1u 0x08
+#define SYM_DW_OP_const1s 0x09
+#define SYM_DW_OP_const2u 0x0a
+#define SYM_DW_OP_const2s 0x0b
+#define SYM_DW_OP_const4u 0x0c
+#define SYM_DW_OP_const4s 0x0d
+#define SYM_DW_OP_const8u 0x0e
+#define SYM_DW_OP_const8s 0x0f
+#define SYM_DW_OP_constu 0x10
+#define SYM_DW_OP_consts 0x11
+#define SYM_DW_OP_dup 0x12
+#define SYM_DW_OP_drop 0x13
+#define SYM_DW_OP_minus 0x1c
+#define SYM_DW_OP_plus 0x22
+#define SYM_DW_OP_plus_uconst 0x23
+#define SYM_DW_OP_lit0 0x30
+#define SYM_DW_OP_lit31 0x4f
+#define SYM_DW_OP_reg0 0x50
+#define SYM_DW_OP_reg31 0x6f
+#define SYM_DW_OP_breg0 0x70
+#define SYM_DW_OP_breg31 0x8f
+#define SYM_DW_OP_regx 0x90
+#define SYM_DW_OP_fbreg 0x91
+#define SYM_DW_OP_bregx 0x92
+#define SYM_DW_OP_call_frame_cfa 0x9c
+#define SYM_DW_OP_stack_value 0x9f
+#define SYM_DW_OP_addrx 0xa1
+#define SYM_DW_OP_GNU_addr_index 0xfb
+
+// DIE flags
+#define SYM_VAR_CHILDREN 0x01
+#define SYM_VAR_HAS_SIZE 0x02
+#define SYM_VAR_HAS_VALUE 0x04
+#define SYM_VAR_DECL 0x08
+#define SYM_VAR_LOCLIST 0x10
+#define SYM_VAR_BITFIELD 0x20
+
+// deepest DIE nesting parsed
+#define SYM_VAR_DEPTH 64
+#define SYM_VAR_STACK 64
+// largest object read, and the caps of what is printed
+#define SYM_VAR_MAX_SIZE (1 << 16)
+#define SYM_VAR_MAX_ELEMS 200
+#define SYM_VAR_MAX_STR 200
+#define SYM_VAR_MAX_NEST 8
+
+typedef struct SYM_VAR_DIE {
+	uint64_t off;
+	// DW_AT_type and DW_AT_specification/abstract_origin, as offsets in
+	// .debug_info
+	uint64_t type;
+	uint64_t origin;
+	uint64_t low_pc;
+	uint64_t high_pc;
+	// DW_AT_byte_size, or the element count of a subrange
+	uint64_t size;
+	// DW_AT_const_value, or the offset of a member
+	int64_t value;
+	const char *name;
+	const unsigned char *loc;
+	const unsigned char *frame_base;
+	uint32_t loc_len;
+	uint32_t frame_base_len;
+	// indexes in the unit, 'next' is 0 for the last child
+	uint32_t parent;
+	uint32_t next;
+	uint16_t tag;
+	uint8_t encoding;
+	uint8_t flags;
+} sym_var_die_t;
+
+typedef struct SYM_VAR_CU {
+	uint64_t off;
+	sym_dwarf_cu_t cu;
+	sym_var_die_t *dies;
+	unsigned int count;
+	bool failed;
+	UT_hash_handle hh;
+} sym_var_cu_t;
+
+// where a location expression puts the variable
+typedef enum {
+	SYM_VAR_LOC_MEM,
+	SYM_VAR_LOC_REG,
+	SYM_VAR_LOC_VALUE,
+} sym_var_loc_e;
+
+typedef struct SYM_VAR_FRAME {
+	tracee_t *tracee;
+	sym_dwarf_t *dw;
+	struct user_regs_struct regs;
+	sym_var_cu_t *cu;
+	// innermost subprogram, for DW_OP_fbreg
+	sym_var_die_t *func;
+	uint64_t cfa;
+	bool cfa_read;
+} sym_var_frame_t;
+
+static sym_var_cu_t *sym_var_cus = NULL;
+// offsets of all the units, for the global lookup and references across units
+static uint64_t *sym_var_units = NULL;
+static unsigned int sym_var_unit_count = 0;
+static bool sym_var_units_read = false;
+
+static int sym_var_parse(sym_dwarf_t *dw, sym_var_cu_t *vcu)
+{
+	sym_dwarf_cu_t *cu = &vcu->cu;
+	sym_dwarf_unit_t unit;
+	sym_dwarf_abbrevs_t abbrevs;
+	if (sym_dwarf_cu_header(dw, vcu->off, cu) == -1 ||
+	    sym_dwarf_cu_attrs(dw, cu, &unit) == -1 ||
+	    sym_dwarf_abbrevs(dw, cu->abbrev_off, &abbrevs) == -1) {
+		return -1;
+	}
+
+	int ret = -1;
+	unsigned int cap = 0;
+	uint32_t parents[SYM_VAR_DEPTH];
+	uint32_t prev[SYM_VAR_DEPTH];
+	int depth = 0;
+	prev[0] = 0;
+
+	const unsigned char *abbrev_end = dw->abbrev.buf + dw->abbrev.size;
+	sym_dwarf_buf_t b = { dw->info.buf + cu->die_off, dw->info.buf + cu->end,
+		false };
+	while (b.p < b.end) {
+		uint64_t off = b.p - dw->info.buf;
+		uint64_t code = sym_dwarf_uleb(&b);
+		if (b.err)
+			goto out;
+
+		if (code == 0) {
+			// end of the children, or padding after the unit DIE
+			if (depth > 0)
+				depth--;
+			continue;
+		}
+
+		sym_dwarf_abbrev_t *ab = sym_dwarf_abbrev_find(&abbrevs, code);
+		if (ab == NULL) {
+			pr_debug("unknown abbreviation %lu at %#lx", code, off);
+			goto out;
+		}
+
+		if (vcu->count == cap) {
+			cap = cap ? cap * 2 : 256;
+			sym_var_die_t *t = realloc(vcu->dies, cap * sizeof(*t));
+			if (t == NULL) {
+				pr_err("error in allocating DIEs: %s",
+				    strerror(errno));
+				goto out;
+			}
+			vcu->dies = t;
+		}
+
+		uint32_t idx = vcu->count++;
+		sym_var_die_t *die = &vcu->dies[idx];
+		memset(die, 0, sizeof(*die));
+		die->off = off;
+		die->tag = ab->tag;
+		die->parent = (depth > 0) ? parents[depth - 1] : 0;
+		if (idx > 0 && prev[depth] != 0)
+			vcu->dies[prev[depth]].next = idx;
+		prev[depth] = idx;
+
+		bool high_off = false;
+		sym_dwarf_buf_t spec = { ab->specs, abbrev_end, false };
+		sym_dwarf_attr_t attr;
+		int r;
+		while ((r = sym_dwarf_attr_next(dw, cu, &spec, &b, &attr)) == 1) {
+			switch (attr.at) {
+			case SYM_DW_AT_name:
+				die->name = attr.val.str;
+				break;
+			case SYM_DW_AT_type:
+				if (attr.form != SYM_DW_FORM_ref_sig8)
+					die->type = attr.val.u;
+				break;
+			case SYM_DW_AT_specification:
+			case SYM_DW_AT_abstract_origin:
+				die->origin = attr.val.u;
+				break;
+			case SYM_DW_AT_low_pc:
+				die->low_pc = attr.val.u;
+				break;
+			case SYM_DW_AT_high_pc:
+				die->high_pc = attr.val.u;
+				high_off = (attr.form != SYM_DW_FORM_addr &&
+				    attr.form != SYM_DW_FORM_addrx &&
+				    (attr.form < SYM_DW_FORM_addrx1 ||
+					attr.form > SYM_DW_FORM_addrx4));
+				break;
+			case SYM_DW_AT_byte_size:
+				die->size = attr.val.u;
+				die->flags |= SYM_VAR_HAS_SIZE;
+				break;
+			case SYM_DW_AT_upper_bound:
+				die->size = attr.val.u + 1;
+				die->flags |= SYM_VAR_HAS_SIZE;
+				break;
+			case SYM_DW_AT_count:
+				die->size = attr.val.u;
+				die->flags |= SYM_VAR_HAS_SIZE;
+				break;
+			case SYM_DW_AT_const_value:
+				if (attr.block == NULL) {
+					die->value = (int64_t)attr.val.u;
+					die->flags |= SYM_VAR_HAS_VALUE;
+				}
+				break;
+			case SYM_DW_AT_data_member_location:
+				if (attr.block == NULL) {
+					die->value = (int64_t)attr.val.u;
+				} else if (attr.val.u > 1 &&
+				    attr.block[0] == SYM_DW_OP_plus_uconst) {
+					sym_dwarf_buf_t e = { attr.block + 1,
+						attr.block + attr.val.u, false };
+					die->value = sym_dwarf_uleb(&e);
+				}
+				break;
+			case SYM_DW_AT_bit_size:
+				die->flags |= SYM_VAR_BITFIELD;
+				break;
+			case SYM_DW_AT_location:
+				if (attr.block != NULL) {
+					die->loc = attr.block;
+					die->loc_len = attr.val.u;
+				} else {
+					die->flags |= SYM_VAR_LOCLIST;
+				}
+				break;
+			case SYM_DW_AT_frame_base:
+				if (attr.block != NULL) {
+					die->frame_base = attr.block;
+					die->frame_base_len = attr.val.u;
+				}
+				break;
+			case SYM_DW_AT_encoding:
+				die->encoding = attr.val.u;
+				break;
+			case SYM_DW_AT_declaration:
+				if (attr.val.u != 0)
+					die->flags |= SYM_VAR_DECL;
+				break;
+			}
+		}
+
+		if (r == -1) {
+			pr_debug("bad DIE at %#lx", off);
+			goto out;
+		}
+
+		if (high_off)
+			die->high_pc += die->low_pc;
+
+		if (ab->children) {
+			if (depth + 1 >= SYM_VAR_DEPTH) {
+				pr_debug("DIEs nested too deep at %#lx", off);
+				goto out;
+			}
+			die->flags |= SYM_VAR_CHILDREN;
+			parents[depth++] = idx;
+			prev[depth] = 0;
+		}
+	}
+
+	pr_debug("unit %#lx: %u DIEs", vcu->off, vcu->count);
+	ret = 0;
+
+out:
+	free(abbrevs.ents);
+	return ret;
+}
+
+// The parsed unit at 'cu_off', NULL if it cannot be parsed.
+static sym_var_cu_t *sym_var_cu(sym_dwarf_t *dw, uint64_t cu_off)
+{
+	sym_var_cu_t *vcu = NULL;
+	HASH_FIND(hh, sym_var_cus, &cu_off, sizeof(cu_off), vcu);
+	if (vcu != NULL)
+		return vcu->failed ? NULL : vcu;
+
+	vcu = calloc(1, sizeof(*vcu));
+	if (vcu == NULL) {
+		pr_err("error in allocating unit: %s", strerror(errno));
+		return NULL;
+	}
+
+	vcu->off = cu_off;
+	if (sym_var_parse(dw, vcu) == -1) {
+		free(vcu->dies);
+		vcu->dies = NULL;
+		vcu->count = 0;
+		vcu->failed = true;
+	}
+
+	HASH_ADD(hh, sym_var_cus, off, sizeof(vcu->off), vcu);
+	return vcu->failed ? NULL : vcu;
+}
+
+// Index of the first child of the DIE at 'idx', 0 if it has none.
+static uint32_t sym_var_child0(sym_var_cu_t *cu, uint32_t idx)
+{
+	if (!(cu->dies[idx].flags & SYM_VAR_CHILDREN) || idx + 1 >= cu->count ||
+	    cu->dies[idx + 1].parent != idx) {
+		return 0;
+	}
+
+	return idx + 1;
+}
+
+// Walks the unit headers of .debug_info, only once.
+static void sym_var_read_units(sym_dwarf_t *dw)
+{
+	sym_var_units_read = true;
+
+	unsigned int cap = 0;
+	uint64_t off = 0;
+	while (off < dw->info.size) {
+		sym_dwarf_cu_t cu = { 0 };
+		if (sym_dwarf_cu_header(dw, off, &cu) == -1)
+			break;
+
+		if (sym_var_unit_count == cap) {
+			cap = cap ? cap * 2 : 64;
+			uint64_t *t = realloc(sym_var_units, cap * sizeof(*t));
+			if (t == NULL) {
+				pr_err("error in allocating units: %s",
+				    strerror(errno));
+				return;
+			}
+			sym_var_units = t;
+		}
+
+		sym_var_units[sym_var_unit_count++] = off;
+		off = cu.end;
+	}
+}
+
+// Finds the DIE at 'off', possibly in another unit, which is then stored in
+// 'cu'.
+static sym_var_die_t *sym_var_die(
+    sym_dwarf_t *dw, sym_var_cu_t **cu, uint64_t off)
+{
+	sym_var_cu_t *vcu = *cu;
+	if (off < vcu->cu.off || off >= vcu->cu.end) {
+		if (!sym_var_units_read)
+			sym_var_read_units(dw);
+
+		// last unit starting at or before off
+		unsigned int lo = 0;
+		unsigned int hi = sym_var_unit_count;
+		while (lo < hi) {
+			unsigned int mid = lo + (hi - lo) / 2;
+			if (sym_var_units[mid] <= off)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		if (lo == 0 || (vcu = sym_var_cu(dw, sym_var_units[lo - 1])) ==
+				   NULL) {
+			return NULL;
+		}
+	}
+
+	unsigned int lo = 0;
+	unsigned int hi = vcu->count;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (vcu->dies[mid].off < off)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo == vcu->count || vcu->dies[lo].off != off)
+		return NULL;
+
+	*cu = vcu;
+	return &vcu->dies[lo];
+}
+
+static const char *sym_var_name(
+    sym_dwarf_t *dw, sym_var_cu_t *cu, sym_var_die_t *die)
+{
+	// definitions out of their declaration (C++ static members) only
+	// point to it
+	if (die->name == NULL && die->origin != 0) {
+		sym_var_die_t *orig = sym_var_die(dw, &cu, die->origin);
+		if (orig != NULL)
+			return orig->name;
+	}
+
+	return die->name;
+}
+
+static bool sym_var_is_var(sym_var_die_t *die)
+{
+	return die->tag == SYM_DW_TAG_variable ||
+	    die->tag == SYM_DW_TAG_formal_parameter;
+}
+
+// Finds 'name' among the children of 'parent'. Declarations are skipped, a
+// global declared in this unit is defined in another one.
+static sym_var_die_t *sym_var_child(sym_dwarf_t *dw, sym_var_cu_t *cu,
+    uint32_t parent, const char *name)
+{
+	for (uint32_t i = sym_var_child0(cu, parent); i != 0;
+	    i = cu->dies[i].next) {
+		sym_var_die_t *die = &cu->dies[i];
+		if (!sym_var_is_var(die) || (die->flags & SYM_VAR_DECL))
+			continue;
+
+		const char *n = sym_var_name(dw, cu, die);
+		if (n != NULL && strcmp(n, name) == 0)
+			return die;
+	}
+
+	return NULL;
+}
+
+static bool sym_var_is_scope(sym_var_die_t *die)
+{
+	return die->tag == SYM_DW_TAG_subprogram ||
+	    die->tag == SYM_DW_TAG_lexical_block;
+}
+
+// Finds the variable 'name' visible at 'pc' (a link time address), the unit
+// it is in is stored in 'frame->cu' and the function in 'frame->func'.
+static sym_var_die_t *sym_var_find(
+    sym_dwarf_t *dw, uint64_t pc, const char *name, sym_var_frame_t *frame)
+{
+	uint64_t cu_off;
+	sym_var_cu_t *cu = NULL;
+	if (sym_dwarf_cu_of_addr(dw, pc, &cu_off) == 0 &&
+	    (cu = sym_var_cu(dw, cu_off)) != NULL && cu->count > 0) {
+		uint32_t scopes[SYM_VAR_DEPTH];
+		int n = 0;
+		uint32_t cur = 0;
+		while (n < SYM_VAR_DEPTH) {
+			uint32_t i = sym_var_child0(cu, cur);
+			for (; i != 0; i = cu->dies[i].next) {
+				sym_var_die_t *d = &cu->dies[i];
+				if (sym_var_is_scope(d) && pc >= d->low_pc &&
+				    pc < d->high_pc) {
+					break;
+				}
+			}
+
+			if (i == 0)
+				break;
+
+			scopes[n++] = i;
+			cur = i;
+		}
+
+		for (int k = n - 1; k >= 0 && frame->func == NULL; k--) {
+			if (cu->dies[scopes[k]].tag == SYM_DW_TAG_subprogram)
+				frame->func = &cu->dies[scopes[k]];
+		}
+
+		for (int k = n - 1; k >= 0; k--) {
+			sym_var_die_t *die = sym_var_child(dw, cu, scopes[k], name);
+			if (die != NULL) {
+				frame->cu = cu;
+				return die;
+			}
+		}
+
+		sym_var_die_t *die = sym_var_child(dw, cu, 0, name);
+		if (die != NULL) {
+			frame->cu = cu;
+			return die;
+		}
+	}
+
+	// globals of the other units
+	if (!sym_var_units_read)
+		sym_var_read_units(dw);
+
+	for (unsigned int i = 0; i < sym_var_unit_count; i++) {
+		sym_var_cu_t *other = sym_var_cu(dw, sym_var_units[i]);
+		if (other == NULL || other == cu || other->count == 0)
+			continue;
+
+		sym_var_die_t *die = sym_var_child(dw, other, 0, name);
+		if (die != NULL) {
+			frame->cu = other;
+			return die;
+		}
+	}
+
+	return NULL;
+}
+
+static int sym_var_reg(sym_var_frame_t *frame, uint64_t reg, uint64_t *val)
+{
+	struct user_regs_struct *r = &frame->regs;
+	// DWARF register numbers of x86_64
+	switch (reg) {
+	case 0: *val = r->rax; break;
+	case 1: *val = r->rdx; break;
+	case 2: *val = r->rcx; break;
+	case 3: *val = r->rbx; break;
+	case 4: *val = r->rsi; break;
+	case 5: *val = r->rdi; break;
+	case 6: *val = r->rbp; break;
+	case 7: *val = r->rsp; break;
+	case 8: *val = r->r8; break;
+	case 9: *val = r->r9; break;
+	case 10: *val = r->r10; break;
+	case 11: *val = r->r11; break;
+	case 12: *val = r->r12; break;
+	case 13: *val = r->r13; break;
+	case 14: *val = r->r14; break;
+	case 15: *val = r->r15; break;
+	case 16: *val = r->rip; break;
+	default:
+		pr_err("unsupported DWARF register %lu", reg);
+		return -1;
+	}
+
+	return 0;
+}
+
+// The canonical frame address is the stack pointer of the caller, before the
+// call. It comes from the CFI of the executable, libunwind is only asked when
+// there is none for the pc.
+static int sym_var_cfa(sym_var_frame_t *frame, uint64_t *cfa)
+{
+	if (frame->cfa_read) {
+		*cfa = frame->cfa;
+		return 0;
+	}
+
+	tracee_t *tracee = frame->tracee;
+	uint64_t reg, val;
+	int64_t off;
+	if (sym_frame_cfa_rule(frame->regs.rip - tracee->va_base, &reg, &off) ==
+		0 &&
+	    sym_var_reg(frame, reg, &val) == 0) {
+		frame->cfa = val + off;
+		frame->cfa_read = true;
+		*cfa = frame->cfa;
+		return 0;
+	}
+
+	void *unw_context = _UPT_create(tracee->pid);
+	if (unw_context == NULL) {
+		pr_err("cannot create the unwind context");
+		return -1;
+	}
+
+	int ret = -1;
+	unw_cursor_t cursor;
+	unw_word_t sp;
+	if (unw_init_remote(&cursor, tracee->unw_addr, unw_context) != 0 ||
+	    unw_step(&cursor) <= 0 || unw_get_reg(&cursor, UNW_REG_SP, &sp)) {
+		pr_err("cannot find the frame of the current function");
+		goto out;
+	}
+
+	frame->cfa = sp;
+	frame->cfa_read = true;
+	*cfa = sp;
+	ret = 0;
+
+out:
+	_UPT_destroy(unw_context);
+	return ret;
+}
+
+static int sym_var_eval(sym_var_frame_t *frame, const unsigned char *expr,
+    size_t len, sym_var_loc_e *kind, uint64_t *res, int nest);
+
+// The frame base of the current function, what DW_OP_fbreg is relative to.
+static int sym_var_frame_base(sym_var_frame_t *frame, uint64_t *base, int nest)
+{
+	sym_var_die_t *func = frame->func;
+	if (func == NULL || func->frame_base == NULL) {
+		pr_err("no frame base for the current function");
+		return -1;
+	}
+
+	sym_var_loc_e kind;
+	uint64_t val;
+	if (sym_var_eval(frame, func->frame_base, func->frame_base_len, &kind,
+		&val, nest + 1) == -1) {
+		return -1;
+	}
+
+	// DW_OP_call_frame_cfa gives the address, DW_OP_reg6 the register
+	if (kind == SYM_VAR_LOC_REG)
+		return sym_var_reg(frame, val, base);
+
+	*base = val;
+	return 0;
+}
+
+// Evaluates a location expression to an address, a register number, or the
+// value itself.
+static int sym_var_eval(sym_var_frame_t *frame, const unsigned char *expr,
+    size_t len, sym_var_loc_e *kind, uint64_t *res, int nest)
+{
+	if (nest > 2) {
+		pr_err("location expression nested too deep");
+		return -1;
+	}
+
+	uint64_t stack[SYM_VAR_STACK];
+	int sp = 0;
+	sym_dwarf_cu_t *cu = &frame->cu->cu;
+	sym_dwarf_buf_t b = { expr, expr + len, false };
+	*kind = SYM_VAR_LOC_MEM;
+
+#define PUSH(v)                                                                \
+	do {                                                                   \
+		if (sp == SYM_VAR_STACK)                                       \
+			goto overflow;                                         \
+		stack[sp++] = (v);                                             \
+	} while (0)
+#define NEED(n)                                                                \
+	do {                                                                   \
+		if (sp < (n))                                                  \
+			goto underflow;                                        \
+	} while (0)
+
+	while (b.p < b.end && !b.err) {
+		uint8_t op = sym_dwarf_u(&b, 1);
+		uint64_t a, v;
+		if (op >= SYM_DW_OP_lit0 && op <= SYM_DW_OP_lit31) {
+			PUSH(op - SYM_DW_OP_lit0);
+			continue;
+		}
+
+		if (op >= SYM_DW_OP_reg0 && op <= SYM_DW_OP_reg31) {
+			*kind = SYM_VAR_LOC_REG;
+			*res = op - SYM_DW_OP_reg0;
+			return 0;
+		}
+
+		if (op >= SYM_DW_OP_breg0 && op <= SYM_DW_OP_breg31) {
+			int64_t off = sym_dwarf_sleb(&b);
+			if (sym_var_reg(frame, op - SYM_DW_OP_breg0, &v) == -1)
+				return -1;
+			PUSH(v + off);
+			continue;
+		}
+
+		switch (op) {
+		case SYM_DW_OP_addr:
+			PUSH(sym_dwarf_u(&b, cu->addr_size) +
+			    frame->tracee->va_base);
+			break;
+		case SYM_DW_OP_addrx:
+		case SYM_DW_OP_GNU_addr_index: {
+			// the form decoder resolves the index
+			sym_dwarf_val_t val;
+			if (sym_dwarf_form(frame->dw, &b, SYM_DW_FORM_addrx, cu,
+				&val) == -1) {
+				return -1;
+			}
+			PUSH(val.u + frame->tracee->va_base);
+			break;
+		}
+		case SYM_DW_OP_const1u:
+			PUSH(sym_dwarf_u(&b, 1));
+			break;
+		case SYM_DW_OP_const1s:
+			PUSH((int64_t)(int8_t)sym_dwarf_u(&b, 1));
+			break;
+		case SYM_DW_OP_const2u:
+			PUSH(sym_dwarf_u(&b, 2));
+			break;
+		case SYM_DW_OP_const2s:
+			PUSH((int64_t)(int16_t)sym_dwarf_u(&b, 2));
+			break;
+		case SYM_DW_OP_const4u:
+			PUSH(sym_dwarf_u(&b, 4));
+			break;
+		case SYM_DW_OP_const4s:
+			PUSH((int64_t)(int32_t)sym_dwarf_u(&b, 4));
+			break;
+		case SYM_DW_OP_const8u:
+		case SYM_DW_OP_const8s:
+			PUSH(sym_dwarf_u(&b, 8));
+			break;
+		case SYM_DW_OP_constu:
+			PUSH(sym_dwarf_uleb(&b));
+			break;
+		case SYM_DW_OP_consts:
+			PUSH((uint64_t)sym_dwarf_sleb(&b));
+			break;
+		case SYM_DW_OP_dup:
+			NEED(1);
+			a = stack[sp - 1];
+			PUSH(a);
+			break;
+		case SYM_DW_OP_drop:
+			NEED(1);
+			sp--;
+			break;
+		case SYM_DW_OP_deref:
+			NEED(1);
+			if (sym_mem_read(frame->tracee->pid, stack[sp - 1], &v,
+				sizeof(v)) == -1) {
+				return -1;
+			}
+			stack[sp - 1] = v;
+			break;
+		case SYM_DW_OP_plus:
+			NEED(2);
+			a = stack[--sp];
+			stack[sp - 1] += a;
+			break;
+		case SYM_DW_OP_minus:
+			NEED(2);
+			a = stack[--sp];
+			stack[sp - 1] -= a;
+			break;
+		case SYM_DW_OP_plus_uconst:
+			NEED(1);
+			stack[sp - 1] += sym_dwarf_uleb(&b);
+			break;
+		case SYM_DW_OP_regx:
+			*kind = SYM_VAR_LOC_REG;
+			*res = sym_dwarf_uleb(&b);
+			return b.err ? -1 : 0;
+		case SYM_DW_OP_bregx: {
+			uint64_t reg = sym_dwarf_uleb(&b);
+			int64_t off = sym_dwarf_sleb(&b);
+			if (sym_var_reg(frame, reg, &v) == -1)
+				return -1;
+			PUSH(v + off);
+			break;
+		}
+		case SYM_DW_OP_fbreg: {
+			int64_t off = sym_dwarf_sleb(&b);
+			if (sym_var_frame_base(frame, &v, nest) == -1)
+				return -1;
+			PUSH(v + off);
+			break;
+		}
+		case SYM_DW_OP_call_frame_cfa:
+			if (sym_var_cfa(frame, &v) == -1)
+				return -1;
+			PUSH(v);
+			break;
+		case SYM_DW_OP_stack_value:
+			*kind = SYM_VAR_LOC_VALUE;
+			b.p = b.end;
+			break;
+		default:
+			pr_err("unsupported DWARF operation %#x", op);
+			return -1;
+		}
+	}
+
+	if (b.err) {
+		pr_err("truncated location expression");
+		return -1;
+	}
+
+	NEED(1);
+	*res = stack[sp - 1];
+	return 0;
+
+overflow:
+	pr_err("location expression stack overflow");
+	return -1;
+
+underflow:
+	pr_err("location expression stack underflow");
+	return -1;
+
+#undef PUSH
+#undef NEED
+}
+
+// Skips typedefs and qualifiers. Returns NULL for void.
+static sym_var_die_t *sym_var_type(
+    sym_dwarf_t *dw, sym_var_cu_t **cu, uint64_t type)
+{
+	for (int i = 0; i < SYM_VAR_DEPTH && type != 0; i++) {
+		sym_var_die_t *t = sym_var_die(dw, cu, type);
+		if (t == NULL)
+			return NULL;
+
+		switch (t->tag) {
+		case SYM_DW_TAG_typedef:
+		case SYM_DW_TAG_const_type:
+		case SYM_DW_TAG_volatile_type:
+		case SYM_DW_TAG_restrict_type:
+		case SYM_DW_TAG_atomic_type:
+			type = t->type;
+			break;
+		default:
+			return t;
+		}
+	}
+
+	return NULL;
+}
+
+static uint64_t sym_var_type_size(
+    sym_dwarf_t *dw, sym_var_cu_t *cu, uint64_t type, int nest)
+{
+	sym_var_die_t *t = sym_var_type(dw, &cu, type);
+	if (t == NULL || nest > SYM_VAR_MAX_NEST)
+		return 0;
+
+	if (t->flags & SYM_VAR_HAS_SIZE)
+		return t->size;
+
+	switch (t->tag) {
+	case SYM_DW_TAG_pointer_type:
+	case SYM_DW_TAG_reference_type:
+	case SYM_DW_TAG_rvalue_reference_type:
+		return sizeof(uint64_t);
+	case SYM_DW_TAG_array_type: {
+		uint64_t count = 1;
+		uint32_t idx = t - cu->dies;
+		for (uint32_t i = sym_var_child0(cu, idx); i != 0;
+		    i = cu->dies[i].next) {
+			if (cu->dies[i].tag == SYM_DW_TAG_subrange_type)
+				count *= cu->dies[i].size;
+		}
+
+		return count * sym_var_type_size(dw, cu, t->type, nest + 1);
+	}
+	default:
+		return 0;
+	}
+}
+
+static bool sym_var_is_char(sym_var_die_t *t)
+{
+	return t != NULL && t->tag == SYM_DW_TAG_base_type && t->size == 1 &&
+	    (t->encoding == SYM_DW_ATE_signed_char ||
+		t->encoding == SYM_DW_ATE_unsigned_char ||
+		t->encoding == SYM_DW_ATE_UTF);
+}
+
+static void sym_var_print_char(unsigned char c, char quote)
+{
+	switch (c) {
+	case '\n':
+		pr_info_raw("\\n");
+		break;
+	case '\t':
+		pr_info_raw("\\t");
+		break;
+	case '\r':
+		pr_info_raw("\\r");
+		break;
+	case '\\':
+		pr_info_raw("\\\\");
+		break;
+	default:
+		if (c == quote)
+			pr_info_raw("\\%c", c);
+		else if (c >= 0x20 && c < 0x7f)
+			pr_info_raw("%c", c);
+		else
+			pr_info_raw("\\%03o", c);
+	}
+}
+
+// Prints the characters of 'buf' up to the first NUL as a string.
+static void sym_var_print_str(const unsigned char *buf, size_t len, bool more)
+{
+	pr_info_raw("\"");
+	size_t i = 0;
+	for (; i < len && buf[i] != '\0'; i++)
+		sym_var_print_char(buf[i], '"');
+	pr_info_raw("\"");
+
+	if (i == len && more)
+		pr_info_raw("...");
+}
+
+// Reads the string a char pointer points to, at most SYM_VAR_MAX_STR bytes.
+// Unlike sym_mem_read an unreadable pointer is not an error.
+static void sym_var_print_cstr(pid_t pid, uint64_t addr)
+{
+	unsigned char buf[SYM_VAR_MAX_STR];
+	size_t len = 0;
+	while (len < sizeof(buf)) {
+		errno = 0;
+		long word = ptrace(PTRACE_PEEKDATA, pid, addr + len, 0);
+		if (word == -1 && errno != 0) {
+			if (len == 0) {
+				pr_info_raw(" <error: cannot access memory>");
+				return;
+			}
+			break;
+		}
+
+		size_t n = sizeof(buf) - len;
+		if (n > sizeof(word))
+			n = sizeof(word);
+		memcpy(&buf[len], &word, n);
+		len += n;
+		if (memchr(&word, '\0', n) != NULL)
+			break;
+	}
+
+	pr_info_raw(" ");
+	sym_var_print_str(buf, len, len == sizeof(buf));
+}
+
+static void sym_var_print_base(sym_var_die_t *t, const unsigned char *buf)
+{
+	uint64_t u = 0;
+	size_t size = t->size;
+	if (size <= sizeof(u))
+		memcpy(&u, buf, size);
+
+	// sign extended
+	int64_t s = (int64_t)u;
+	if (size > 0 && size < sizeof(u)) {
+		unsigned int shift = 64 - size * 8;
+		s = (int64_t)(u << shift) >> shift;
+	}
+
+	switch (t->encoding) {
+	case SYM_DW_ATE_boolean:
+		pr_info_raw("%s", u ? "true" : "false");
+		break;
+	case SYM_DW_ATE_float:
+		if (size == sizeof(float)) {
+			float f;
+			memcpy(&f, buf, sizeof(f));
+			pr_info_raw("%g", f);
+		} else if (size == sizeof(double)) {
+			double d;
+			memcpy(&d, buf, sizeof(d));
+			pr_info_raw("%g", d);
+		} else if (size == 10 || size == sizeof(long double)) {
+			long double ld = 0;
+			memcpy(&ld, buf, 10);
+			pr_info_raw("%Lg", ld);
+		} else {
+			pr_info_raw("<%zu byte float>", size);
+		}
+		break;
+	case SYM_DW_ATE_signed:
+		pr_info_raw("%ld", s);
+		break;
+	case SYM_DW_ATE_signed_char:
+		pr_info_raw("%ld '", s);
+		sym_var_print_char(u, '\'');
+		pr_info_raw("'");
+		break;
+	case SYM_DW_ATE_unsigned_char:
+	case SYM_DW_ATE_UTF:
+		pr_info_raw("%lu '", u);
+		sym_var_print_char(u, '\'');
+		pr_info_raw("'");
+		break;
+	default:
+		if (size > sizeof(u))
+			pr_info_raw("<%zu byte integer>", size);
+		else
+			pr_info_raw("%lu", u);
+	}
+}
+
+static void sym_var_print_value(sym_var_frame_t *frame, sym_var_cu_t *cu,
+    uint64_t type, const unsigned char *buf, size_t len, int nest);
+
+// Prints the dimensions of an array from 'sub' (a subrange child) on.
+static void sym_var_print_array(sym_var_frame_t *frame, sym_var_cu_t *cu,
+    uint32_t sub, uint64_t elem, const unsigned char *buf, size_t len,
+    int nest)
+{
+	uint64_t count = cu->dies[sub].size;
+	uint32_t next = cu->dies[sub].next;
+	while (next != 0 && cu->dies[next].tag != SYM_DW_TAG_subrange_type)
+		next = cu->dies[next].next;
+
+	uint64_t stride = sym_var_type_size(frame->dw, cu, elem, 0);
+	for (uint32_t i = next; i != 0; i = cu->dies[i].next) {
+		if (cu->dies[i].tag == SYM_DW_TAG_subrange_type)
+			stride *= cu->dies[i].size;
+	}
+
+	sym_var_cu_t *ecu = cu;
+	if (next == 0 && sym_var_is_char(sym_var_type(frame->dw, &ecu, elem))) {
+		size_t n = (count < len) ? count : len;
+		sym_var_print_str(buf, n, false);
+		return;
+	}
+
+	pr_info_raw("{");
+	for (uint64_t i = 0; i < count; i++) {
+		if (i > 0)
+			pr_info_raw(", ");
+		if (i == SYM_VAR_MAX_ELEMS || (i + 1) * stride > len) {
+			pr_info_raw("...");
+			break;
+		}
+
+		const unsigned char *p = buf + i * stride;
+		if (next != 0)
+			sym_var_print_array(
+			    frame, cu, next, elem, p, stride, nest + 1);
+		else
+			sym_var_print_value(frame, cu, elem, p, stride, nest + 1);
+	}
+	pr_info_raw("}");
+}
+
+// Prints the value of 'type' in 'buf'.
+static void sym_var_print_value(sym_var_frame_t *frame, sym_var_cu_t *cu,
+    uint64_t type, const unsigned char *buf, size_t len, int nest)
+{
+	sym_dwarf_t *dw = frame->dw;
+	sym_var_die_t *t = sym_var_type(dw, &cu, type);
+	if (t == NULL) {
+		pr_info_raw("<unknown type>");
+		return;
+	}
+
+	if (nest > SYM_VAR_MAX_NEST) {
+		pr_info_raw("{...}");
+		return;
+	}
+
+	uint32_t idx = t - cu->dies;
+	uint64_t size = sym_var_type_size(dw, cu, type, 0);
+	if (size > len && t->tag != SYM_DW_TAG_array_type) {
+		pr_info_raw("<unavailable>");
+		return;
+	}
+
+	switch (t->tag) {
+	case SYM_DW_TAG_base_type:
+		sym_var_print_base(t, buf);
+		break;
+	case SYM_DW_TAG_pointer_type:
+	case SYM_DW_TAG_reference_type:
+	case SYM_DW_TAG_rvalue_reference_type: {
+		uint64_t addr = 0;
+		memcpy(&addr, buf, sizeof(addr));
+		pr_info_raw("%#lx", addr);
+
+		sym_var_cu_t *tcu = cu;
+		sym_var_die_t *target = sym_var_type(dw, &tcu, t->type);
+		if (addr == 0 || target == NULL)
+			break;
+
+		if (sym_var_is_char(target)) {
+			sym_var_print_cstr(frame->tracee->pid, addr);
+		} else if (target->tag == SYM_DW_TAG_subroutine_type) {
+			symbol_t *sym = sym_lookup_addr(frame->tracee, addr);
+			if (sym != NULL && sym->addr == addr)
+				pr_info_raw(" <%s>", sym->name);
+		}
+		break;
+	}
+	case SYM_DW_TAG_structure_type:
+	case SYM_DW_TAG_class_type:
+	case SYM_DW_TAG_union_type: {
+		if (t->flags & SYM_VAR_DECL) {
+			pr_info_raw("<incomplete type>");
+			break;
+		}
+
+		pr_info_raw("{");
+		bool first = true;
+		for (uint32_t i = sym_var_child0(cu, idx); i != 0;
+		    i = cu->dies[i].next) {
+			sym_var_die_t *m = &cu->dies[i];
+			if (m->tag != SYM_DW_TAG_member ||
+			    (m->flags & SYM_VAR_DECL)) {
+				continue;
+			}
+
+			pr_info_raw("%s%s = ", first ? "" : ", ",
+			    m->name ? m->name : "<anonymous>");
+			first = false;
+
+			if (m->flags & SYM_VAR_BITFIELD)
+				pr_info_raw("<bitfield>");
+			else if ((uint64_t)m->value >= len)
+				pr_info_raw("<unavailable>");
+			else
+				sym_var_print_value(frame, cu, m->type,
+				    buf + m->value, len - m->value,
+				    nest + 1);
+		}
+		pr_info_raw("}");
+		break;
+	}
+	case SYM_DW_TAG_array_type: {
+		uint32_t sub = 0;
+		for (uint32_t i = sym_var_child0(cu, idx); i != 0;
+		    i = cu->dies[i].next) {
+			if (cu->dies[i].tag == SYM_DW_TAG_subrange_type) {
+				sub = i;
+				break;
+			}
+		}
+
+		if (sub == 0) {
+			pr_info_raw("<unknown array size>");
+			break;
+		}
+
+		sym_var_print_array(frame, cu, sub, t->type, buf, len, nest);
+		break;
+	}
+	case SYM_DW_TAG_enumeration_type: {
+		int64_t v = 0;
+		if (t->size <= sizeof(v))
+			memcpy(&v, buf, t->size);
+		if (t->size > 0 && t->size < sizeof(v)) {
+			unsigned int shift = 64 - t->size * 8;
+			v = (int64_t)((uint64_t)v << shift) >> shift;
+		}
+
+		// enumerators can be given unsigned, compare the low bytes
+		uint64_t mask = (t->size > 0 && t->size < sizeof(v))
+		    ? (1ULL << (t->size * 8)) - 1
+		    : ~0ULL;
+		for (uint32_t i = sym_var_child0(cu, idx); i != 0;
+		    i = cu->dies[i].next) {
+			sym_var_die_t *e = &cu->dies[i];
+			if (e->tag == SYM_DW_TAG_enumerator &&
+			    ((uint64_t)e->value & mask) ==
+				((uint64_t)v & mask)) {
+				pr_info_raw("%s", e->name);
+				return;
+			}
+		}
+		pr_info_raw("%ld", v);
+		break;
+	}
+	default:
+		pr_info_raw("<unsupported type>");
+	}
+}
+
+int sym_print_var(tracee_t *tracee, char *name)
+{
+	sym_dwarf_t *dw = sym_dwarf_exe();
+	if (dw == NULL || dw->info.buf == NULL) {
+		pr_err("no debug info, build the program with -g");
+		return -1;
+	}
+
+	sym_var_frame_t frame = { 0 };
+	frame.tracee = tracee;
+	frame.dw = dw;
+	if (ptrace(PTRACE_GETREGS, tracee->pid, NULL, &frame.regs) == -1) {
+		pr_err("error in getting registers: %s", strerror(errno));
+		return -1;
+	}
+
+	uint64_t pc = frame.regs.rip - tracee->va_base;
+	sym_var_die_t *var = sym_var_find(dw, pc, name, &frame);
+	if (var == NULL) {
+		pr_err("no variable '%s' in the current scope", name);
+		return -1;
+	}
+
+	sym_var_cu_t *cu = frame.cu;
+	uint64_t size = sym_var_type_size(dw, cu, var->type, 0);
+	if (var->type == 0 || size == 0) {
+		pr_err("variable '%s' has no known type", name);
+		return -1;
+	}
+
+	if (size > SYM_VAR_MAX_SIZE)
+		size = SYM_VAR_MAX_SIZE;
+
+	unsigned char *buf = calloc(1, size < sizeof(uint64_t) ? sizeof(uint64_t)
+								: size);
+	if (buf == NULL) {
+		pr_err("error in allocating value: %s", strerror(errno));
+		return -1;
+	}
+
+	int ret = -1;
+	if (var->flags & SYM_VAR_HAS_VALUE) {
+		memcpy(buf, &var->value,
+		    size < sizeof(var->value) ? size : sizeof(var->value));
+	} else if (var->loc == NULL) {
+		pr_info_raw("<optimized out>\n");
+		ret = 0;
+		goto out;
+	} else {
+		sym_var_loc_e kind;
+		uint64_t val;
+		if (sym_var_eval(&frame, var->loc, var->loc_len, &kind, &val, 0) ==
+		    -1) {
+			goto out;
+		}
+
+		if (kind == SYM_VAR_LOC_MEM) {
+			if (sym_mem_read(tracee->pid, val, buf, size) == -1)
+				goto out;
+		} else if (kind == SYM_VAR_LOC_REG) {
+			uint64_t reg;
+			if (sym_var_reg(&frame, val, &reg) == -1)
+				goto out;
+			memcpy(buf, &reg,
+			    size < sizeof(reg) ? size : sizeof(reg));
+		} else {
+			memcpy(buf, &val, size < sizeof(val) ? size : sizeof(val));
+		}
+	}
+
+	sym_var_print_value(&frame, cu, var->type, buf, size, 0);
+	pr_info_raw("\n");
+	ret = 0;
+
+out:
+	free(buf);
+	return ret;
+}
+
+void sym_var_cleanup(void)
+{
+	sym_var_cu_t *vcu, *tmp;
+	HASH_ITER(hh, sym_var_cus, vcu, tmp)
+	{
+		HASH_DEL(sym_var_cus, vcu);
+		free(vcu->dies);
+		free(vcu);
+	}
+
+	free(sym_var_units);
+	sym_var_units = NULL;
+	sym_var_unit_count = 0;
+	sym_var_units_read = false;
+}
@@ -9,6 +9,7 @@
 
 #include "sherlock_internal.h"
 #include <sherlock/sym.h>
+#include <sherlock/mem.h>
 #include <errno.h>
 #include <stdbool.h>
 #include <string.h>
@@ -73,7 +74,12 @@ int tracee_setup_pid(tracee_t *tracee, int pid)
 
 	// attach to the program, the tracee should be left in the stopped
 	// state, since the program is already running, unlike the exec case
-	return attach_and_stop(tracee, false);
+	if (attach_and_stop(tracee, false) == -1)
+		return -1;
+
+	// failing is not fatal, memory is accessed with ptrace then
+	mem_open(tracee->pid);
+	return 0;
 }
 
 // Execs the program andd attaches the deubgger to it. Sets the fields of the
@@ -168,6 +174,10 @@ int tracee_setup_exec(tracee_t *tracee, char *argv[])
 			       "address, trace failed");
 			goto parent_err;
 		}
+
+		// opened after the exec, the file refers to the address space
+		// it was opened on
+		mem_open(tracee->pid);
 	}
 
 	return 0;
@@ -180,6 +190,7 @@ parent_err:
 void tracee_cleanup(tracee_t *tracee)
 {
 	pr_debug("tracee cleanup");
+	mem_close();
 	if (tracee->unw_addr != NULL) {
 		unw_destroy_addr_space(tracee->unw_addr);
 		tracee->unw_addr = NULL;
@@ -0,0 +1,38 @@
+/*
+ * Sherlock - A Minimal Debugger
+ * Part of the Sherlock project
+ *
+ * Copyright (c) 2025-26 Mohammad Shehar Yaar Tausif <sheharyaar48@gmail.com>
+ *
+ * This file is licensed under the MIT License.
+ */
+
+/* Loads and unloads a library a few times, for the dl event handling */
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <stdio.h>
+#include <unistd.h>
+
+__attribute__((noinline)) void loaded(double v) { printf("cbrt: %f\n", v); }
+
+int main(void)
+{
+	puts("first puts");
+
+	for (int i = 0; i < 3; i++) {
+		void *h = dlopen("libm.so.6", RTLD_NOW | RTLD_LOCAL);
+		if (h == NULL) {
+			printf("dlopen: %s\n", dlerror());
+			return 1;
+		}
+
+		double (*fn)(double) = (double (*)(double))dlsym(h, "cbrt");
+		if (fn != NULL)
+			loaded(fn(8.0));
+
+		dlclose(h);
+	}
+
+	sleep(1);
+	return 0;
+}
@@ -0,0 +1,53 @@
+/*
+ * Sherlock - A Minimal Debugger
+ * Part of the Sherlock project
+ *
+ * Copyright (c) 2025-26 Mohammad Shehar Yaar Tausif <sheharyaar48@gmail.com>
+ *
+ * This file is licensed under the MIT License.
+ */
+
+// C++ names: namespaces, overloads, methods and templates
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+
+namespace shop {
+
+struct cart {
+	unsigned items = 0;
+
+	__attribute__((noinline)) void add(unsigned n) { items += n; }
+	__attribute__((noinline)) void add(const std::string &name)
+	{
+		printf("adding %s\n", name.c_str());
+		items++;
+	}
+};
+
+template <typename T> __attribute__((noinline)) T total(T a, T b)
+{
+	return a + b;
+}
+
+__attribute__((noinline)) void checkout(cart &c)
+{
+	printf("checkout: %u items\n", c.items);
+}
+
+} // namespace shop
+
+int main(void)
+{
+	shop::cart c;
+	c.add(2);
+	c.add(std::string("book"));
+	c.add(shop::total<unsigned>(1, 2));
+	printf("%.1f\n", shop::total<double>(1.5, 2.5));
+
+	shop::checkout(c);
+
+	/* Prevent tail-call / exit optimization */
+	sleep(1);
+	return 0;
+}